@@ -0,0 +1,718 @@
+/// @file benchmark.cpp
+/// @brief Micro-benchmarks for ordered_multimap_t and its companions.
+///
+/// @details Every benchmark is registered by name, run them all with no
+/// arguments, or select one with `ordered_multimap_benchmark <name> [size]`.
+/// Build in `Release` mode to get meaningful numbers.
+///
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ordered_multimap/bloom_index.hpp"
+#include "ordered_multimap/btree_index.hpp"
+#include "ordered_multimap/checkpointed_ordered_multimap.hpp"
+#include "ordered_multimap/eytzinger_index.hpp"
+#include "ordered_multimap/flat_index.hpp"
+#include "ordered_multimap/interned_ordered_multimap.hpp"
+#include "ordered_multimap/ordered_multimap.hpp"
+#include "ordered_multimap/parallel.hpp"
+#include "ordered_multimap/radix_index.hpp"
+#include "ordered_multimap/small_ordered_multimap.hpp"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAS_HEAP_USAGE 1
+#else
+#define HAS_HEAP_USAGE 0
+#endif
+
+using Map = ordered_multimap::ordered_multimap_t<std::size_t, std::size_t>;
+
+/// @brief Measures the wall-clock time of a region.
+class stopwatch_t
+{
+public:
+    stopwatch_t()
+        : start(std::chrono::steady_clock::now())
+    {
+    }
+
+    /// @brief Returns the elapsed time in milliseconds.
+    auto elapsed_ms() const -> double
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+/// @brief Prints a single result line.
+inline void report(const std::string &name, double ms)
+{
+    std::cout << "  " << name << ": " << ms << " ms\n";
+}
+
+/// @brief A deterministic, CPU-heavy function of a value.
+inline auto heavy(std::size_t value) -> std::size_t
+{
+    for (int round = 0; round < 64; ++round) {
+        value ^= value >> 13U;
+        value *= 0x9E3779B97F4A7C15ULL;
+        value ^= value >> 29U;
+    }
+    return value;
+}
+
+/// @brief Builds a map with `size` entries, and keys drawn from `size / 4` values.
+inline auto build(std::size_t size) -> Map
+{
+    Map map;
+    for (std::size_t i = 0; i < size; ++i) {
+        map.insert(heavy(i) % (size / 4U + 1U), i);
+    }
+    return map;
+}
+
+void bench_parallel(std::size_t size)
+{
+    Map map = build(size);
+    ordered_multimap::thread_pool_t &pool = ordered_multimap::default_thread_pool();
+    std::cout << "  workers: " << pool.size() << "\n";
+
+    auto is_heavy_odd = [](const Map::list_entry_t &entry) { return heavy(entry.second) % 2U != 0; };
+
+    {
+        stopwatch_t watch;
+        std::size_t count = 0;
+        for (const auto &entry : map) {
+            if (is_heavy_odd(entry)) {
+                ++count;
+            }
+        }
+        report("sequential count_if (" + std::to_string(count) + ")", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        std::size_t count = ordered_multimap::parallel_count_if(pool, map, is_heavy_odd);
+        report("parallel_count_if   (" + std::to_string(count) + ")", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        for (auto &entry : map) {
+            entry.second = heavy(entry.second);
+        }
+        report("sequential transform_values", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        ordered_multimap::parallel_transform_values(pool, map, [](const std::size_t &value) { return heavy(value); });
+        report("parallel_transform_values", watch.elapsed_ms());
+    }
+    {
+        Map copy = map;
+        stopwatch_t watch;
+        for (auto it = copy.begin(); it != copy.end();) {
+            it = is_heavy_odd(*it) ? copy.erase(it) : std::next(it);
+        }
+        report("sequential erase_if", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        ordered_multimap::parallel_erase_if(pool, map, is_heavy_odd);
+        report("parallel_erase_if", watch.elapsed_ms());
+    }
+}
+
+void bench_build(std::size_t size)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> input;
+    input.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        input.emplace_back(heavy(i) % (size / 4U + 1U), i);
+    }
+    {
+        stopwatch_t watch;
+        Map map;
+        for (const auto &entry : input) {
+            map.insert(entry.first, entry.second);
+        }
+        report("repeated insert", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        Map map(input.begin(), input.end());
+        report("range constructor", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        Map map = ordered_multimap::build_parallel(input.begin(), input.end());
+        report("build_parallel", watch.elapsed_ms());
+    }
+}
+
+void bench_serialization(std::size_t size)
+{
+    ordered_multimap::ordered_multimap_t<std::string, std::string> map;
+    for (std::size_t i = 0; i < size; ++i) {
+        map.insert("key." + std::to_string(heavy(i) % (size / 4U + 1U)), "value-" + std::to_string(i));
+    }
+    std::stringstream stream;
+    double megabytes = 0;
+    {
+        stopwatch_t watch;
+        map.save(stream);
+        double ms = watch.elapsed_ms();
+        megabytes = static_cast<double>(stream.str().size()) / (1024.0 * 1024.0);
+        report("save (" + std::to_string(megabytes / (ms / 1000.0)) + " MB/s)", ms);
+    }
+    {
+        stopwatch_t watch;
+        decltype(map) loaded;
+        loaded.load(stream);
+        double ms = watch.elapsed_ms();
+        report("load (" + std::to_string(megabytes / (ms / 1000.0)) + " MB/s)", ms);
+    }
+    {
+        stopwatch_t watch;
+        auto entries = map.to_vector();
+        decltype(map) rebuilt;
+        for (const auto &entry : entries) {
+            rebuilt.insert(entry.first, entry.second);
+        }
+        report("to_vector and re-insert", watch.elapsed_ms());
+    }
+}
+
+/// @brief Returns the given percentile of some latencies.
+inline auto percentile(std::vector<double> samples, double fraction) -> double
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(samples.size() - 1U));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+    return samples[index];
+}
+
+/// @brief Runs single insertions and erasures, recording their latency in
+/// microseconds, until `done` returns true.
+template <typename Table, typename Done> auto foreground(Table &table, Done done) -> std::vector<double>
+{
+    std::vector<double> latencies;
+    for (std::size_t i = 0; !done(); ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (i % 2U == 0) {
+            table.insert("fg." + std::to_string(i), "value");
+        } else {
+            table.erase("fg." + std::to_string(i - 1U));
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    return latencies;
+}
+
+void bench_checkpoint(std::size_t size)
+{
+    using Checkpointed = ordered_multimap::checkpointed_ordered_multimap_t<std::string, std::string>;
+    using Shared       = Checkpointed::map_t;
+    const std::string path = "ordered_multimap_benchmark_checkpoint.bin";
+
+    Checkpointed table;
+    table.write([size](Shared &map) {
+        for (std::size_t i = 0; i < size; ++i) {
+            map.insert("key." + std::to_string(heavy(i) % (size / 4U + 1U)), "value-" + std::to_string(i));
+        }
+    });
+
+    auto print = [](const std::string &name, double ms, const std::vector<double> &latencies) {
+        report(name, ms);
+        std::cout << "    foreground ops: " << latencies.size() << ", p50: " << percentile(latencies, 0.50)
+                  << " us, p99: " << percentile(latencies, 0.99) << " us, max: " << percentile(latencies, 1.0) << " us\n";
+    };
+    {
+        // Baseline, the writer saves the map while holding the lock.
+        std::atomic<bool> finished(false);
+        stopwatch_t watch;
+        std::thread saver([&]() {
+            table.write([&path](Shared &map) {
+                std::ostringstream os;
+                map.save(os);
+                ordered_multimap::detail::replace_file(path, os.str());
+            });
+            finished = true;
+        });
+        auto latencies = foreground(table, [&finished]() { return finished.load(); });
+        saver.join();
+        print("save under the lock", watch.elapsed_ms(), latencies);
+    }
+    {
+        // The map was changed through write, the first checkpoint copies it.
+        table.checkpoint(path);
+        table.wait();
+        std::cout << "    first checkpoint, copying the map, writers blocked for: "
+                  << table.last_checkpoint().capture_ms << " ms\n";
+    }
+    {
+        stopwatch_t watch;
+        table.checkpoint(path);
+        auto latencies = foreground(table, [&table]() { return !table.checkpointing(); });
+        table.wait();
+        double ms = watch.elapsed_ms();
+        print("background checkpoint", ms, latencies);
+        std::cout << "    writers blocked for: " << table.last_checkpoint().capture_ms << " ms\n";
+    }
+    std::remove(path.c_str());
+}
+
+/// @brief Builds many header-sized maps, and looks up each of their keys.
+template <typename Headers> auto run_headers(std::size_t maps, const std::vector<std::string> &names) -> std::size_t
+{
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < maps; ++i) {
+        Headers headers;
+        std::size_t count = 4U + i % 9U;
+        for (std::size_t j = 0; j < count; ++j) {
+            headers.insert(names[j], "value");
+        }
+        for (std::size_t j = 0; j < names.size(); ++j) {
+            found += headers.count(names[j]);
+        }
+    }
+    return found;
+}
+
+void bench_small(std::size_t size)
+{
+    const std::vector<std::string> names = {
+        "host", "user-agent", "accept", "accept-encoding", "accept-language", "connection",
+        "cookie", "content-type", "content-length", "cache-control", "origin", "referer",
+    };
+    {
+        stopwatch_t watch;
+        std::size_t found = run_headers<ordered_multimap::ordered_multimap_t<std::string, std::string>>(size, names);
+        report("ordered_multimap_t       (" + std::to_string(found) + ")", watch.elapsed_ms());
+    }
+    {
+        stopwatch_t watch;
+        std::size_t found = run_headers<ordered_multimap::small_ordered_multimap_t<std::string, std::string>>(size, names);
+        report("small_ordered_multimap_t (" + std::to_string(found) + ")", watch.elapsed_ms());
+    }
+}
+
+/// @brief Looks up `lookups` keys, hit or miss, in a map with `entries` integer keys.
+template <typename Index> auto run_lookups(std::size_t entries, std::size_t lookups) -> std::size_t
+{
+    ordered_multimap::ordered_multimap_t<std::uint32_t, std::uint32_t, Index> map;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(static_cast<std::uint32_t>(heavy(i) % (entries * 2U)), static_cast<std::uint32_t>(i));
+    }
+    map = decltype(map)(source.begin(), source.end());
+    std::size_t found   = 0;
+    std::uint64_t state = entries;
+    for (std::size_t i = 0; i < lookups; ++i) {
+        state    = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto key = static_cast<std::uint32_t>((state >> 33U) % (entries * 2U));
+        found += map.count(key) + static_cast<std::size_t>(map.has(key + 1U));
+    }
+    return found;
+}
+
+void bench_flat(std::size_t size)
+{
+    for (std::size_t entries : {16U, 256U, 4096U, 65536U}) {
+        {
+            stopwatch_t watch;
+            std::size_t found = run_lookups<ordered_multimap::multimap_index_t>(entries, size);
+            report(std::to_string(entries) + " keys, std::multimap (" + std::to_string(found) + ")", watch.elapsed_ms());
+        }
+        {
+            stopwatch_t watch;
+            std::size_t found = run_lookups<ordered_multimap::flat_index_t>(entries, size);
+            report(std::to_string(entries) + " keys, flat_index_t  (" + std::to_string(found) + ")", watch.elapsed_ms());
+        }
+    }
+}
+
+/// @brief Returns the bytes allocated on the heap, zero if unknown.
+inline auto heap_usage() -> std::size_t
+{
+#if HAS_HEAP_USAGE
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/// @brief Builds `maps` configurations of 40 keys, drawn from a shared
+/// vocabulary, and reports the heap they take.
+template <typename Config, typename Name>
+void run_configs(const std::string &name, std::size_t maps, const std::vector<Name> &vocabulary)
+{
+    std::size_t heap = heap_usage();
+    stopwatch_t watch;
+    std::vector<Config> configs(maps);
+    for (std::size_t i = 0; i < maps; ++i) {
+        for (std::size_t j = 0; j < 40U; ++j) {
+            configs[i].insert(vocabulary[heavy(i * 40U + j) % vocabulary.size()], static_cast<int>(j));
+        }
+    }
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < maps; ++i) {
+        for (std::size_t j = 0; j < 40U; ++j) {
+            found += configs[i].count(vocabulary[(i + j) % vocabulary.size()]);
+        }
+    }
+    double ms = watch.elapsed_ms();
+    report(name + " (" + std::to_string(found) + ")", ms);
+    if (HAS_HEAP_USAGE) {
+        std::cout << "    heap: " << (heap_usage() - heap) / 1024U << " KiB\n";
+    }
+}
+
+void bench_interned(std::size_t size)
+{
+    // Hierarchical configuration keys, 2000 of them, mostly too long for the
+    // small string optimization.
+    const char *services[]   = {"payments", "search", "accounts", "gateway", "billing",
+                                "catalog", "checkout", "identity", "inventory", "shipping"};
+    const char *components[] = {"http", "database", "cache", "queue", "metrics",
+                                "tracing", "storage", "scheduler", "auth", "logging"};
+    const char *settings[]   = {"timeout_ms", "max_connections", "retry_count", "endpoint", "enabled",
+                                "pool_size", "buffer_bytes", "log_level", "ttl_seconds", "batch_size",
+                                "backoff_ms", "region", "replicas", "compression", "tls_certificate",
+                                "rate_limit", "queue_depth", "keepalive_ms", "read_only", "priority"};
+    std::vector<std::string> vocabulary;
+    for (const char *service : services) {
+        for (const char *component : components) {
+            for (const char *setting : settings) {
+                vocabulary.push_back(std::string(service) + "." + component + "." + setting);
+            }
+        }
+    }
+    run_configs<ordered_multimap::ordered_multimap_t<std::string, int>>("std::string keys", size, vocabulary);
+    std::size_t heap = heap_usage();
+    std::vector<ordered_multimap::symbol_t> symbols(vocabulary.begin(), vocabulary.end());
+    if (HAS_HEAP_USAGE) {
+        std::cout << "  intern pool heap: " << (heap_usage() - heap) / 1024U << " KiB\n";
+    }
+    run_configs<ordered_multimap::interned_ordered_multimap_t<int>>("symbol_t keys   ", size, symbols);
+}
+
+/// @brief Looks up `lookups` keys, hit or miss, among `keys`, and counts the
+/// entries under `prefixes` prefixes.
+template <typename Index>
+auto run_string_lookups(const std::vector<std::string> &keys, std::size_t lookups, std::size_t prefixes) -> std::size_t
+{
+    ordered_multimap::ordered_multimap_t<std::string, std::size_t, Index> map;
+    for (std::size_t i = 0; i < keys.size(); i += 2U) {
+        map.insert(keys[i], i);
+    }
+    std::size_t found   = 0;
+    std::uint64_t state = keys.size();
+    for (std::size_t i = 0; i < lookups; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        found += map.count(keys[(state >> 33U) % keys.size()]);
+    }
+    for (std::size_t i = 0; i < prefixes; ++i) {
+        const std::string &key = keys[heavy(i) % keys.size()];
+        for (const auto &entry : map.prefix_range(key.substr(0, key.rfind('.') + 1U))) {
+            found += entry.second & 1U;
+        }
+    }
+    return found;
+}
+
+void bench_radix(std::size_t size)
+{
+    // Hierarchical configuration keys, half of them inserted.
+    for (std::size_t count : {1000U, 100000U}) {
+        std::vector<std::string> keys;
+        for (std::size_t i = 0; i < count; ++i) {
+            keys.push_back(
+                "cluster" + std::to_string(i % 7U) + ".service" + std::to_string(i / 7U % 50U) + ".setting_" +
+                std::to_string(i));
+        }
+        {
+            stopwatch_t watch;
+            std::size_t found = run_string_lookups<ordered_multimap::multimap_index_t>(keys, size, size / 100U);
+            report(std::to_string(count) + " keys, std::multimap (" + std::to_string(found) + ")", watch.elapsed_ms());
+        }
+        {
+            stopwatch_t watch;
+            std::size_t found = run_string_lookups<ordered_multimap::radix_index_t>(keys, size, size / 100U);
+            report(std::to_string(count) + " keys, radix_index_t (" + std::to_string(found) + ")", watch.elapsed_ms());
+        }
+    }
+}
+
+/// @brief Builds a map with `entries` random 64-bit keys, optimized for reads
+/// if the index supports it, then reports the average latency of `lookups`
+/// dependent lookups, each key derived from the previous result.
+template <typename Index> void run_latency(const std::string &name, std::size_t entries, std::size_t lookups)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(heavy(i) % (entries * 2U), i);
+    }
+    stopwatch_t build;
+    ordered_multimap::ordered_multimap_t<std::uint64_t, std::uint64_t, Index> map(source.begin(), source.end());
+    map.optimize_for_reads();
+    double build_ms = build.elapsed_ms();
+    std::vector<std::pair<std::uint64_t, std::uint64_t>>().swap(source);
+    stopwatch_t watch;
+    std::uint64_t state = entries;
+    std::size_t found   = 0;
+    for (std::size_t i = 0; i < lookups; ++i) {
+        state *= 0x9E3779B97F4A7C15ULL;
+        auto it = map.find((state >> 20U) % (entries * 2U));
+        found += it != map.end() ? 1U : 0U;
+        state += it != map.end() ? it->second : i;
+    }
+    double ms = watch.elapsed_ms();
+    report(name + " (" + std::to_string(found) + ")", ms);
+    std::cout << "    " << ms * 1e6 / static_cast<double>(lookups) << " ns per lookup, built in " << build_ms << " ms\n";
+}
+
+void bench_btree(std::size_t size)
+{
+    // The largest maps take several times the last level cache.
+    for (std::size_t entries : {1000U, 100000U, 1000000U, 10000000U}) {
+        run_latency<ordered_multimap::multimap_index_t>(std::to_string(entries) + " keys, std::multimap", entries, size);
+        run_latency<ordered_multimap::btree_index_t>(std::to_string(entries) + " keys, btree_index_t", entries, size);
+    }
+}
+
+void bench_eytzinger(std::size_t size)
+{
+    for (std::size_t entries : {1000U, 100000U, 1000000U, 10000000U}) {
+        run_latency<ordered_multimap::multimap_index_t>(std::to_string(entries) + " keys, std::multimap    ", entries, size);
+        run_latency<ordered_multimap::eytzinger_index_t>(std::to_string(entries) + " keys, eytzinger_index_t", entries, size);
+    }
+}
+
+/// @brief Checks `lookups` keys of a map with `entries` keys, a share of them
+/// absent, and reports the time taken by the lookups alone.
+template <typename Index>
+void run_misses(const std::string &name, std::size_t entries, std::size_t lookups, std::size_t miss_percent)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(heavy(i) * 2U, i);
+    }
+    ordered_multimap::ordered_multimap_t<std::uint64_t, std::uint64_t, Index> map(source.begin(), source.end());
+    stopwatch_t watch;
+    std::size_t found   = 0;
+    std::uint64_t state = entries;
+    for (std::size_t i = 0; i < lookups; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        // Present keys are even, absent ones odd.
+        std::uint64_t key = source[(state >> 33U) % entries].first;
+        found += static_cast<std::size_t>(map.has((state >> 20U) % 100U < miss_percent ? key + 1U : key));
+    }
+    report(name + " (" + std::to_string(found) + ")", watch.elapsed_ms());
+}
+
+void bench_bloom(std::size_t size)
+{
+    for (std::size_t miss_percent : {0U, 25U, 50U, 75U, 90U, 99U}) {
+        std::string name = std::to_string(miss_percent) + "% misses, ";
+        run_misses<ordered_multimap::multimap_index_t>(name + "std::multimap", size, size, miss_percent);
+        run_misses<ordered_multimap::bloom_index_t>(name + "bloom_index_t", size, size, miss_percent);
+    }
+}
+
+/// @brief Looks up `lookups` random keys, in batches of 256, in a map with
+/// `entries` random keys, with a loop of `find` and with `find_many`.
+template <typename Index> void run_batches(const std::string &name, std::size_t entries, std::size_t lookups)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(heavy(i) % (entries * 2U), i);
+    }
+    using Batched = ordered_multimap::ordered_multimap_t<std::uint64_t, std::uint64_t, Index>;
+    Batched map(source.begin(), source.end());
+    map.optimize_for_reads();
+    std::vector<std::pair<std::uint64_t, std::uint64_t>>().swap(source);
+    std::vector<std::uint64_t> keys(256U);
+    std::vector<typename Batched::iterator> results(keys.size());
+    for (int batched = 0; batched < 2; ++batched) {
+        stopwatch_t watch;
+        std::uint64_t state = entries;
+        std::size_t found   = 0;
+        for (std::size_t done = 0; done < lookups; done += keys.size()) {
+            for (std::uint64_t &key : keys) {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                key   = (state >> 20U) % (entries * 2U);
+            }
+            if (batched != 0) {
+                map.find_many(keys.begin(), keys.end(), results.begin());
+            } else {
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    results[i] = map.find(keys[i]);
+                }
+            }
+            for (const typename Batched::iterator &result : results) {
+                found += result != map.end() ? 1U : 0U;
+            }
+        }
+        report(name + (batched != 0 ? ", find_many" : ", find loop") + " (" + std::to_string(found) + ")", watch.elapsed_ms());
+    }
+}
+
+void bench_find_many(std::size_t size)
+{
+    // Ten million entries take several times the last level cache.
+    for (std::size_t entries : {100000U, 10000000U}) {
+        std::string name = std::to_string(entries) + " keys, ";
+        run_batches<ordered_multimap::multimap_index_t>(name + "std::multimap    ", entries, size);
+        run_batches<ordered_multimap::btree_index_t>(name + "btree_index_t    ", entries, size);
+        run_batches<ordered_multimap::eytzinger_index_t>(name + "eytzinger_index_t", entries, size);
+    }
+}
+
+/// @brief Removes `percent` of the distinct keys of a map with `entries`
+/// random keys, with a loop of `erase(key)` and with `erase_many`.
+template <typename Index> void run_expiry(const std::string &name, std::size_t entries, std::size_t percent)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(heavy(i) % entries, i);
+    }
+    std::vector<std::uint64_t> expired;
+    for (std::size_t i = 0; i < entries; ++i) {
+        if (heavy(i + entries) % 1000U < percent * 10U) {
+            expired.push_back(i);
+        }
+    }
+    // Expired keys come in no particular order.
+    std::sort(expired.begin(), expired.end(), [](std::uint64_t lhs, std::uint64_t rhs) { return heavy(lhs) < heavy(rhs); });
+    using Expiring = ordered_multimap::ordered_multimap_t<std::uint64_t, std::uint64_t, Index>;
+    for (int batched = 0; batched < 2; ++batched) {
+        Expiring map(source.begin(), source.end());
+        stopwatch_t watch;
+        std::size_t removed = 0;
+        if (batched != 0) {
+            removed = map.erase_many(expired.begin(), expired.end());
+        } else {
+            for (std::uint64_t key : expired) {
+                removed += map.count(key);
+                map.erase(key);
+            }
+        }
+        report(name + (batched != 0 ? ", erase_many" : ", erase loop") + " (" + std::to_string(removed) + ")", watch.elapsed_ms());
+    }
+}
+
+void bench_erase_many(std::size_t size)
+{
+    for (std::size_t percent : {1U, 5U, 10U, 50U, 90U}) {
+        std::string name = std::to_string(percent) + "% of the keys, ";
+        run_expiry<ordered_multimap::multimap_index_t>(name + "std::multimap", size, percent);
+        run_expiry<ordered_multimap::btree_index_t>(name + "btree_index_t", size, percent);
+        run_expiry<ordered_multimap::flat_index_t>(name + "flat_index_t ", size / 10U, percent);
+    }
+}
+
+/// @brief Removes `percent` of the entries of a map with `entries` random
+/// keys, with a loop of `erase(iterator)` and with `erase_if`.
+template <typename Index> void run_removal(const std::string &name, std::size_t entries, std::size_t percent)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> source;
+    source.reserve(entries);
+    for (std::size_t i = 0; i < entries; ++i) {
+        source.emplace_back(heavy(i) % entries, i);
+    }
+    using Pruned = ordered_multimap::ordered_multimap_t<std::uint64_t, std::uint64_t, Index>;
+    auto matches = [percent](const typename Pruned::list_entry_t &entry) {
+        return heavy(entry.second + 1U) % 100U < percent;
+    };
+    for (int batched = 0; batched < 2; ++batched) {
+        Pruned map(source.begin(), source.end());
+        stopwatch_t watch;
+        std::size_t removed = 0;
+        if (batched != 0) {
+            removed = map.erase_if(matches);
+        } else {
+            for (auto it = map.begin(); it != map.end();) {
+                if (matches(*it)) {
+                    it = map.erase(it);
+                    ++removed;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        report(name + (batched != 0 ? ", erase_if" : ", erase loop") + " (" + std::to_string(removed) + ")", watch.elapsed_ms());
+    }
+}
+
+void bench_erase_if(std::size_t size)
+{
+    for (std::size_t percent : {10U, 50U, 90U}) {
+        std::string name = std::to_string(percent) + "% of the entries, ";
+        run_removal<ordered_multimap::multimap_index_t>(name + "std::multimap", size, percent);
+        run_removal<ordered_multimap::btree_index_t>(name + "btree_index_t", size, percent);
+        run_removal<ordered_multimap::flat_index_t>(name + "flat_index_t ", size / 10U, percent);
+    }
+}
+
+/// @brief A registered benchmark.
+struct benchmark_t {
+    /// @brief The name used to select the benchmark.
+    const char *name;
+    /// @brief The function running the benchmark.
+    void (*run)(std::size_t);
+    /// @brief The default size of the benchmark.
+    std::size_t size;
+};
+
+int main(int argc, char *argv[])
+{
+    const benchmark_t benchmarks[] = {
+        {"parallel", bench_parallel, 10000000U},
+        {"build", bench_build, 10000000U},
+        {"serialization", bench_serialization, 1000000U},
+        {"checkpoint", bench_checkpoint, 1000000U},
+        {"small", bench_small, 1000000U},
+        {"flat", bench_flat, 10000000U},
+        {"interned", bench_interned, 20000U},
+        {"radix", bench_radix, 1000000U},
+        {"btree", bench_btree, 2000000U},
+        {"eytzinger", bench_eytzinger, 2000000U},
+        {"bloom", bench_bloom, 1000000U},
+        {"find_many", bench_find_many, 2000000U},
+        {"erase_many", bench_erase_many, 1000000U},
+        {"erase_if", bench_erase_if, 1000000U},
+    };
+
+    const char *selected = argc > 1 ? argv[1] : nullptr;
+    for (const benchmark_t &benchmark : benchmarks) {
+        if (selected != nullptr && std::strcmp(selected, benchmark.name) != 0) {
+            continue;
+        }
+        std::size_t size = argc > 2 ? static_cast<std::size_t>(std::strtoull(argv[2], nullptr, 10)) : benchmark.size;
+        std::cout << "== " << benchmark.name << " (" << size << " entries)\n";
+        benchmark.run(size);
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+/// @file bloom_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A Bloom filter in front of an index, to answer negative lookups
+/// without searching it.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief An index whose exact-match lookups first ask a Bloom filter.
+/// @details The filter is split into blocks of 256 bits, and a key sets one
+/// bit in each of the eight 32-bit words of its block: testing a key takes a
+/// single cache line. With 16 bits per key, at most half full, about one
+/// absent key out of a thousand is searched in the index anyway. `find`,
+/// `count` and `equal_range`, hence `has`, `find`, `count`, `erase(key)` and
+/// `extract` of `ordered_multimap_t`, return at once for the other absent
+/// keys. Bloom filters cannot forget keys: the filter is rebuilt from the
+/// index when the entries removed since the last rebuild outnumber those
+/// left, and doubled when it fills.
+/// @tparam Key the type of the key, hashable with `std::hash`.
+/// @tparam Table the type of the index behind the filter.
+template <typename Key, typename Table> class bloom_multimap_t
+{
+    /// @brief A block of the filter, the bits one key can set.
+    struct block_t {
+        /// @brief The words, one bit of each is set per key.
+        std::uint32_t words[8];
+    };
+
+    /// @brief The capacity of the filter.
+    enum : std::size_t {
+        keys_per_block = 16U, ///< Keys per block, when the filter is full.
+    };
+
+public:
+    /// @brief The type of the entries.
+    using value_type     = typename Table::value_type;
+    /// @brief Iterator over the entries.
+    using iterator       = typename Table::iterator;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = typename Table::const_iterator;
+    /// @brief Compares the entries by key.
+    using value_compare  = typename Table::value_compare;
+
+    /// @brief Construct an empty map, without a filter.
+    bloom_multimap_t()
+        : table()
+        , blocks()
+        , added()
+        , removed()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Checks if the filter may contain the key.
+    /// @param key the key.
+    /// @return false if the key is certainly not in the index.
+    auto may_contain(const Key &key) const -> bool
+    {
+        if (blocks.empty()) {
+            return false;
+        }
+        std::uint64_t hash   = bloom_multimap_t::hash(key);
+        const block_t &block = blocks[static_cast<std::size_t>(hash >> 32U) & (blocks.size() - 1U)];
+        for (std::size_t i = 0; i < 8U; ++i) {
+            if ((block.words[i] & bloom_multimap_t::mask(hash, i)) == 0U) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Rebuilds the filter from the keys of the index, forgetting
+    /// those removed.
+    void rebuild_filter() { this->rebuild(table.size()); }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return table.size(); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return table.size() == 0; }
+
+    /// @brief Removes all the entries, and releases the filter.
+    void clear()
+    {
+        table.clear();
+        std::vector<block_t>().swap(blocks);
+        added   = 0;
+        removed = 0;
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(bloom_multimap_t &other)
+    {
+        table.swap(other.table);
+        blocks.swap(other.blocks);
+        std::swap(added, other.added);
+        std::swap(removed, other.removed);
+    }
+
+    /// @brief Turns the index into its read-optimized layout, if it has one.
+    void optimize_for_reads() { detail::optimize_for_reads(table, 0); }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return table.value_comp(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return table.begin(); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return table.begin(); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return table.end(); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator { return table.end(); }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        this->add(entry.first);
+        return table.insert(entry);
+    }
+
+    /// @brief Inserts an entry, after those with the same key, as close as
+    /// possible to the hint.
+    /// @param hint the suggested position.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator hint, const value_type &entry) -> iterator
+    {
+        this->add(entry.first);
+        return table.insert(hint, entry);
+    }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first) {
+            this->insert(static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator
+    {
+        iterator next = table.erase(position);
+        this->forget(1U);
+        return next;
+    }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        auto count    = static_cast<std::size_t>(std::distance(first, last));
+        iterator next = table.erase(first, last);
+        this->forget(count);
+        return next;
+    }
+
+    /// @brief Removes entries whose key is in a sorted range of distinct
+    /// keys, as the index behind the filter does.
+    /// @tparam ForwardIt the type of iterator, over keys.
+    /// @tparam Visitor the type of the callback.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with the key and the mapped value of each entry with
+    /// one of the keys, returns true if the entry is to be removed.
+    template <typename ForwardIt, typename Visitor> void erase_many(ForwardIt first, ForwardIt last, Visitor visit)
+    {
+        std::size_t count = 0;
+        detail::erase_many(
+            table, first, last,
+            [&visit, &count](const Key &key, const typename value_type::second_type &handle) {
+                if (!visit(key, handle)) {
+                    return false;
+                }
+                ++count;
+                return true;
+            },
+            0);
+        this->forget(count);
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator { return this->may_contain(key) ? table.find(key) : table.end(); }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator { return this->may_contain(key) ? table.find(key) : table.end(); }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t { return this->may_contain(key) ? table.count(key) : 0U; }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator { return table.lower_bound(key); }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator { return table.lower_bound(key); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator { return table.upper_bound(key); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator { return table.upper_bound(key); }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        return this->may_contain(key) ? table.equal_range(key) : std::make_pair(table.end(), table.end());
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        return this->may_contain(key) ? table.equal_range(key) : std::make_pair(table.end(), table.end());
+    }
+
+private:
+    /// @brief Hashes a key, and spreads the bits of the hash.
+    /// @param key the key.
+    /// @return the hash, whose upper half selects the block.
+    static auto hash(const Key &key) -> std::uint64_t
+    {
+        std::uint64_t hash = static_cast<std::uint64_t>(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ULL;
+        return hash ^ (hash >> 29U);
+    }
+
+    /// @brief Returns the bit a hash sets in a word of its block.
+    /// @param hash the hash.
+    /// @param word the word.
+    /// @return the mask of the bit.
+    static auto mask(std::uint64_t hash, std::size_t word) -> std::uint32_t
+    {
+        static const std::uint32_t salts[8] = {
+            0x47B6137BU, 0x44974D91U, 0x8824AD5BU, 0xA2B7289DU, 0x705495C7U, 0x2DF1424BU, 0x9EFC4947U, 0x5C6BFB31U};
+        return 1U << ((static_cast<std::uint32_t>(hash) * salts[word]) >> 27U);
+    }
+
+    /// @brief Sets the bits of a key.
+    /// @param key the key.
+    void set(const Key &key)
+    {
+        std::uint64_t hash = bloom_multimap_t::hash(key);
+        block_t &block     = blocks[static_cast<std::size_t>(hash >> 32U) & (blocks.size() - 1U)];
+        for (std::size_t i = 0; i < 8U; ++i) {
+            block.words[i] |= bloom_multimap_t::mask(hash, i);
+        }
+    }
+
+    /// @brief Adds a key about to be inserted, growing the filter if full.
+    /// @param key the key.
+    void add(const Key &key)
+    {
+        if (added >= blocks.size() * keys_per_block) {
+            this->rebuild(table.size() + 1U);
+        }
+        this->set(key);
+        ++added;
+    }
+
+    /// @brief Records removed entries, rebuilding the filter once they
+    /// outnumber those left.
+    /// @param count the number of entries removed.
+    void forget(std::size_t count)
+    {
+        removed += count;
+        if (removed > table.size() && removed >= keys_per_block) {
+            this->rebuild(table.size());
+        }
+    }
+
+    /// @brief Sizes the filter for the given number of keys, at most half
+    /// full, and adds the keys of the index.
+    /// @param expected the number of keys.
+    void rebuild(std::size_t expected)
+    {
+        std::size_t count = 1;
+        while (count * keys_per_block < 2U * expected) {
+            count *= 2U;
+        }
+        blocks.assign(expected == 0U ? 0U : count, block_t());
+        added   = 0;
+        removed = 0;
+        if (!blocks.empty()) {
+            for (const_iterator it = table.begin(); it != table.end(); ++it) {
+                this->set(it->first);
+                ++added;
+            }
+        }
+    }
+
+    /// @brief The index.
+    Table table;
+    /// @brief The filter, its size is a power of two.
+    std::vector<block_t> blocks;
+    /// @brief The keys added to the filter since it was built.
+    std::size_t added;
+    /// @brief The entries removed since the filter was built.
+    std::size_t removed;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which puts a Bloom filter
+/// in front of the index of another policy.
+/// @details For instance:
+/// @code
+/// ordered_multimap_t<std::uint64_t, Session, basic_bloom_index_t<btree_index_t>> sessions;
+/// @endcode
+/// @tparam Index the policy providing the index behind the filter.
+template <typename Index = multimap_index_t> struct basic_bloom_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle>
+    using type = bloom_multimap_t<Key, typename Index::template type<Key, Handle>>;
+};
+
+/// @brief A Bloom filter in front of a `std::multimap`.
+using bloom_index_t = basic_bloom_index_t<>;
+
+} // namespace ordered_multimap
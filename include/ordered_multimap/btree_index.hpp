@@ -0,0 +1,791 @@
+/// @file btree_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A B+tree index, with wide nodes and linked leaves.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/flat_index.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <type_traits>
+#include <utility>
+
+namespace ordered_multimap
+{
+
+/// @brief A multimap stored in a B+tree, whose nodes hold many keys.
+/// @details It implements the subset of the `std::multimap` interface used by
+/// `ordered_multimap_t`. A red-black tree takes one allocation, and one cache
+/// miss, per level: here each node holds the keys of several cache lines,
+/// searched like `flat_index_t` (with SIMD compares for integer keys), so a
+/// lookup visits a few nodes only. The entries live in the leaves, which are
+/// linked for ordered scans. Inserting sorted entries at the end, as done when
+/// the index is rebuilt, fills the nodes completely, which bulk loads the
+/// tree. Leaves are not merged when they shrink, they are released once empty.
+/// @tparam Key the type of the key, default constructible and assignable.
+/// @tparam Mapped the type of the mapped value.
+/// @tparam NodeBytes the size of the keys of a node, in bytes.
+template <typename Key, typename Mapped, std::size_t NodeBytes = 256> class btree_multimap_t
+{
+public:
+    /// @brief The number of keys of a node.
+    enum : std::size_t {
+        capacity = NodeBytes / sizeof(Key) > 8U ? NodeBytes / sizeof(Key) : 8U, ///< At least 8.
+    };
+
+private:
+    struct inner_t;
+
+    /// @brief The common part of the nodes.
+    struct node_t {
+        /// @brief The parent, null for the root.
+        inner_t *parent;
+        /// @brief The number of keys.
+        std::size_t count;
+        /// @brief Whether the node is a leaf.
+        bool leaf;
+    };
+
+    /// @brief A leaf, holding the entries.
+    struct leaf_t : node_t {
+        /// @brief The keys, sorted.
+        Key keys[capacity];
+        /// @brief The mapped values.
+        Mapped mapped[capacity];
+        /// @brief The leaf with the previous keys.
+        leaf_t *previous;
+        /// @brief The leaf with the next keys.
+        leaf_t *next;
+    };
+
+    /// @brief An inner node, whose children are separated by its keys.
+    /// @details The keys of `children[i]` are not greater than `keys[i]`, and
+    /// the keys of `children[i + 1]` are not less than it.
+    struct inner_t : node_t {
+        /// @brief The separators.
+        Key keys[capacity];
+        /// @brief The children, one more than the keys.
+        node_t *children[capacity + 1U];
+    };
+
+public:
+    /// @brief The type of the entries, when copied out of the map.
+    using value_type = std::pair<Key, Mapped>;
+
+    /// @brief A reference to an entry, with the members of a `std::pair`.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename MappedReference> struct reference_t {
+        /// @brief The key.
+        const Key &first;
+        /// @brief The mapped value.
+        MappedReference second;
+
+        /// @brief Copies the entry.
+        /// @return a copy of the entry.
+        operator value_type() const { return value_type(first, second); }
+    };
+
+    /// @brief An iterator over the entries, in key order.
+    /// @tparam Leaf the type of the leaves, const or not.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename Leaf, typename MappedReference> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename btree_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a reference to an entry.
+        using reference         = reference_t<MappedReference>;
+
+        /// @brief Provides `operator->` for the references.
+        struct pointer {
+            /// @brief The reference.
+            reference entry;
+
+            /// @brief Returns the reference.
+            /// @return a pointer to the reference.
+            auto operator->() -> reference * { return &entry; }
+        };
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : leaf(nullptr)
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _leaf the leaf, null for the end.
+        /// @param _position the position inside the leaf.
+        basic_iterator(Leaf *_leaf, std::size_t _position)
+            : leaf(_leaf)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the mutable iterator.
+        template <typename OtherLeaf, typename OtherReference>
+        basic_iterator(const basic_iterator<OtherLeaf, OtherReference> &other)
+            : leaf(other.leaf)
+            , position(other.position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference { return reference{leaf->keys[position], leaf->mapped[position]}; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry, possibly in the next leaf.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            if (++position == leaf->count) {
+                leaf     = leaf->next;
+                position = 0;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry, possibly in the next leaf.
+        /// @return a copy of this iterator, before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool
+        {
+            return leaf == other.leaf && position == other.position;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class btree_multimap_t;
+        template <typename, typename> friend class basic_iterator;
+
+        /// @brief The leaf.
+        Leaf *leaf;
+        /// @brief The position inside the leaf.
+        std::size_t position;
+    };
+
+    /// @brief Iterator over the entries.
+    using iterator       = basic_iterator<leaf_t, Mapped &>;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = basic_iterator<const leaf_t, const Mapped &>;
+
+    /// @brief Compares the entries by key.
+    struct value_compare {
+        /// @brief Compares two entries.
+        /// @param lhs the first entry.
+        /// @param rhs the second entry.
+        /// @return true if the key of the first is less than the one of the second.
+        template <typename Lhs, typename Rhs> auto operator()(const Lhs &lhs, const Rhs &rhs) const -> bool
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    /// @brief Construct an empty map.
+    btree_multimap_t()
+        : root()
+        , head()
+        , tail()
+        , entries()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The map is only copied through `ordered_multimap_t`, which
+    /// builds a new index.
+    btree_multimap_t(const btree_multimap_t &) = delete;
+
+    /// @brief Move constructor.
+    /// @param other the map to move from, left empty.
+    btree_multimap_t(btree_multimap_t &&other) noexcept
+        : btree_multimap_t()
+    {
+        this->swap(other);
+    }
+
+    /// @brief Destructor.
+    ~btree_multimap_t() { this->clear(); }
+
+    /// @brief The map is only copied through `ordered_multimap_t`, which
+    /// builds a new index.
+    /// @return nothing, this function is deleted.
+    auto operator=(const btree_multimap_t &) -> btree_multimap_t & = delete;
+
+    /// @brief Move assignment.
+    /// @param other the map to move from, left empty.
+    /// @return a reference to the current map.
+    auto operator=(btree_multimap_t &&other) noexcept -> btree_multimap_t &
+    {
+        if (this != &other) {
+            this->clear();
+            this->swap(other);
+        }
+        return *this;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return entries; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return entries == 0; }
+
+    /// @brief Removes all the entries.
+    void clear()
+    {
+        destroy(root);
+        root    = nullptr;
+        head    = nullptr;
+        tail    = nullptr;
+        entries = 0;
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(btree_multimap_t &other)
+    {
+        std::swap(root, other.root);
+        std::swap(head, other.head);
+        std::swap(tail, other.tail);
+        std::swap(entries, other.entries);
+    }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return value_compare(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return iterator(head, 0); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return const_iterator(head, 0); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return iterator(nullptr, 0); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator { return const_iterator(nullptr, 0); }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        if (root == nullptr) {
+            return this->append(entry);
+        }
+        std::pair<leaf_t *, std::size_t> position = this->descend<true>(entry.first);
+        return this->insert_at(position.first, position.second, entry);
+    }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @details With the end as hint, an entry not less than the last one is
+    /// appended to the last leaf, without searching, and full nodes are not
+    /// split but followed by new ones: sorted entries fill the tree.
+    /// @param hint the suggested position.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator hint, const value_type &entry) -> iterator
+    {
+        if (hint == this->end() && (tail == nullptr || !(entry.first < tail->keys[tail->count - 1U]))) {
+            return this->append(entry);
+        }
+        return this->insert(entry);
+    }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first) {
+            this->insert(static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator { return this->erase(position, std::next(position)); }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        auto *leaf           = const_cast<leaf_t *>(first.leaf);
+        std::size_t position = first.position;
+        // Removes the tail of every leaf before the last one.
+        while (leaf != last.leaf) {
+            leaf_t *next = leaf->next;
+            entries -= leaf->count - position;
+            leaf->count = position;
+            if (leaf->count == 0U) {
+                this->remove_leaf(leaf);
+            }
+            leaf     = next;
+            position = 0;
+        }
+        // The last iterator refers to an entry, which remains in its leaf.
+        if (position < last.position) {
+            std::size_t removed = last.position - position;
+            std::move(leaf->keys + last.position, leaf->keys + leaf->count, leaf->keys + position);
+            std::move(leaf->mapped + last.position, leaf->mapped + leaf->count, leaf->mapped + position);
+            leaf->count -= removed;
+            entries -= removed;
+        }
+        return iterator(leaf, position);
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator
+    {
+        iterator it = this->lower_bound(key);
+        return it.leaf != nullptr && !(key < it.leaf->keys[it.position]) ? it : this->end();
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        const_iterator it = this->lower_bound(key);
+        return it.leaf != nullptr && !(key < it.leaf->keys[it.position]) ? it : this->end();
+    }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        std::size_t result = 0;
+        const_iterator it  = this->lower_bound(key);
+        for (const leaf_t *leaf = it.leaf; leaf != nullptr; leaf = leaf->next) {
+            std::size_t last = detail::search<true>(leaf->keys, leaf->count, key);
+            result += last - (leaf == it.leaf ? it.position : 0U);
+            if (last < leaf->count) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator { return this->bound<false>(key); }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator { return const_cast<btree_multimap_t *>(this)->bound<false>(key); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator { return this->bound<true>(key); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator { return const_cast<btree_multimap_t *>(this)->bound<true>(key); }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+    /// @brief Finds the first entry of each key of a range.
+    /// @details The keys are searched in groups, one level at a time: the
+    /// nodes of the next level are prefetched for the whole group before any
+    /// of them is read, so their cache misses overlap.
+    /// @tparam ForwardIt the type of iterator over the keys.
+    /// @tparam Visitor the type of function receiving the results.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with an iterator to the entry, or the end, for each
+    /// key, in the order of the keys.
+    template <typename ForwardIt, typename Visitor> void find_many(ForwardIt first, ForwardIt last, Visitor visit)
+    {
+        this->find_batch<iterator>(first, last, visit);
+    }
+
+    /// @brief Finds the first entry of each key of a range.
+    /// @tparam ForwardIt the type of iterator over the keys.
+    /// @tparam Visitor the type of function receiving the results.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with an iterator to the entry, or the end, for each
+    /// key, in the order of the keys.
+    template <typename ForwardIt, typename Visitor> void find_many(ForwardIt first, ForwardIt last, Visitor visit) const
+    {
+        this->find_batch<const_iterator>(first, last, visit);
+    }
+
+private:
+    /// @brief The number of keys searched together by `find_many`.
+    enum : std::size_t {
+        batch = 16U, ///< Enough to keep the memory busy.
+    };
+
+    /// @brief Prefetches the header and the keys of a node.
+    /// @param node the node.
+    static void prefetch(const node_t *node)
+    {
+#if defined(__GNUC__)
+        const char *bytes = reinterpret_cast<const char *>(node);
+        for (std::size_t offset = 0; offset < sizeof(node_t) + NodeBytes; offset += 64U) {
+            __builtin_prefetch(bytes + offset);
+        }
+#else
+        (void)node;
+#endif
+    }
+
+    /// @brief Implements `find_many`.
+    /// @tparam Iterator the type of iterator passed to the visitor.
+    template <typename Iterator, typename ForwardIt, typename Visitor>
+    void find_batch(ForwardIt first, ForwardIt last, Visitor &visit) const
+    {
+        const Key *keys[batch];
+        node_t *nodes[batch];
+        while (first != last) {
+            std::size_t count = 0;
+            for (; count < batch && first != last; ++first, ++count) {
+                keys[count]  = &*first;
+                nodes[count] = root;
+            }
+            // All the leaves are at the same depth.
+            while (root != nullptr && !nodes[0]->leaf) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    auto *inner = static_cast<inner_t *>(nodes[i]);
+                    nodes[i]    = inner->children[detail::search<false>(inner->keys, inner->count, *keys[i])];
+                    prefetch(nodes[i]);
+                }
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                auto *leaf           = static_cast<leaf_t *>(nodes[i]);
+                std::size_t position = leaf != nullptr ? detail::search<false>(leaf->keys, leaf->count, *keys[i]) : 0U;
+                if (leaf != nullptr && position == leaf->count) {
+                    leaf     = leaf->next;
+                    position = 0;
+                }
+                bool found = leaf != nullptr && !(*keys[i] < leaf->keys[position]);
+                visit(found ? Iterator(leaf, position) : Iterator(nullptr, 0));
+            }
+        }
+    }
+
+    /// @brief Finds the leaf, and the position inside it, of the first key
+    /// not less than (or, if Upper, greater than) the given one.
+    /// @tparam Upper whether to skip the keys equal to the given one.
+    /// @param key the key.
+    /// @return the leaf and the position, which can be past its last key.
+    template <bool Upper> auto descend(const Key &key) const -> std::pair<leaf_t *, std::size_t>
+    {
+        node_t *node = root;
+        while (!node->leaf) {
+            auto *inner = static_cast<inner_t *>(node);
+            node        = inner->children[detail::search<Upper>(inner->keys, inner->count, key)];
+        }
+        auto *leaf = static_cast<leaf_t *>(node);
+        return std::make_pair(leaf, detail::search<Upper>(leaf->keys, leaf->count, key));
+    }
+
+    /// @brief Returns the first entry not less than (or, if Upper, greater
+    /// than) the given key.
+    /// @tparam Upper whether to skip the keys equal to the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    template <bool Upper> auto bound(const Key &key) -> iterator
+    {
+        if (root == nullptr) {
+            return this->end();
+        }
+        std::pair<leaf_t *, std::size_t> position = this->descend<Upper>(key);
+        // The following keys, if any, start the next leaf.
+        if (position.second == position.first->count) {
+            return iterator(position.first->next, 0);
+        }
+        return iterator(position.first, position.second);
+    }
+
+    /// @brief Inserts an entry inside a leaf, splitting it if full.
+    /// @param leaf the leaf.
+    /// @param position the position of the entry.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert_at(leaf_t *leaf, std::size_t position, const value_type &entry) -> iterator
+    {
+        if (leaf->count == capacity) {
+            // Moves the upper half to a new leaf, on the right.
+            leaf_t *right    = this->make_leaf(leaf);
+            std::size_t half = capacity / 2U;
+            std::move(leaf->keys + half, leaf->keys + capacity, right->keys);
+            std::move(leaf->mapped + half, leaf->mapped + capacity, right->mapped);
+            right->count = capacity - half;
+            leaf->count  = half;
+            this->insert_child(leaf, right->keys[0], right, false);
+            if (position > half) {
+                leaf = right;
+                position -= half;
+            }
+        }
+        std::move_backward(leaf->keys + position, leaf->keys + leaf->count, leaf->keys + leaf->count + 1U);
+        std::move_backward(leaf->mapped + position, leaf->mapped + leaf->count, leaf->mapped + leaf->count + 1U);
+        leaf->keys[position]   = entry.first;
+        leaf->mapped[position] = entry.second;
+        ++leaf->count;
+        ++entries;
+        return iterator(leaf, position);
+    }
+
+    /// @brief Appends an entry not less than all the others.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto append(const value_type &entry) -> iterator
+    {
+        if (tail == nullptr) {
+            root = head = tail = this->make_leaf(nullptr);
+        } else if (tail->count == capacity) {
+            // Leaves the last leaf full, and starts a new one.
+            leaf_t *last = tail;
+            tail         = this->make_leaf(last);
+            this->insert_child(last, entry.first, tail, true);
+        }
+        tail->keys[tail->count]   = entry.first;
+        tail->mapped[tail->count] = entry.second;
+        ++entries;
+        return iterator(tail, tail->count++);
+    }
+
+    /// @brief Allocates an empty leaf, and links it after the given one.
+    /// @param previous the leaf before the new one, null for the first.
+    /// @return the new leaf.
+    auto make_leaf(leaf_t *previous) -> leaf_t *
+    {
+        auto *leaf     = new leaf_t();
+        leaf->leaf     = true;
+        leaf->previous = previous;
+        if (previous != nullptr) {
+            leaf->next     = previous->next;
+            previous->next = leaf;
+        }
+        (leaf->next != nullptr ? leaf->next->previous : tail) = leaf;
+        return leaf;
+    }
+
+    /// @brief Adds a node to the parent of another, right after it.
+    /// @details A full parent is split, and the middle key moves up; when
+    /// appending, the parent is left full and followed by a new node.
+    /// @param left the node already in the tree.
+    /// @param separator the key separating the two nodes.
+    /// @param right the new node.
+    /// @param appending whether the new node follows all the others.
+    void insert_child(node_t *left, const Key &separator, node_t *right, bool appending)
+    {
+        inner_t *parent = left->parent;
+        if (parent == nullptr) {
+            parent              = new inner_t();
+            parent->keys[0]     = separator;
+            parent->children[0] = left;
+            parent->children[1] = right;
+            parent->count       = 1;
+            left->parent        = parent;
+            right->parent       = parent;
+            root                = parent;
+            return;
+        }
+        std::size_t position = 0;
+        while (parent->children[position] != left) {
+            ++position;
+        }
+        if (parent->count < capacity) {
+            std::move_backward(parent->keys + position, parent->keys + parent->count, parent->keys + parent->count + 1U);
+            std::move_backward(
+                parent->children + position + 1U, parent->children + parent->count + 1U, parent->children + parent->count + 2U);
+            parent->keys[position]          = separator;
+            parent->children[position + 1U] = right;
+            right->parent                   = parent;
+            ++parent->count;
+            return;
+        }
+        // Gathers the keys and the children, with the new ones.
+        Key keys[capacity + 1U];
+        node_t *children[capacity + 2U];
+        std::move(parent->keys, parent->keys + position, keys);
+        keys[position] = separator;
+        std::move(parent->keys + position, parent->keys + capacity, keys + position + 1U);
+        std::copy(parent->children, parent->children + position + 1U, children);
+        children[position + 1U] = right;
+        std::copy(parent->children + position + 1U, parent->children + capacity + 1U, children + position + 2U);
+        // The parent keeps the first half, the middle key moves up.
+        std::size_t middle = appending ? static_cast<std::size_t>(capacity) : (capacity + 1U) / 2U;
+        auto *sibling      = new inner_t();
+        std::move(keys, keys + middle, parent->keys);
+        std::copy(children, children + middle + 1U, parent->children);
+        parent->count = middle;
+        std::move(keys + middle + 1U, keys + capacity + 1U, sibling->keys);
+        std::copy(children + middle + 1U, children + capacity + 2U, sibling->children);
+        sibling->count = capacity - middle;
+        for (std::size_t i = 0; i <= sibling->count; ++i) {
+            sibling->children[i]->parent = sibling;
+        }
+        for (std::size_t i = 0; i <= parent->count; ++i) {
+            parent->children[i]->parent = parent;
+        }
+        this->insert_child(parent, keys[middle], sibling, appending);
+    }
+
+    /// @brief Unlinks and releases an empty leaf.
+    /// @param leaf the leaf.
+    void remove_leaf(leaf_t *leaf)
+    {
+        (leaf->previous != nullptr ? leaf->previous->next : head) = leaf->next;
+        (leaf->next != nullptr ? leaf->next->previous : tail)     = leaf->previous;
+        this->remove_node(leaf);
+    }
+
+    /// @brief Removes a node from its parent, and releases it, with the
+    /// parents left without children.
+    /// @param node the node.
+    void remove_node(node_t *node)
+    {
+        inner_t *parent = node->parent;
+        if (parent == nullptr) {
+            free_node(node);
+            root = nullptr;
+            return;
+        }
+        std::size_t position = 0;
+        while (parent->children[position] != node) {
+            ++position;
+        }
+        free_node(node);
+        if (parent->count == 0U) {
+            this->remove_node(parent);
+            return;
+        }
+        // Removes the separator before the child, or after it for the first.
+        std::size_t separator = position > 0U ? position - 1U : 0U;
+        std::move(parent->keys + separator + 1U, parent->keys + parent->count, parent->keys + separator);
+        std::move(parent->children + position + 1U, parent->children + parent->count + 1U, parent->children + position);
+        --parent->count;
+        // A root with a single child is replaced by the child.
+        while (root == parent && parent->count == 0U) {
+            root         = parent->children[0];
+            root->parent = nullptr;
+            free_node(parent);
+            parent = root->leaf ? nullptr : static_cast<inner_t *>(root);
+        }
+    }
+
+    /// @brief Releases a node, without its children.
+    /// @param node the node.
+    static void free_node(node_t *node)
+    {
+        if (node->leaf) {
+            delete static_cast<leaf_t *>(node);
+        } else {
+            delete static_cast<inner_t *>(node);
+        }
+    }
+
+    /// @brief Releases a node and its children.
+    /// @param node the node, possibly null.
+    static void destroy(node_t *node)
+    {
+        if (node == nullptr) {
+            return;
+        }
+        if (!node->leaf) {
+            auto *inner = static_cast<inner_t *>(node);
+            for (std::size_t i = 0; i <= inner->count; ++i) {
+                destroy(inner->children[i]);
+            }
+        }
+        free_node(node);
+    }
+
+    /// @brief The root, null if the map is empty.
+    node_t *root;
+    /// @brief The leaf with the smallest keys.
+    leaf_t *head;
+    /// @brief The leaf with the greatest keys.
+    leaf_t *tail;
+    /// @brief The number of entries.
+    std::size_t entries;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which uses a B+tree with
+/// wide nodes, for keys which are default constructible and assignable, and
+/// a `std::multimap` for the others.
+/// @details For instance:
+/// @code
+/// ordered_multimap_t<std::uint64_t, Order, btree_index_t> orders;
+/// @endcode
+struct btree_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle>
+    using type = typename std::conditional<
+        std::is_default_constructible<Key>::value && std::is_copy_assignable<Key>::value,
+        btree_multimap_t<Key, Handle>,
+        std::multimap<Key, Handle>>::type;
+};
+
+} // namespace ordered_multimap
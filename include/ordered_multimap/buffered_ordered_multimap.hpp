@@ -0,0 +1,227 @@
+/// @file buffered_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A shared ordered map, written through per-thread staging buffers.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief An `ordered_multimap_t` shared among threads, which batches writes.
+/// @details Instead of locking the shared map for every insertion, each thread
+/// owns a `writer_t` and appends to its private staging buffer, a plain
+/// vector of entries, guarded by a lock of its own which only a global flush
+/// contends. The staged entries become visible to readers only when they are
+/// flushed, either by the writer itself or by a global `flush()`, which acts
+/// as an epoch boundary. Flushing builds a map out of the staged entries in
+/// one pass, with its index built bottom-up, and only then takes the shared
+/// lock, to splice the list at the end of the shared one and merge the
+/// indices in one sorted pass.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> class buffered_ordered_multimap_t
+{
+public:
+    /// @brief The type of the shared map.
+    using map_t = ordered_multimap_t<Key, Value>;
+
+    /// @brief A private staging buffer, meant to be used by a single thread.
+    class writer_t
+    {
+    public:
+        /// @brief Registers a new writer with the given shared map.
+        /// @param _owner the shared map the writer flushes into.
+        explicit writer_t(buffered_ordered_multimap_t &_owner)
+            : owner(&_owner)
+            , mutex()
+            , staging()
+        {
+            owner->attach(this);
+        }
+
+        /// @brief Writers are registered by address, they cannot be copied.
+        writer_t(const writer_t &) = delete;
+
+        /// @brief Writers are registered by address, they cannot be copied.
+        /// @return nothing, this function is deleted.
+        auto operator=(const writer_t &) -> writer_t & = delete;
+
+        /// @brief Flushes the pending entries, and unregisters the writer.
+        ~writer_t()
+        {
+            this->flush();
+            owner->detach(this);
+        }
+
+        /// @brief Stages the `<key,value>` pair.
+        /// @param key the value identifier.
+        /// @param value the actual value.
+        void insert(const Key &key, const Value &value)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            staging.emplace_back(key, value);
+        }
+
+        /// @brief Stages a value constructed in-place with the given key.
+        /// @tparam Args Types of arguments to construct a `Value`.
+        /// @param key The key associated with the new value.
+        /// @param args Arguments forwarded to construct the `Value`.
+        template <typename... Args> void emplace(const Key &key, Args &&...args)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            staging.emplace_back(
+                std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+
+        /// @brief Returns the number of staged entries.
+        /// @return the number of entries waiting to be flushed.
+        auto pending() const -> std::size_t
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            return staging.size();
+        }
+
+        /// @brief Publishes the staged entries into the shared map.
+        void flush()
+        {
+            // Keep the lock until the batch is merged, so that batches of
+            // this writer reach the shared map in order.
+            std::lock_guard<std::mutex> guard(mutex);
+            map_t batch = this->take();
+            std::lock_guard<std::mutex> shared_guard(owner->mutex);
+            owner->map.merge(std::move(batch));
+        }
+
+    private:
+        friend class buffered_ordered_multimap_t;
+
+        /// @brief Builds a map out of the staged entries, and empties the
+        /// staging buffer, keeping its capacity.
+        /// @details The lock of the writer must be held by the caller.
+        /// @return the map of the staged entries.
+        auto take() -> map_t
+        {
+            map_t batch(std::make_move_iterator(staging.begin()), std::make_move_iterator(staging.end()));
+            staging.clear();
+            return batch;
+        }
+
+        /// @brief The shared map.
+        buffered_ordered_multimap_t *owner;
+        /// @brief Protects the staging buffer from a concurrent global flush.
+        mutable std::mutex mutex;
+        /// @brief The private staging buffer.
+        std::vector<typename map_t::list_entry_t> staging;
+    };
+
+    /// @brief Construct a new, empty, shared map.
+    buffered_ordered_multimap_t()
+        : mutex()
+        , writers_mutex()
+        , map()
+        , writers()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The shared map is referenced by its writers, it cannot be copied.
+    buffered_ordered_multimap_t(const buffered_ordered_multimap_t &) = delete;
+
+    /// @brief The shared map is referenced by its writers, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const buffered_ordered_multimap_t &) -> buffered_ordered_multimap_t & = delete;
+
+    /// @brief Destructor, all writers must have been destroyed before.
+    ~buffered_ordered_multimap_t() = default;
+
+    /// @brief Flushes the staging buffers of all the registered writers.
+    /// @details The batches of all the writers are built first, and then
+    /// merged in registration order while holding the lock of the shared map,
+    /// hence readers observe either none or all of the entries staged before
+    /// the call. Writers wait for the global flush to complete.
+    void flush()
+    {
+        std::lock_guard<std::mutex> writers_guard(writers_mutex);
+        std::vector<std::unique_lock<std::mutex>> locks;
+        std::vector<map_t> batches;
+        locks.reserve(writers.size());
+        batches.reserve(writers.size());
+        for (writer_t *writer : writers) {
+            locks.emplace_back(writer->mutex);
+            batches.push_back(writer->take());
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        for (map_t &batch : batches) {
+            map.merge(std::move(batch));
+        }
+    }
+
+    /// @brief Calls the given function with a read-only view of the shared map.
+    /// @details The view reflects the state as of the last flush.
+    /// @tparam Function the type of the function.
+    /// @param function a callable accepting a `const map_t &`.
+    /// @return whatever the function returns.
+    template <typename Function> auto read(Function function) const -> decltype(function(std::declval<const map_t &>()))
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return function(map);
+    }
+
+    /// @brief Returns a copy of the shared map.
+    /// @return the state of the shared map as of the last flush.
+    auto snapshot() const -> map_t
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return map;
+    }
+
+    /// @brief Returns the number of published entries.
+    /// @return the number of entries as of the last flush.
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return map.size();
+    }
+
+private:
+    /// @brief Registers a writer.
+    /// @param writer the writer.
+    void attach(writer_t *writer)
+    {
+        std::lock_guard<std::mutex> writers_guard(writers_mutex);
+        writers.push_back(writer);
+    }
+
+    /// @brief Unregisters a writer.
+    /// @param writer the writer.
+    void detach(writer_t *writer)
+    {
+        std::lock_guard<std::mutex> writers_guard(writers_mutex);
+        writers.erase(std::remove(writers.begin(), writers.end(), writer), writers.end());
+    }
+
+    /// @brief Protects the shared map.
+    mutable std::mutex mutex;
+    /// @brief Protects the list of writers, always locked before the locks of
+    /// the writers, which are locked before `mutex`.
+    std::mutex writers_mutex;
+    /// @brief The shared map.
+    map_t map;
+    /// @brief The registered writers.
+    std::vector<writer_t *> writers;
+};
+
+} // namespace ordered_multimap
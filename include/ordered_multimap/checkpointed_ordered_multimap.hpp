@@ -0,0 +1,341 @@
+/// @file checkpointed_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A shared ordered map, saved to disk by a background thread.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/durable_file.hpp"
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief Statistics about a checkpoint.
+struct checkpoint_stats_t {
+    /// @brief The number of saved entries.
+    std::size_t entries;
+    /// @brief The number of bytes written.
+    std::size_t bytes;
+    /// @brief For how long writers were blocked, while capturing the entries.
+    double capture_ms;
+    /// @brief The total duration of the checkpoint.
+    double total_ms;
+    /// @brief If the checkpoint was written successfully.
+    bool success;
+};
+
+/// @brief An `ordered_multimap_t` shared among threads, which can be saved to
+/// disk without stalling its writers.
+/// @details Besides the shared map, a replica of it is kept for checkpoints,
+/// owned by the background thread, and a log of the changes the replica is
+/// missing. `insert`, `emplace` and `erase` apply a change to the map and
+/// append it to the log. A checkpoint holds the lock only to swap the log
+/// with an empty one, which fixes its point in time: the background thread
+/// then replays the swapped log onto the replica, and encodes, writes and
+/// syncs it, while the foreground keeps inserting and erasing.
+///
+/// Changes made through `write`, or by `restore`, cannot be logged, nor can
+/// a log holding more changes than the map has entries, since replaying it
+/// would cost more than copying the map: in these cases the log is dropped,
+/// and the next checkpoint copies the whole map while holding the lock.
+///
+/// Files are replaced atomically, and use the format of
+/// `ordered_multimap_t::save`, hence they can be read back with
+/// `ordered_multimap_t::load`, or with `restore`.
+/// @tparam Key the type of the key, it needs a `codec<Key>`.
+/// @tparam Value the type of the value, it needs a `codec<Value>`.
+template <typename Key, typename Value> class checkpointed_ordered_multimap_t
+{
+public:
+    /// @brief The type of the shared map.
+    using map_t = ordered_multimap_t<Key, Value>;
+
+    /// @brief Construct a new, empty, shared map.
+    checkpointed_ordered_multimap_t()
+        : mutex()
+        , map()
+        , delta()
+        , resync(false)
+        , replica()
+        , checkpoint_mutex()
+        , worker()
+        , stats_mutex()
+        , stats{0, 0, 0, 0, true}
+        , running(false)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The map is referenced by the background thread, it cannot be copied.
+    checkpointed_ordered_multimap_t(const checkpointed_ordered_multimap_t &) = delete;
+
+    /// @brief The map is referenced by the background thread, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const checkpointed_ordered_multimap_t &) -> checkpointed_ordered_multimap_t & = delete;
+
+    /// @brief Waits for the running checkpoint, if any.
+    ~checkpointed_ordered_multimap_t() { this->wait(); }
+
+    /// @brief Calls the given function with the shared map, under the lock.
+    /// @details The changes made by the function are not logged, the next
+    /// checkpoint copies the whole map while holding the lock.
+    /// @tparam Function the type of the function.
+    /// @param function a callable accepting a `map_t &`.
+    /// @return whatever the function returns.
+    template <typename Function> auto write(Function function) -> decltype(function(std::declval<map_t &>()))
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        this->drop_delta();
+        return function(map);
+    }
+
+    /// @brief Calls the given function with a read-only view of the shared map.
+    /// @tparam Function the type of the function.
+    /// @param function a callable accepting a `const map_t &`.
+    /// @return whatever the function returns.
+    template <typename Function> auto read(Function function) const -> decltype(function(std::declval<const map_t &>()))
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return function(map);
+    }
+
+    /// @brief Inserts the `<key,value>` pair.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void insert(const Key &key, const Value &value)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        map.insert(key, value);
+        this->log_insert(key, value);
+    }
+
+    /// @brief Inserts a value constructed in-place with the given key.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    template <typename... Args> void emplace(const Key &key, Args &&...args)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        this->log_insert(key, map.emplace(key, std::forward<Args>(args)...)->second);
+    }
+
+    /// @brief Removes all the entries with the given key.
+    /// @param key the key to remove.
+    /// @return the number of removed elements.
+    auto erase(const Key &key) -> std::size_t
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        std::size_t count = map.count(key);
+        if (count != 0) {
+            map.erase(key);
+            delta.erased.emplace_back(delta.inserted.size(), key);
+            this->bound_delta();
+        }
+        return count;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return map.size();
+    }
+
+    /// @brief Replaces the content of the map with the one of a checkpoint.
+    /// @param path the path of the checkpoint.
+    /// @return true on success, false otherwise.
+    auto restore(const std::string &path) -> bool
+    {
+        std::string content;
+        if (!detail::read_file(path, content)) {
+            return false;
+        }
+        std::istringstream is(content);
+        map_t loaded;
+        if (!loaded.load(is)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        map = std::move(loaded);
+        this->drop_delta();
+        return true;
+    }
+
+    /// @brief Starts saving the current state of the map to the given file,
+    /// in the background.
+    /// @details Writers are blocked only while the log is swapped, or, if it
+    /// was dropped, while the map is copied into the replica.
+    /// @param path the path of the file, replaced when the checkpoint completes.
+    /// @return false if another checkpoint is still running, true otherwise.
+    auto checkpoint(const std::string &path) -> bool
+    {
+        std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex);
+        if (this->checkpointing()) {
+            return false;
+        }
+        if (worker.joinable()) {
+            worker.join();
+        }
+        // No worker is running, the replica can be touched from here.
+        auto start = std::chrono::steady_clock::now();
+        delta_t captured;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (resync) {
+                replica = map;
+                delta   = delta_t();
+                resync  = false;
+            } else {
+                std::swap(captured, delta);
+            }
+        }
+        double capture_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> stats_guard(stats_mutex);
+            running = true;
+        }
+        try {
+            worker = std::thread([this, path, start, capture_ms](delta_t changes) {
+                this->replay(changes);
+                std::ostringstream os;
+                bool success        = replica.save(os);
+                std::string content = os.str();
+                success             = success && detail::replace_file(path, content);
+                double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                {
+                    std::lock_guard<std::mutex> stats_guard(stats_mutex);
+                    stats   = checkpoint_stats_t{replica.size(), content.size(), capture_ms, total_ms, success};
+                    running = false;
+                }
+            }, std::move(captured));
+        } catch (...) {
+            // The replica missed the captured changes, copy the map next time.
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                this->drop_delta();
+            }
+            std::lock_guard<std::mutex> stats_guard(stats_mutex);
+            running = false;
+            throw;
+        }
+        return true;
+    }
+
+    /// @brief Waits for the running checkpoint, if any.
+    /// @return true if the last checkpoint was written successfully.
+    auto wait() -> bool
+    {
+        std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex);
+        if (worker.joinable()) {
+            worker.join();
+        }
+        return this->last_checkpoint().success;
+    }
+
+    /// @brief Checks if a checkpoint is running.
+    /// @return true if a checkpoint is running.
+    auto checkpointing() const -> bool
+    {
+        std::lock_guard<std::mutex> stats_guard(stats_mutex);
+        return running;
+    }
+
+    /// @brief Returns the statistics of the last completed checkpoint.
+    /// @return the statistics.
+    auto last_checkpoint() const -> checkpoint_stats_t
+    {
+        std::lock_guard<std::mutex> stats_guard(stats_mutex);
+        return stats;
+    }
+
+private:
+    /// @brief The changes made to the map since the replica was last updated.
+    /// @details Insertions are kept in order; each erasure records the key,
+    /// and how many insertions came before it.
+    struct delta_t {
+        /// @brief The inserted entries.
+        std::vector<typename map_t::list_entry_t> inserted;
+        /// @brief The erased keys, and the number of insertions before them.
+        std::vector<std::pair<std::size_t, Key>> erased;
+    };
+
+    /// @brief Logs an insertion, the lock must be held.
+    /// @param key the key of the entry.
+    /// @param value the value of the entry.
+    void log_insert(const Key &key, const Value &value)
+    {
+        delta.inserted.emplace_back(key, value);
+        this->bound_delta();
+    }
+
+    /// @brief Drops the log once it holds more changes than the map has
+    /// entries, the lock must be held.
+    void bound_delta()
+    {
+        if (delta.inserted.size() + delta.erased.size() > map.size() + 1024U) {
+            this->drop_delta();
+        }
+    }
+
+    /// @brief Drops the log, so that the next checkpoint copies the map, the
+    /// lock must be held.
+    void drop_delta()
+    {
+        delta  = delta_t();
+        resync = true;
+    }
+
+    /// @brief Applies the logged changes to the replica, in order.
+    /// @param changes the changes.
+    void replay(delta_t &changes)
+    {
+        std::size_t next = 0;
+        for (auto &erasure : changes.erased) {
+            for (; next < erasure.first; ++next) {
+                replica.emplace(changes.inserted[next].first, std::move(changes.inserted[next].second));
+            }
+            replica.erase(erasure.second);
+        }
+        for (; next < changes.inserted.size(); ++next) {
+            replica.emplace(changes.inserted[next].first, std::move(changes.inserted[next].second));
+        }
+    }
+
+    /// @brief Protects the shared map, and the log.
+    mutable std::mutex mutex;
+    /// @brief The shared map.
+    map_t map;
+    /// @brief The changes the replica is missing.
+    delta_t delta;
+    /// @brief If the log was dropped, and the replica must be copied again.
+    bool resync;
+    /// @brief The copy of the map saved by checkpoints, touched only while
+    /// holding `checkpoint_mutex` with no checkpoint running, or by the
+    /// background thread.
+    map_t replica;
+    /// @brief Serializes the start of checkpoints, always locked before `mutex`.
+    std::mutex checkpoint_mutex;
+    /// @brief The background thread writing the checkpoint.
+    std::thread worker;
+    /// @brief Protects the statistics and the running flag.
+    mutable std::mutex stats_mutex;
+    /// @brief The statistics of the last completed checkpoint.
+    checkpoint_stats_t stats;
+    /// @brief If a checkpoint is running.
+    bool running;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,296 @@
+/// @file codec.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Binary codecs used to save and load the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief Writes an unsigned integer using a variable number of bytes.
+/// @details Seven bits are stored per byte, the highest bit tells whether
+/// more bytes follow, hence small values take a single byte.
+/// @param os the output stream.
+/// @param value the value to write.
+inline void write_varint(std::ostream &os, std::uint64_t value)
+{
+    char buffer[10];
+    std::size_t length = 0;
+    while (value >= 0x80U) {
+        buffer[length++] = static_cast<char>((value & 0x7FU) | 0x80U);
+        value >>= 7U;
+    }
+    buffer[length++] = static_cast<char>(value);
+    os.write(buffer, static_cast<std::streamsize>(length));
+}
+
+/// @brief Reads an unsigned integer written by `write_varint`.
+/// @details On malformed input the failbit of the stream is set.
+/// @param is the input stream.
+/// @return the value, zero on failure.
+inline auto read_varint(std::istream &is) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64U; shift += 7U) {
+        int byte = is.get();
+        if (byte == std::char_traits<char>::eof()) {
+            is.setstate(std::ios::failbit);
+            return 0;
+        }
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    // Too many continuation bytes.
+    is.setstate(std::ios::failbit);
+    return 0;
+}
+
+/// @brief Writes and reads values of type `T`.
+/// @details Specialize this template to make your own types serializable, the
+/// specialization must provide:
+///   - `static void write(std::ostream &os, const T &value)`
+///   - `static auto read(std::istream &is) -> T`
+///
+/// The `read` function must signal failures through the state of the stream.
+/// @tparam T the type of value.
+/// @tparam Enable used to select specializations with SFINAE.
+template <typename T, typename Enable = void> struct codec;
+
+/// @brief Codec for unsigned integral types, stored as varints.
+/// @details Values which do not fit the type set the failbit when read.
+/// @tparam T the type of value.
+template <typename T> struct codec<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const T &value) { write_varint(os, static_cast<std::uint64_t>(value)); }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> T
+    {
+        std::uint64_t value = read_varint(is);
+        if (value > static_cast<std::uint64_t>(std::numeric_limits<T>::max())) {
+            is.setstate(std::ios::failbit);
+            return 0;
+        }
+        return static_cast<T>(value);
+    }
+};
+
+/// @brief Codec for signed integral types, stored as zigzag varints, so that
+/// small negative values take a single byte too.
+/// @details Values which do not fit the type set the failbit when read.
+/// @tparam T the type of value.
+template <typename T> struct codec<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const T &value)
+    {
+        std::uint64_t bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+        write_varint(os, (bits << 1U) ^ (value < 0 ? ~static_cast<std::uint64_t>(0) : 0U));
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> T
+    {
+        std::uint64_t bits = read_varint(is);
+        std::int64_t value = static_cast<std::int64_t>((bits >> 1U) ^ (~(bits & 1U) + 1U));
+        if (value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max()) {
+            is.setstate(std::ios::failbit);
+            return 0;
+        }
+        return static_cast<T>(value);
+    }
+};
+
+/// @brief Codec for `char`, stored as an `unsigned char`, so that files do
+/// not depend on whether `char` is signed on the platform.
+template <> struct codec<char> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const char &value)
+    {
+        codec<unsigned char>::write(os, static_cast<unsigned char>(value));
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> char { return static_cast<char>(codec<unsigned char>::read(is)); }
+};
+
+/// @brief Codec for enumerations, stored as their underlying type.
+/// @tparam T the type of value.
+template <typename T> struct codec<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    /// @brief The underlying type of the enumeration.
+    using underlying_t = typename std::underlying_type<T>::type;
+
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const T &value) { codec<underlying_t>::write(os, static_cast<underlying_t>(value)); }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> T { return static_cast<T>(codec<underlying_t>::read(is)); }
+};
+
+/// @brief Codec for floating point types, stored as their bytes, in little
+/// endian order.
+/// @tparam T the type of value.
+template <typename T> struct codec<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const T &value)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        if (!little_endian()) {
+            reverse(bytes);
+        }
+        os.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(sizeof(T)));
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> T
+    {
+        unsigned char bytes[sizeof(T)] = {};
+        is.read(reinterpret_cast<char *>(bytes), static_cast<std::streamsize>(sizeof(T)));
+        if (!little_endian()) {
+            reverse(bytes);
+        }
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+private:
+    /// @brief Checks the byte order of the machine.
+    /// @return true on little endian machines.
+    static auto little_endian() -> bool
+    {
+        const std::uint16_t probe = 1U;
+        unsigned char first       = 0;
+        std::memcpy(&first, &probe, 1U);
+        return first == 1U;
+    }
+
+    /// @brief Reverses the bytes of a value.
+    /// @param bytes the bytes.
+    static void reverse(unsigned char (&bytes)[sizeof(T)])
+    {
+        for (std::size_t i = 0; i < sizeof(T) / 2U; ++i) {
+            std::swap(bytes[i], bytes[sizeof(T) - 1U - i]);
+        }
+    }
+};
+
+/// @brief Codec for strings, stored as a varint length followed by the bytes.
+template <> struct codec<std::string> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const std::string &value)
+    {
+        write_varint(os, value.size());
+        os.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> std::string
+    {
+        std::uint64_t length = read_varint(is);
+        std::string value;
+        // Grow in steps, a corrupted length must not allocate gigabytes.
+        const std::uint64_t step = 1U << 16U;
+        while (is && value.size() < length) {
+            std::size_t offset = value.size();
+            std::size_t chunk  = static_cast<std::size_t>(std::min<std::uint64_t>(step, length - offset));
+            value.resize(offset + chunk);
+            is.read(&value[offset], static_cast<std::streamsize>(chunk));
+        }
+        return value;
+    }
+};
+
+/// @brief Codec for pairs, stored as the first element followed by the second.
+/// @tparam First the type of the first element.
+/// @tparam Second the type of the second element.
+template <typename First, typename Second> struct codec<std::pair<First, Second>> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const std::pair<First, Second> &value)
+    {
+        codec<First>::write(os, value.first);
+        codec<Second>::write(os, value.second);
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> std::pair<First, Second>
+    {
+        First first = codec<First>::read(is);
+        return std::pair<First, Second>(std::move(first), codec<Second>::read(is));
+    }
+};
+
+/// @brief Codec for vectors, stored as a varint size followed by the elements.
+/// @tparam T the type of the elements.
+template <typename T> struct codec<std::vector<T>> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const std::vector<T> &value)
+    {
+        write_varint(os, value.size());
+        for (const T &element : value) {
+            codec<T>::write(os, element);
+        }
+    }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> std::vector<T>
+    {
+        std::uint64_t size = read_varint(is);
+        std::vector<T> value;
+        for (std::uint64_t i = 0; is && i < size; ++i) {
+            value.push_back(codec<T>::read(is));
+        }
+        return value;
+    }
+};
+
+} // namespace ordered_multimap
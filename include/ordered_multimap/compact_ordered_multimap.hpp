@@ -0,0 +1,268 @@
+/// @file compact_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map whose empty state is a single null pointer.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief An `ordered_multimap_t` which takes the space of a pointer while
+/// empty.
+/// @details An empty `ordered_multimap_t` embeds a list and a multimap, with
+/// their sentinels and sizes. This map only holds a pointer, which stays null
+/// until the first insertion allocates the list and the index. Hence objects
+/// owning a map which is mostly empty pay a single pointer for it.
+/// `clear()` and `shrink_to_fit()` release the storage again.
+///
+/// Iterators are less stable than those of `ordered_multimap_t`: while the
+/// map is unallocated, `begin()` and `end()` refer to an empty map shared by
+/// all the unallocated maps. Hence the insertion which allocates the storage,
+/// `clear()`, and `shrink_to_fit()` when it releases the storage, invalidate
+/// every iterator, including `end()`. Otherwise, iterators behave as those of
+/// `ordered_multimap_t`.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> class compact_ordered_multimap_t
+{
+public:
+    /// @brief The type of the storage, allocated on first insertion.
+    using map_t           = ordered_multimap_t<Key, Value>;
+    /// @brief The type of the entries.
+    using list_entry_t    = typename map_t::list_entry_t;
+    /// @brief Iterator for the list, for the user.
+    using iterator        = typename map_t::iterator;
+    /// @brief Constant iterator for the list, for the user.
+    using const_iterator  = typename map_t::const_iterator;
+    /// @brief The type of a compatible sort function.
+    using sort_function_t = typename map_t::sort_function_t;
+
+    /// @brief Construct a new, empty, map, without allocating.
+    compact_ordered_multimap_t()
+        : map()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Copy constructor, copying an empty map does not allocate.
+    /// @param other the map to copy.
+    compact_ordered_multimap_t(const compact_ordered_multimap_t &other)
+        : map(other.empty() ? nullptr : new map_t(*other.map))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Move constructor.
+    /// @param other the map to move from, left empty.
+    compact_ordered_multimap_t(compact_ordered_multimap_t &&other) noexcept
+        : map(std::move(other.map))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Destructor.
+    ~compact_ordered_multimap_t() = default;
+
+    /// @brief Copy assignment.
+    /// @param other the map to copy.
+    /// @return a reference to the current map.
+    auto operator=(const compact_ordered_multimap_t &other) -> compact_ordered_multimap_t &
+    {
+        if (this != &other) {
+            map.reset(other.empty() ? nullptr : new map_t(*other.map));
+        }
+        return *this;
+    }
+
+    /// @brief Move assignment.
+    /// @param other the map to move from, left empty.
+    /// @return a reference to the current map.
+    auto operator=(compact_ordered_multimap_t &&other) noexcept -> compact_ordered_multimap_t &
+    {
+        map = std::move(other.map);
+        return *this;
+    }
+
+    /// @brief Clears the content of the map, and releases its storage.
+    /// @details Invalidates every iterator, including `end()`.
+    void clear() { map.reset(); }
+
+    /// @brief Releases the storage, if the map is empty.
+    /// @details When the storage is released, every iterator, including
+    /// `end()`, is invalidated.
+    void shrink_to_fit()
+    {
+        if (map && map->size() == 0) {
+            map.reset();
+        }
+    }
+
+    /// @brief Checks if the storage is allocated.
+    /// @return true if the storage is allocated.
+    auto is_allocated() const -> bool { return static_cast<bool>(map); }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return map ? map->size() : 0U; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return this->size() == 0; }
+
+    /// @brief Returns an iterator the beginning of the list.
+    /// @details While the map is unallocated, the iterator refers to a shared
+    /// empty map, and is invalidated by the first insertion.
+    /// @return an iterator to the beginning of the list.
+    auto begin() -> iterator { return this->storage().begin(); }
+
+    /// @brief Returns a const iterator the beginning of the list.
+    /// @details While the map is unallocated, the iterator refers to a shared
+    /// empty map, and is invalidated by the first insertion.
+    /// @return an iterator to the beginning of the list.
+    auto begin() const -> const_iterator { return this->storage().begin(); }
+
+    /// @brief Returns an iterator the end of the list.
+    /// @details The end changes when the storage is allocated or released,
+    /// by the first insertion, `clear()`, or `shrink_to_fit()`.
+    /// @return an iterator to the end of the list.
+    auto end() -> iterator { return this->storage().end(); }
+
+    /// @brief Returns a const iterator the end of the list.
+    /// @details The end changes when the storage is allocated or released,
+    /// by the first insertion, `clear()`, or `shrink_to_fit()`.
+    /// @return an iterator to the end of the list.
+    auto end() const -> const_iterator { return this->storage().end(); }
+
+    /// @brief Returns a vector containing all keys in the map, in insertion
+    /// order.
+    /// @return A vector of keys.
+    auto keys() const -> std::vector<Key> { return this->storage().keys(); }
+
+    /// @brief Returns a vector containing all values in the map, in insertion
+    /// order.
+    /// @return A vector of values.
+    auto values() const -> std::vector<Value> { return this->storage().values(); }
+
+    /// @brief Returns a vector containing all key-value pairs in insertion
+    /// order.
+    /// @return A vector of key-value pairs.
+    auto to_vector() const -> std::vector<list_entry_t> { return this->storage().to_vector(); }
+
+    /// @brief Inserts the `<key,value>` pair, allocating the storage if needed.
+    /// @details Allocating the storage invalidates every iterator, including
+    /// `end()`.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return the iterator to the newly inserted element in the map.
+    auto insert(const Key &key, const Value &value) -> iterator { return this->allocate().insert(key, value); }
+
+    /// @brief Constructs a value in-place at the end of the map with the given
+    /// key, allocating the storage if needed.
+    /// @details Allocating the storage invalidates every iterator, including
+    /// `end()`.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    /// @return An iterator to the newly inserted element.
+    template <typename... Args> auto emplace(const Key &key, Args &&...args) -> iterator
+    {
+        return this->allocate().emplace(key, std::forward<Args>(args)...);
+    }
+
+    /// @brief Updates all values associated with the given key to the new
+    /// value, or inserts it.
+    /// @details Allocating the storage invalidates every iterator, including
+    /// `end()`.
+    /// @param key The key to update.
+    /// @param value The new value to assign.
+    /// @return An iterator to the first updated or newly inserted element.
+    auto update(const Key &key, const Value &value) -> iterator { return this->allocate().update(key, value); }
+
+    /// @brief Erases all the elements with the given key.
+    /// @param key the key of the elements to remove.
+    /// @return an iterator to the element after the first one removed.
+    auto erase(const Key &key) -> iterator { return map ? map->erase(key) : this->end(); }
+
+    /// @brief Erases the element pointed by the iterator.
+    /// @param it_list the iterator of the element to remove.
+    /// @return an iterator to the same position in the list.
+    auto erase(iterator it_list) -> iterator { return map ? map->erase(it_list) : this->end(); }
+
+    /// @brief Erases a single element that matches the given key and value.
+    /// @param key The key to search for.
+    /// @param value The value to match against.
+    /// @return The number of elements removed (0 or 1).
+    auto erase(const Key &key, const Value &value) -> std::size_t { return map ? map->erase(key, value) : 0U; }
+
+    /// @brief Returns an iterator to the element associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) -> iterator { return this->storage().find(key); }
+
+    /// @brief Returns an iterator to the element associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) const -> const_iterator { return this->storage().find(key); }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return map && map->has(key); }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    auto count(const Key &key) const -> std::size_t { return map ? map->count(key) : 0U; }
+
+    /// @brief Sorts the entries.
+    /// @param fun the sorting function.
+    void sort(const sort_function_t &fun)
+    {
+        if (map) {
+            map->sort(fun);
+        }
+    }
+
+private:
+    /// @brief Returns the storage, or a shared empty map if not allocated.
+    /// @details The shared map is never modified, it only provides iterators.
+    /// @return a reference to the storage.
+    auto storage() -> map_t & { return map ? *map : shared_empty(); }
+
+    /// @brief Returns the storage, or a shared empty map if not allocated.
+    /// @return a const reference to the storage.
+    auto storage() const -> const map_t & { return map ? *map : shared_empty(); }
+
+    /// @brief Returns the storage, allocating it if needed.
+    /// @return a reference to the storage.
+    auto allocate() -> map_t &
+    {
+        if (!map) {
+            map.reset(new map_t());
+        }
+        return *map;
+    }
+
+    /// @brief Returns the empty map shared by all the unallocated maps.
+    /// @return a reference to the shared empty map.
+    static auto shared_empty() -> map_t &
+    {
+        static map_t empty;
+        return empty;
+    }
+
+    /// @brief The storage, null while the map is empty.
+    std::unique_ptr<map_t> map;
+};
+
+} // namespace ordered_multimap
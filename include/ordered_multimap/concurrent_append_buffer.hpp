@@ -0,0 +1,297 @@
+/// @file concurrent_append_buffer.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A multi-producer, append-only staging buffer, with bounded memory.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace ordered_multimap
+{
+
+/// @brief An append-only buffer that many threads can fill without locks.
+/// @details Producers reserve a slot with an atomic compare-and-swap, build
+/// their entry inside that slot, and then publish it. Storage is a ring of
+/// fixed-size segments: a segment is allocated the first time a producer
+/// reaches it, and is reused once the consumer has drained it, hence memory
+/// stays bounded by the entries waiting to be drained. Segments are
+/// allocated before a slot is reserved in them, so that a failed allocation
+/// leaves no slot behind. Producers only wait for each other while one of
+/// them allocates a segment, which happens at most once per ring position. A single consumer later calls
+/// `drain_into()`, which moves the published entries into an
+/// `ordered_multimap_t` following the reservation order, and updates the key
+/// index in one batch.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> class concurrent_append_buffer_t
+{
+public:
+    /// @brief The map the buffer is drained into.
+    using map_t   = ordered_multimap_t<Key, Value>;
+    /// @brief The type of the staged entries.
+    using entry_t = typename map_t::list_entry_t;
+
+    /// @brief Construct a new buffer.
+    /// @param segment_slots the number of slots of each segment, it is
+    /// rounded up to a power of two. The buffer holds at most `max_segments`
+    /// segments of entries waiting to be drained.
+    explicit concurrent_append_buffer_t(std::size_t segment_slots = 4096U)
+        : segment_bits(0)
+        , reserved(0)
+        , drained(0)
+        , segments()
+    {
+        while ((static_cast<std::size_t>(1U) << segment_bits) < segment_slots) {
+            ++segment_bits;
+        }
+        for (auto &segment : segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief The buffer is neither copyable nor movable, producers hold
+    /// references to it.
+    concurrent_append_buffer_t(const concurrent_append_buffer_t &) = delete;
+
+    /// @brief The buffer is neither copyable nor movable, producers hold
+    /// references to it.
+    /// @return nothing, this function is deleted.
+    auto operator=(const concurrent_append_buffer_t &) -> concurrent_append_buffer_t & = delete;
+
+    /// @brief Destructor, destroys the entries which were never drained.
+    ~concurrent_append_buffer_t() { this->release(); }
+
+    /// @brief Appends a copy of the `<key,value>` pair, it is safe to call
+    /// this function from many threads at once.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return true on success, false if the buffer is full, and must be
+    /// drained first.
+    auto insert(const Key &key, const Value &value) -> bool { return this->emplace(key, value); }
+
+    /// @brief Constructs a value in-place at the end of the buffer, it is
+    /// safe to call this function from many threads at once.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    /// @return true on success, false if the buffer is full, and must be
+    /// drained first.
+    template <typename... Args> auto emplace(const Key &key, Args &&...args) -> bool
+    {
+        std::size_t position = reserved.load(std::memory_order_relaxed);
+        do {
+            // The ring position of the slot must have been drained.
+            std::size_t first = drained.load(std::memory_order_acquire) >> segment_bits;
+            if ((position >> segment_bits) - first >= max_segments) {
+                return false;
+            }
+            this->allocate(position);
+        } while (!reserved.compare_exchange_weak(
+            position, position + 1U, std::memory_order_relaxed, std::memory_order_relaxed));
+        // Segments are never freed while producers run, the slot is there.
+        slot_t &slot = *this->locate(position);
+        try {
+            ::new (static_cast<void *>(&slot.storage)) entry_t(
+                std::piecewise_construct, std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+        } catch (...) {
+            // Let the consumer skip the slot, instead of waiting for it.
+            slot.state.store(slot_failed, std::memory_order_release);
+            throw;
+        }
+        slot.state.store(slot_ready, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Returns the number of slots reserved so far.
+    /// @details Reserved entries might still be under construction, this is
+    /// an upper bound of what the next `drain_into()` will move.
+    /// @return the number of reserved slots.
+    auto size() const -> std::size_t
+    {
+        return reserved.load(std::memory_order_acquire) - drained.load(std::memory_order_acquire);
+    }
+
+    /// @brief Returns the number of entries the buffer holds when full.
+    /// @details Appending fails once the entries waiting to be drained span
+    /// this many slots, counted from the segment of the oldest one.
+    /// @return the number of slots of the ring.
+    auto capacity() const -> std::size_t { return max_segments << segment_bits; }
+
+    /// @brief Moves every published entry into the given map, in reservation
+    /// order.
+    /// @details Only one thread at a time can drain the buffer, but producers
+    /// can keep appending while it happens: draining stops at the first slot
+    /// whose entry is still under construction, and the next call resumes
+    /// from there. Drained segments are reused by later entries.
+    /// @param map the map receiving the entries.
+    /// @return the number of entries moved into the map.
+    auto drain_into(map_t &map) -> std::size_t
+    {
+        const std::size_t last = reserved.load(std::memory_order_acquire);
+        std::size_t position   = drained.load(std::memory_order_relaxed);
+        map_t batch;
+        std::size_t moved = 0;
+        for (; position < last; ++position) {
+            slot_t *slot = this->locate(position);
+            if (slot == nullptr) {
+                break;
+            }
+            unsigned char state = slot->state.load(std::memory_order_acquire);
+            if (state == slot_empty) {
+                break;
+            }
+            if (state == slot_ready) {
+                entry_t *entry = this->entry_of(*slot);
+                batch.emplace(entry->first, std::move(entry->second));
+                entry->~entry_t();
+                ++moved;
+            }
+            // Producers see the reset once `drained` passes the slot.
+            slot->state.store(slot_empty, std::memory_order_relaxed);
+        }
+        drained.store(position, std::memory_order_release);
+        map.merge(std::move(batch));
+        return moved;
+    }
+
+    /// @brief Drops all the entries and frees the storage.
+    /// @details Unlike the other functions, this one must not run while
+    /// producers are appending.
+    void clear()
+    {
+        this->release();
+        reserved.store(0, std::memory_order_release);
+        drained.store(0, std::memory_order_release);
+    }
+
+private:
+    /// @brief The slot has not been published yet.
+    static const unsigned char slot_empty  = 0U;
+    /// @brief The slot contains a fully constructed entry.
+    static const unsigned char slot_ready  = 1U;
+    /// @brief The construction of the entry threw an exception.
+    static const unsigned char slot_failed = 2U;
+    /// @brief The number of segments of the ring, a power of two.
+    static const std::size_t max_segments  = 64U;
+
+    /// @brief A single slot of the buffer.
+    struct slot_t {
+        /// @brief Raw storage for the entry.
+        typename std::aligned_storage<sizeof(entry_t), alignof(entry_t)>::type storage;
+        /// @brief The state of the slot.
+        std::atomic<unsigned char> state;
+    };
+
+    /// @brief Marks a segment being allocated by a producer.
+    /// @return a pointer which is never the address of a segment.
+    auto allocating() -> slot_t * { return reinterpret_cast<slot_t *>(&segments); }
+
+    /// @brief Returns the ring position holding the slot at the given
+    /// position.
+    /// @param position the position of the slot.
+    /// @return the segment in the ring.
+    auto segment_of(std::size_t position) -> std::atomic<slot_t *> &
+    {
+        return segments[(position >> segment_bits) & (max_segments - 1U)];
+    }
+
+    /// @brief Makes sure the segment holding the slot at the given position
+    /// is allocated, before the slot is reserved.
+    /// @details If the allocation throws, the exception reaches the caller
+    /// with no slot reserved, and the next producer tries again.
+    /// @param position the position of the slot.
+    void allocate(std::size_t position)
+    {
+        std::atomic<slot_t *> &segment = this->segment_of(position);
+        slot_t *slots                  = segment.load(std::memory_order_acquire);
+        while (slots == nullptr || slots == this->allocating()) {
+            if (slots == nullptr && segment.compare_exchange_weak(
+                                        slots, this->allocating(), std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+                slots = this->allocate_segment(segment);
+            } else {
+                std::this_thread::yield();
+                slots = segment.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    /// @brief Allocates a segment, on behalf of the producers waiting for it.
+    /// @param segment the ring position, marked as being allocated.
+    /// @return the slots of the segment.
+    auto allocate_segment(std::atomic<slot_t *> &segment) -> slot_t *
+    {
+        slot_t *slots = nullptr;
+        try {
+            // Entries are built in place, only the states need a value.
+            slots = new slot_t[static_cast<std::size_t>(1U) << segment_bits];
+        } catch (...) {
+            // Let another producer try again.
+            segment.store(nullptr, std::memory_order_release);
+            throw;
+        }
+        for (std::size_t i = 0; i < (static_cast<std::size_t>(1U) << segment_bits); ++i) {
+            slots[i].state.store(slot_empty, std::memory_order_relaxed);
+        }
+        segment.store(slots, std::memory_order_release);
+        return slots;
+    }
+
+    /// @brief Returns the slot at the given position, which must be reserved.
+    /// @param position the position of the slot.
+    /// @return a pointer to the slot, null if its segment is not allocated yet.
+    auto locate(std::size_t position) -> slot_t *
+    {
+        slot_t *slots = this->segment_of(position).load(std::memory_order_acquire);
+        if (slots == nullptr || slots == this->allocating()) {
+            return nullptr;
+        }
+        return &slots[position & ((static_cast<std::size_t>(1U) << segment_bits) - 1U)];
+    }
+
+    /// @brief Returns the entry stored inside a slot.
+    /// @param slot the slot.
+    /// @return a pointer to the entry.
+    static auto entry_of(slot_t &slot) -> entry_t *
+    {
+        return reinterpret_cast<entry_t *>(&slot.storage);
+    }
+
+    /// @brief Destroys the pending entries and frees all the segments.
+    void release()
+    {
+        const std::size_t last = reserved.load(std::memory_order_acquire);
+        for (std::size_t position = drained.load(std::memory_order_acquire); position < last; ++position) {
+            slot_t *slot = this->locate(position);
+            if (slot != nullptr && slot->state.load(std::memory_order_acquire) == slot_ready) {
+                this->entry_of(*slot)->~entry_t();
+            }
+        }
+        for (auto &segment : segments) {
+            delete[] segment.exchange(nullptr, std::memory_order_acq_rel);
+        }
+    }
+
+    /// @brief The size of the segments, as a power of two.
+    std::size_t segment_bits;
+    /// @brief The number of slots handed out to producers.
+    std::atomic<std::size_t> reserved;
+    /// @brief The number of slots already moved out by the consumer.
+    std::atomic<std::size_t> drained;
+    /// @brief The ring of segments, allocated on demand.
+    std::atomic<slot_t *> segments[max_segments];
+};
+
+} // namespace ordered_multimap
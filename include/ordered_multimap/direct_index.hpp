@@ -0,0 +1,599 @@
+/// @file direct_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A direct-addressed index, for keys with a small domain.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief Tells if a key type is signed, enumerations use their underlying type.
+template <typename Key, bool = std::is_enum<Key>::value> struct direct_signed : std::is_signed<Key> {
+};
+
+/// @brief Tells if a key type is signed, enumerations use their underlying type.
+template <typename Key> struct direct_signed<Key, true> : std::is_signed<typename std::underlying_type<Key>::type> {
+};
+
+/// @brief Describes how keys are turned into slots of a direct index.
+/// @details Integers and enumerations of one or two bytes have at most 65536
+/// values, each one gets its own slot. The most significant bit of signed keys
+/// is flipped, so that the slots follow the order of the keys.
+/// @tparam Key the type of the key.
+template <typename Key> struct direct_key {
+    /// @brief True if the keys can be addressed directly.
+    static constexpr bool enabled = (std::is_integral<Key>::value || std::is_enum<Key>::value) && sizeof(Key) <= 2U;
+    /// @brief The unsigned integer with the same size of the key.
+    using bits_t = typename std::conditional<sizeof(Key) == 1U, std::uint8_t, std::uint16_t>::type;
+
+    /// @brief Returns the number of slots.
+    /// @return the number of slots.
+    static constexpr auto slots() -> std::size_t { return std::size_t(1) << (sizeof(bits_t) * 8U); }
+
+    /// @brief Returns the slot of the given key.
+    /// @param key the key.
+    /// @return the slot.
+    static auto slot(const Key &key) -> std::size_t
+    {
+        bits_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return static_cast<std::size_t>(direct_signed<Key>::value ? bits ^ (slots() >> 1U) : bits);
+    }
+};
+
+/// @brief Returns the first set bit of a 256-bit set, starting from the given one.
+/// @param words the set.
+/// @param from the first bit to consider.
+/// @return the position of the bit, 256 if there is none.
+inline auto next_set_bit(const std::uint64_t (&words)[4], std::size_t from) -> std::size_t
+{
+    for (std::size_t word = from / 64U; word < 4U; ++word) {
+        std::uint64_t bits = words[word];
+        if (word == from / 64U) {
+            bits &= ~std::uint64_t(0) << (from % 64U);
+        }
+        if (bits != 0U) {
+#if defined(__GNUC__)
+            return word * 64U + static_cast<std::size_t>(__builtin_ctzll(bits));
+#else
+            std::size_t bit = 0;
+            for (; (bits & 1U) == 0U; bits >>= 1U) {
+                ++bit;
+            }
+            return word * 64U + bit;
+#endif
+        }
+    }
+    return 256U;
+}
+
+} // namespace detail
+
+/// @brief A multimap with one slot per possible key, for keys of one or two
+/// bytes.
+/// @details It implements the subset of the `std::multimap` interface used by
+/// `ordered_multimap_t`. Every key value owns a group, holding the mapped
+/// values with that key in insertion order, and the key itself is the position
+/// of its group: `find`, `count`, and `equal_range` take constant time, and
+/// compare no keys. Groups are allocated in pages of 256, on first use, and
+/// two levels of bitmaps, one per page and one for the pages, let the
+/// iterators skip the empty groups.
+/// @tparam Key the type of the key, an integer or an enumeration of one or two
+/// bytes.
+/// @tparam Mapped the type of the mapped value.
+template <typename Key, typename Mapped> class direct_multimap_t
+{
+    static_assert(detail::direct_key<Key>::enabled, "Only keys of one or two bytes can be addressed directly.");
+
+    /// @brief The keys, and their slots.
+    using traits = detail::direct_key<Key>;
+
+    /// @brief The values with the same key.
+    struct group_t {
+        /// @brief The key.
+        Key key;
+        /// @brief The mapped values, in insertion order.
+        std::vector<Mapped> mapped;
+    };
+
+    /// @brief A page of groups, with the set of the groups which are not empty.
+    struct page_t {
+        /// @brief One bit per group, set if the group is not empty.
+        std::uint64_t occupied[4];
+        /// @brief The groups.
+        group_t groups[256];
+    };
+
+public:
+    /// @brief The type of the entries, when copied out of the map.
+    using value_type = std::pair<Key, Mapped>;
+
+    /// @brief A reference to an entry, with the members of a `std::pair`.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename MappedReference> struct reference_t {
+        /// @brief The key.
+        const Key &first;
+        /// @brief The mapped value.
+        MappedReference second;
+
+        /// @brief Copies the entry.
+        /// @return a copy of the entry.
+        operator value_type() const { return value_type(first, second); }
+    };
+
+    /// @brief An iterator over the entries, in key order.
+    /// @tparam Owner the type of the map, const or not.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename Owner, typename MappedReference> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename direct_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a reference to an entry.
+        using reference         = reference_t<MappedReference>;
+
+        /// @brief Provides `operator->` for the references.
+        struct pointer {
+            /// @brief The reference.
+            reference entry;
+
+            /// @brief Returns the reference.
+            /// @return a pointer to the reference.
+            auto operator->() -> reference * { return &entry; }
+        };
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : owner(nullptr)
+            , slot()
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _owner the map.
+        /// @param _slot the slot of the group, the number of slots for the end.
+        /// @param _position the position inside the group.
+        basic_iterator(Owner *_owner, std::size_t _slot, std::size_t _position)
+            : owner(_owner)
+            , slot(_slot)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the mutable iterator.
+        template <typename OtherOwner, typename OtherReference>
+        basic_iterator(const basic_iterator<OtherOwner, OtherReference> &other)
+            : owner(other.owner)
+            , slot(other.slot)
+            , position(other.position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference
+        {
+            auto &entries = owner->group(slot);
+            return reference{entries.key, entries.mapped[position]};
+        }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry, possibly in the next group.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            if (++position == owner->group(slot).mapped.size()) {
+                slot     = owner->next_slot(slot + 1U);
+                position = 0;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry, possibly in the next group.
+        /// @return a copy of this iterator, before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool
+        {
+            return slot == other.slot && position == other.position;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class direct_multimap_t;
+        template <typename, typename> friend class basic_iterator;
+
+        /// @brief The map.
+        Owner *owner;
+        /// @brief The slot of the group.
+        std::size_t slot;
+        /// @brief The position inside the group.
+        std::size_t position;
+    };
+
+    /// @brief Iterator over the entries.
+    using iterator       = basic_iterator<direct_multimap_t, Mapped &>;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = basic_iterator<const direct_multimap_t, const Mapped &>;
+
+    /// @brief Compares the entries by key.
+    struct value_compare {
+        /// @brief Compares two entries.
+        /// @param lhs the first entry.
+        /// @param rhs the second entry.
+        /// @return true if the key of the first is less than the one of the second.
+        template <typename Lhs, typename Rhs> auto operator()(const Lhs &lhs, const Rhs &rhs) const -> bool
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    /// @brief Construct an empty map, no page is allocated.
+    direct_multimap_t()
+        : pages(traits::slots() / 256U)
+        , occupied()
+        , entries()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Copy constructor.
+    /// @param other the map to copy.
+    direct_multimap_t(const direct_multimap_t &other)
+        : pages(traits::slots() / 256U)
+        , occupied()
+        , entries(other.entries)
+    {
+        for (std::size_t page = 0; page < pages.size(); ++page) {
+            if (other.pages[page]) {
+                pages[page].reset(new page_t(*other.pages[page]));
+            }
+        }
+        std::memcpy(occupied, other.occupied, sizeof(occupied));
+    }
+
+    /// @brief Move constructor.
+    /// @param other the map to move from, left empty.
+    direct_multimap_t(direct_multimap_t &&other) noexcept
+        : direct_multimap_t()
+    {
+        this->swap(other);
+    }
+
+    /// @brief Destructor.
+    ~direct_multimap_t() = default;
+
+    /// @brief Copy assignment.
+    /// @param other the map to copy.
+    /// @return a reference to the current map.
+    auto operator=(const direct_multimap_t &other) -> direct_multimap_t &
+    {
+        if (this != &other) {
+            direct_multimap_t copy(other);
+            this->swap(copy);
+        }
+        return *this;
+    }
+
+    /// @brief Move assignment.
+    /// @param other the map to move from, left empty.
+    /// @return a reference to the current map.
+    auto operator=(direct_multimap_t &&other) noexcept -> direct_multimap_t &
+    {
+        if (this != &other) {
+            this->clear();
+            this->swap(other);
+        }
+        return *this;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return entries; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return entries == 0; }
+
+    /// @brief Removes all the entries, and releases the pages.
+    void clear()
+    {
+        for (auto &page : pages) {
+            page.reset();
+        }
+        std::memset(occupied, 0, sizeof(occupied));
+        entries = 0;
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(direct_multimap_t &other)
+    {
+        pages.swap(other.pages);
+        std::swap(occupied, other.occupied);
+        std::swap(entries, other.entries);
+    }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return value_compare(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return iterator(this, this->next_slot(0), 0); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return const_iterator(this, this->next_slot(0), 0); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return iterator(this, traits::slots(), 0); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator { return const_iterator(this, traits::slots(), 0); }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        std::size_t slot = traits::slot(entry.first);
+        std::size_t page = slot / 256U;
+        if (!pages[page]) {
+            pages[page].reset(new page_t());
+            occupied[page / 64U] |= std::uint64_t(1) << (page % 64U);
+        }
+        group_t &group = pages[page]->groups[slot % 256U];
+        if (group.mapped.empty()) {
+            group.key = entry.first;
+            pages[page]->occupied[(slot % 256U) / 64U] |= std::uint64_t(1) << (slot % 64U);
+        }
+        group.mapped.push_back(entry.second);
+        ++entries;
+        return iterator(this, slot, group.mapped.size() - 1U);
+    }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @details The position of the entry is given by its key, the hint is
+    /// ignored.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator, const value_type &entry) -> iterator { return this->insert(entry); }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first) {
+            this->insert(static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator { return this->erase(position, std::next(position)); }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        using difference_t   = typename std::vector<Mapped>::difference_type;
+        std::size_t slot     = first.slot;
+        std::size_t position = first.position;
+        // Removes the tail of every group before the last one.
+        while (slot != last.slot) {
+            std::vector<Mapped> &mapped = this->group(slot).mapped;
+            entries -= mapped.size() - position;
+            mapped.erase(mapped.begin() + static_cast<difference_t>(position), mapped.end());
+            this->release(slot);
+            slot     = this->next_slot(slot + 1U);
+            position = 0;
+        }
+        // The last iterator refers to an entry, which remains in its group.
+        if (position < last.position) {
+            std::vector<Mapped> &mapped = this->group(slot).mapped;
+            entries -= last.position - position;
+            mapped.erase(
+                mapped.begin() + static_cast<difference_t>(position), mapped.begin() + static_cast<difference_t>(last.position));
+        }
+        return iterator(this, slot, position);
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator
+    {
+        std::size_t slot = traits::slot(key);
+        return this->count(key) > 0U ? iterator(this, slot, 0) : this->end();
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        std::size_t slot = traits::slot(key);
+        return this->count(key) > 0U ? const_iterator(this, slot, 0) : this->end();
+    }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        std::size_t slot = traits::slot(key);
+        return pages[slot / 256U] ? pages[slot / 256U]->groups[slot % 256U].mapped.size() : 0U;
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator { return iterator(this, this->next_slot(traits::slot(key)), 0); }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator
+    {
+        return const_iterator(this, this->next_slot(traits::slot(key)), 0);
+    }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator { return iterator(this, this->next_slot(traits::slot(key) + 1U), 0); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator
+    {
+        return const_iterator(this, this->next_slot(traits::slot(key) + 1U), 0);
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @details An absent key gives an empty range at the end.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        if (this->count(key) == 0U) {
+            return std::make_pair(this->end(), this->end());
+        }
+        return std::make_pair(iterator(this, traits::slot(key), 0), this->upper_bound(key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @details An absent key gives an empty range at the end.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        if (this->count(key) == 0U) {
+            return std::make_pair(this->end(), this->end());
+        }
+        return std::make_pair(const_iterator(this, traits::slot(key), 0), this->upper_bound(key));
+    }
+
+private:
+    /// @brief Returns the group in the given slot, whose page must exist.
+    /// @param slot the slot.
+    /// @return a reference to the group.
+    auto group(std::size_t slot) -> group_t & { return pages[slot / 256U]->groups[slot % 256U]; }
+
+    /// @brief Returns the group in the given slot, whose page must exist.
+    /// @param slot the slot.
+    /// @return a reference to the group.
+    auto group(std::size_t slot) const -> const group_t & { return pages[slot / 256U]->groups[slot % 256U]; }
+
+    /// @brief Marks the group in the given slot as empty, if it is.
+    /// @param slot the slot.
+    void release(std::size_t slot)
+    {
+        if (this->group(slot).mapped.empty()) {
+            pages[slot / 256U]->occupied[(slot % 256U) / 64U] &= ~(std::uint64_t(1) << (slot % 64U));
+        }
+    }
+
+    /// @brief Returns the first slot, starting from the given one, whose group
+    /// is not empty.
+    /// @param slot the first slot to consider.
+    /// @return the slot, the number of slots if there is none.
+    auto next_slot(std::size_t slot) const -> std::size_t
+    {
+        std::size_t page = slot / 256U;
+        if (page < pages.size() && pages[page]) {
+            std::size_t offset = detail::next_set_bit(pages[page]->occupied, slot % 256U);
+            if (offset < 256U) {
+                return page * 256U + offset;
+            }
+        }
+        // Pages stay allocated when their groups empty, hence the page bitmap
+        // only narrows the search.
+        for (page = detail::next_set_bit(occupied, page + 1U); page < pages.size();
+             page = detail::next_set_bit(occupied, page + 1U)) {
+            std::size_t offset = detail::next_set_bit(pages[page]->occupied, 0);
+            if (offset < 256U) {
+                return page * 256U + offset;
+            }
+        }
+        return traits::slots();
+    }
+
+    /// @brief The pages, allocated on first use.
+    std::vector<std::unique_ptr<page_t>> pages;
+    /// @brief One bit per page, set if the page is allocated.
+    std::uint64_t occupied[4];
+    /// @brief The number of entries.
+    std::size_t entries;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which addresses directly
+/// the keys of one or two bytes, and falls back to a `std::multimap` for the
+/// others.
+/// @details For instance:
+/// @code
+/// enum class opcode_t : std::uint8_t { load, store, jump };
+/// ordered_multimap_t<opcode_t, instruction_t, direct_index_t> program;
+/// @endcode
+struct direct_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle>
+    using type = typename std::conditional<
+        detail::direct_key<Key>::enabled,
+        direct_multimap_t<Key, Handle>,
+        std::multimap<Key, Handle>>::type;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,144 @@
+/// @file durable_file.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Helpers to read files, and to replace them atomically and durably.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief Forces the data written to a file down to the storage device.
+/// @param file the file, already flushed.
+/// @return true on success.
+inline auto sync_file(std::FILE *file) -> bool
+{
+#if defined(_WIN32)
+    return ::_commit(::_fileno(file)) == 0;
+#else
+    return ::fsync(::fileno(file)) == 0;
+#endif
+}
+
+/// @brief Forces the entries of the directory holding a file down to the
+/// storage device, so that a file created or renamed there survives a crash.
+/// @details Windows offers no way to sync a directory, it does nothing there.
+/// @param path the path of the file.
+/// @return true on success.
+inline auto sync_directory(const std::string &path) -> bool
+{
+#if defined(_WIN32)
+    (void)path;
+    return true;
+#else
+    const std::string::size_type slash = path.find_last_of('/');
+    const std::string directory        = slash == std::string::npos ? "." : path.substr(0U, slash + 1U);
+    int descriptor                     = ::open(directory.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    bool success = ::fsync(descriptor) == 0;
+    return ::close(descriptor) == 0 && success;
+#endif
+}
+
+/// @brief Moves to the given offset of a file, which may exceed the range of
+/// `long`, unlike with `std::fseek`.
+/// @param file the file.
+/// @param offset the offset from the beginning of the file.
+/// @return true on success.
+inline auto seek_file(std::FILE *file, std::uint64_t offset) -> bool
+{
+#if defined(_WIN32)
+    return ::_fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return ::fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+/// @brief Cuts a file down to the given size, which must be closed.
+/// @param path the path of the file.
+/// @param size the new size.
+/// @return true on success.
+inline auto truncate_file(const std::string &path, std::uint64_t size) -> bool
+{
+#if defined(_WIN32)
+    int descriptor = ::_open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (descriptor < 0) {
+        return false;
+    }
+    bool success = ::_chsize_s(descriptor, static_cast<__int64>(size)) == 0;
+    return ::_close(descriptor) == 0 && success;
+#else
+    return ::truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+/// @brief Reads a whole file.
+/// @param path the path of the file.
+/// @param content where the content is stored.
+/// @return true if the file exists and was read.
+inline auto read_file(const std::string &path, std::string &content) -> bool
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+/// @brief Replaces the content of a file, so that after a crash either the
+/// old or the new content is found, never a mix of the two.
+/// @details The content is written to `<path>.tmp`, synced, and then renamed
+/// over the file; the directory is synced last, so that the rename cannot be
+/// undone by a power loss once this returns.
+/// @param path the path of the file.
+/// @param content the new content.
+/// @return true on success.
+inline auto replace_file(const std::string &path, const std::string &content) -> bool
+{
+    const std::string temporary = path + ".tmp";
+    std::FILE *file             = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool success = std::fwrite(content.data(), 1U, content.size(), file) == content.size();
+    success      = success && std::fflush(file) == 0 && detail::sync_file(file);
+    success      = std::fclose(file) == 0 && success;
+    if (!success) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+#if defined(_WIN32)
+    // Windows does not replace existing files on rename.
+    std::remove(path.c_str());
+#endif
+    return std::rename(temporary.c_str(), path.c_str()) == 0 && detail::sync_directory(path);
+}
+
+} // namespace detail
+
+} // namespace ordered_multimap
@@ -0,0 +1,624 @@
+/// @file eytzinger_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An index which can be turned into a read-optimized, Eytzinger,
+/// layout.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief Drops the trailing ones of a position in an Eytzinger layout, and
+/// the zero before them: the descent went right since that node, and left at
+/// it, hence it is the one searched for.
+/// @param position the position where the descent ended.
+/// @return the position of the result, zero for none.
+inline auto eytzinger_resume(std::size_t position) -> std::size_t
+{
+#if defined(__GNUC__)
+    return position >> (static_cast<unsigned>(__builtin_ctzll(~static_cast<unsigned long long>(position))) + 1U);
+#else
+    while ((position & 1U) != 0U) {
+        position >>= 1U;
+    }
+    return position >> 1U;
+#endif
+}
+
+} // namespace detail
+
+/// @brief A multimap stored in a `std::multimap` while it is written, and in a
+/// sorted array, searched through an Eytzinger layout, once optimized for
+/// reads.
+/// @details It implements the subset of the `std::multimap` interface used by
+/// `ordered_multimap_t`, plus `optimize_for_reads`. The Eytzinger layout
+/// stores the keys of a complete binary search tree in breadth-first order:
+/// the children of position k are at 2k and 2k + 1. A search is a branchless
+/// descent over this array, which prefetches the nodes a few levels below, so
+/// the loads of successive levels overlap instead of chasing pointers. The
+/// entries themselves stay sorted, for iteration. The first insertion or
+/// removal moves the entries back into the `std::multimap`, and lookups use it
+/// until the next call to `optimize_for_reads`, hence switching invalidates
+/// the iterators of the index.
+/// @tparam Key the type of the key.
+/// @tparam Mapped the type of the mapped value.
+template <typename Key, typename Mapped> class eytzinger_multimap_t
+{
+    /// @brief The type of the map used while writing.
+    using tree_t = std::multimap<Key, Mapped>;
+
+    /// @brief The descendants of a node prefetched during a search, a power of
+    /// two which fits a cache line.
+    enum : std::size_t {
+        prefetch_stride = sizeof(Key) <= 4U ? 16U : (sizeof(Key) <= 8U ? 8U : (sizeof(Key) <= 16U ? 4U : 2U)),
+    };
+
+public:
+    /// @brief The type of the entries, when copied out of the map.
+    using value_type = std::pair<Key, Mapped>;
+
+    /// @brief A reference to an entry, with the members of a `std::pair`.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename MappedReference> struct reference_t {
+        /// @brief The key.
+        const Key &first;
+        /// @brief The mapped value.
+        MappedReference second;
+
+        /// @brief Copies the entry.
+        /// @return a copy of the entry.
+        operator value_type() const { return value_type(first, second); }
+    };
+
+    /// @brief An iterator over the entries, in key order, either in the tree
+    /// or in the sorted array.
+    /// @tparam Owner the type of the map, const or not.
+    /// @tparam TreeIterator the type of iterator of the tree.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename Owner, typename TreeIterator, typename MappedReference> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename eytzinger_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a reference to an entry.
+        using reference         = reference_t<MappedReference>;
+
+        /// @brief Provides `operator->` for the references.
+        struct pointer {
+            /// @brief The reference.
+            reference entry;
+
+            /// @brief Returns the reference.
+            /// @return a pointer to the reference.
+            auto operator->() -> reference * { return &entry; }
+        };
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : owner(nullptr)
+            , node()
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator over the tree.
+        /// @param _node the entry of the tree.
+        explicit basic_iterator(TreeIterator _node)
+            : owner()
+            , node(_node)
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator over the sorted array.
+        /// @param _owner the map.
+        /// @param _position the position in the array.
+        basic_iterator(Owner *_owner, std::size_t _position)
+            : owner(_owner)
+            , node()
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the mutable iterator.
+        template <typename OtherOwner, typename OtherIterator, typename OtherReference>
+        basic_iterator(const basic_iterator<OtherOwner, OtherIterator, OtherReference> &other)
+            : owner(other.owner)
+            , node(other.node)
+            , position(other.position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference
+        {
+            if (owner != nullptr) {
+                return reference{owner->keys[position], owner->mapped[position]};
+            }
+            return reference{node->first, node->second};
+        }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            if (owner != nullptr) {
+                ++position;
+            } else {
+                ++node;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of this iterator, before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool
+        {
+            return owner == other.owner && (owner != nullptr ? position == other.position : node == other.node);
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class eytzinger_multimap_t;
+        template <typename, typename, typename> friend class basic_iterator;
+
+        /// @brief The map, null while iterating over the tree.
+        Owner *owner;
+        /// @brief The entry of the tree.
+        TreeIterator node;
+        /// @brief The position in the sorted array.
+        std::size_t position;
+    };
+
+    /// @brief Iterator over the entries.
+    using iterator       = basic_iterator<eytzinger_multimap_t, typename tree_t::iterator, Mapped &>;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = basic_iterator<const eytzinger_multimap_t, typename tree_t::const_iterator, const Mapped &>;
+
+    /// @brief Compares the entries by key.
+    struct value_compare {
+        /// @brief Compares two entries.
+        /// @param lhs the first entry.
+        /// @param rhs the second entry.
+        /// @return true if the key of the first is less than the one of the second.
+        template <typename Lhs, typename Rhs> auto operator()(const Lhs &lhs, const Rhs &rhs) const -> bool
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    /// @brief Construct an empty map.
+    eytzinger_multimap_t()
+        : tree()
+        , keys()
+        , mapped()
+        , layout()
+        , ranks()
+        , optimized()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Checks if the map is in its read-optimized layout.
+    /// @return true if lookups use the Eytzinger layout.
+    auto is_optimized() const -> bool { return optimized; }
+
+    /// @brief Moves the entries into a sorted array, and builds the Eytzinger
+    /// layout of their keys.
+    /// @details It takes linear time, and invalidates the iterators.
+    void optimize_for_reads()
+    {
+        if (optimized) {
+            return;
+        }
+        keys.reserve(tree.size());
+        mapped.reserve(tree.size());
+        for (typename tree_t::value_type &entry : tree) {
+            keys.push_back(entry.first);
+            mapped.push_back(std::move(entry.second));
+        }
+        tree.clear();
+        layout.resize(keys.size() + 1U);
+        ranks.resize(keys.size() + 1U);
+        std::size_t rank = 0;
+        this->build_layout(1U, rank);
+        optimized = true;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return optimized ? keys.size() : tree.size(); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return this->size() == 0; }
+
+    /// @brief Removes all the entries, and leaves the read-optimized layout.
+    void clear()
+    {
+        tree.clear();
+        keys.clear();
+        mapped.clear();
+        layout.clear();
+        ranks.clear();
+        optimized = false;
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(eytzinger_multimap_t &other)
+    {
+        tree.swap(other.tree);
+        keys.swap(other.keys);
+        mapped.swap(other.mapped);
+        layout.swap(other.layout);
+        ranks.swap(other.ranks);
+        std::swap(optimized, other.optimized);
+    }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return value_compare(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return optimized ? iterator(this, 0) : iterator(tree.begin()); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return optimized ? const_iterator(this, 0) : const_iterator(tree.begin()); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return optimized ? iterator(this, keys.size()) : iterator(tree.end()); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator
+    {
+        return optimized ? const_iterator(this, keys.size()) : const_iterator(tree.end());
+    }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        this->restore();
+        return iterator(tree.insert(entry));
+    }
+
+    /// @brief Inserts an entry, after those with the same key, as close as
+    /// possible to the hint.
+    /// @param hint the suggested position.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator hint, const value_type &entry) -> iterator
+    {
+        return iterator(tree.insert(this->restore(hint), entry));
+    }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        this->restore();
+        for (; first != last; ++first) {
+            tree.insert(tree.end(), static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator { return iterator(tree.erase(this->restore(position))); }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        if (!optimized) {
+            return iterator(tree.erase(first.node, last.node));
+        }
+        std::size_t count                    = last.position - first.position;
+        typename tree_t::const_iterator node = this->restore(first);
+        return iterator(tree.erase(node, std::next(node, static_cast<std::ptrdiff_t>(count))));
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator
+    {
+        if (!optimized) {
+            return iterator(tree.find(key));
+        }
+        std::size_t position = this->search<false>(key);
+        return iterator(this, position < keys.size() && !(key < keys[position]) ? position : keys.size());
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        if (!optimized) {
+            return const_iterator(tree.find(key));
+        }
+        std::size_t position = this->search<false>(key);
+        return const_iterator(this, position < keys.size() && !(key < keys[position]) ? position : keys.size());
+    }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        return optimized ? this->search<true>(key) - this->search<false>(key) : tree.count(key);
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator
+    {
+        return optimized ? iterator(this, this->search<false>(key)) : iterator(tree.lower_bound(key));
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator
+    {
+        return optimized ? const_iterator(this, this->search<false>(key)) : const_iterator(tree.lower_bound(key));
+    }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator
+    {
+        return optimized ? iterator(this, this->search<true>(key)) : iterator(tree.upper_bound(key));
+    }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator
+    {
+        return optimized ? const_iterator(this, this->search<true>(key)) : const_iterator(tree.upper_bound(key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+    /// @brief Finds the first entry of each key of a range.
+    /// @details Once optimized for reads, the keys are searched in groups,
+    /// one level at a time: the next node of every key of the group is
+    /// prefetched before any of them is read, so their cache misses overlap.
+    /// @tparam ForwardIt the type of iterator over the keys.
+    /// @tparam Visitor the type of function receiving the results.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with an iterator to the entry, or the end, for each
+    /// key, in the order of the keys.
+    template <typename ForwardIt, typename Visitor> void find_many(ForwardIt first, ForwardIt last, Visitor visit)
+    {
+        this->find_batch<iterator>(this, first, last, visit);
+    }
+
+    /// @brief Finds the first entry of each key of a range.
+    /// @tparam ForwardIt the type of iterator over the keys.
+    /// @tparam Visitor the type of function receiving the results.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with an iterator to the entry, or the end, for each
+    /// key, in the order of the keys.
+    template <typename ForwardIt, typename Visitor> void find_many(ForwardIt first, ForwardIt last, Visitor visit) const
+    {
+        this->find_batch<const_iterator>(this, first, last, visit);
+    }
+
+private:
+    /// @brief The number of keys searched together by `find_many`.
+    enum : std::size_t {
+        batch = 16U, ///< Enough to keep the memory busy.
+    };
+
+    /// @brief Implements `find_many`.
+    /// @tparam Iterator the type of iterator passed to the visitor.
+    /// @tparam Owner the type of the map, const or not.
+    template <typename Iterator, typename Owner, typename ForwardIt, typename Visitor>
+    static void find_batch(Owner *owner, ForwardIt first, ForwardIt last, Visitor &visit)
+    {
+        if (!owner->optimized) {
+            for (; first != last; ++first) {
+                visit(owner->find(*first));
+            }
+            return;
+        }
+        const Key *nodes  = owner->layout.data();
+        std::size_t count = owner->layout.size();
+        const Key *keys[batch];
+        std::size_t positions[batch];
+        while (first != last) {
+            std::size_t size = 0;
+            for (; size < batch && first != last; ++first, ++size) {
+                keys[size]      = &*first;
+                positions[size] = 1;
+            }
+            // The descents of a complete tree differ by one level at most.
+            for (bool active = true; active;) {
+                active = false;
+                for (std::size_t i = 0; i < size; ++i) {
+                    if (positions[i] < count) {
+                        positions[i] = 2U * positions[i] + static_cast<std::size_t>(nodes[positions[i]] < *keys[i]);
+#if defined(__GNUC__)
+                        __builtin_prefetch(nodes + (positions[i] < count ? positions[i] : 0U));
+#endif
+                        active = true;
+                    }
+                }
+            }
+            for (std::size_t i = 0; i < size; ++i) {
+                std::size_t position = detail::eytzinger_resume(positions[i]);
+                position             = position != 0U ? owner->ranks[position] : owner->keys.size();
+                bool found           = position < owner->keys.size() && !(*keys[i] < owner->keys[position]);
+                visit(Iterator(owner, found ? position : owner->keys.size()));
+            }
+        }
+    }
+
+    /// @brief Fills the layout with the sorted keys, by an in-order visit.
+    /// @param position the position in the layout.
+    /// @param rank the next sorted position, advanced by the visit.
+    void build_layout(std::size_t position, std::size_t &rank)
+    {
+        if (position < layout.size()) {
+            this->build_layout(2U * position, rank);
+            layout[position] = keys[rank];
+            ranks[position]  = rank++;
+            this->build_layout(2U * position + 1U, rank);
+        }
+    }
+
+    /// @brief Returns the sorted position of the first key not less than (or,
+    /// if Upper, greater than) the given one.
+    /// @details The descent never branches on the keys, and prefetches the
+    /// descendants a cache line holds, a few levels below the current node.
+    /// @tparam Upper whether to skip the keys equal to the given one.
+    /// @param key the key.
+    /// @return the position, the number of entries if there is none.
+    template <bool Upper> auto search(const Key &key) const -> std::size_t
+    {
+        const Key *nodes     = layout.data();
+        std::size_t count    = layout.size();
+        std::size_t position = 1;
+        while (position < count) {
+#if defined(__GNUC__)
+            __builtin_prefetch(nodes + (position < count / prefetch_stride ? prefetch_stride * position : 0U));
+#endif
+            bool right = Upper ? !(key < nodes[position]) : nodes[position] < key;
+            position   = 2U * position + static_cast<std::size_t>(right);
+        }
+        position = detail::eytzinger_resume(position);
+        return position != 0U ? ranks[position] : keys.size();
+    }
+
+    /// @brief Moves the entries back into the tree, if optimized for reads.
+    void restore()
+    {
+        if (optimized) {
+            optimized = false;
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                tree.insert(tree.end(), value_type(std::move(keys[i]), std::move(mapped[i])));
+            }
+            std::vector<Key>().swap(keys);
+            std::vector<Mapped>().swap(mapped);
+            std::vector<Key>().swap(layout);
+            std::vector<std::size_t>().swap(ranks);
+        }
+    }
+
+    /// @brief Moves the entries back into the tree, if optimized for reads,
+    /// and returns the entry of the tree at the position of the iterator.
+    /// @param position the iterator.
+    /// @return the entry of the tree.
+    auto restore(const_iterator position) -> typename tree_t::const_iterator
+    {
+        if (!optimized) {
+            return position.node;
+        }
+        std::size_t offset = position.position;
+        this->restore();
+        return std::next(tree.cbegin(), static_cast<std::ptrdiff_t>(offset));
+    }
+
+    /// @brief The entries, while the map is written.
+    tree_t tree;
+    /// @brief The sorted keys, once optimized for reads.
+    std::vector<Key> keys;
+    /// @brief The mapped values, in the order of the keys.
+    std::vector<Mapped> mapped;
+    /// @brief The keys in Eytzinger order, starting from position one.
+    std::vector<Key> layout;
+    /// @brief The sorted position of each key of the layout.
+    std::vector<std::size_t> ranks;
+    /// @brief Whether the map is optimized for reads.
+    bool optimized;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which uses a
+/// `std::multimap` until `optimize_for_reads()` turns it into a sorted array
+/// searched through an Eytzinger layout.
+/// @details For instance:
+/// @code
+/// ordered_multimap_t<std::uint64_t, Route, eytzinger_index_t> routes(first, last);
+/// routes.optimize_for_reads();
+/// @endcode
+struct eytzinger_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle> using type = eytzinger_multimap_t<Key, Handle>;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,713 @@
+/// @file flat_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A sorted, contiguous, index for integer keys, searched with SIMD
+/// instructions.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ORDERED_MULTIMAP_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define ORDERED_MULTIMAP_HAS_SSE2 0
+#endif
+
+#if ORDERED_MULTIMAP_HAS_SSE2 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ORDERED_MULTIMAP_HAS_AVX2 1
+#include <immintrin.h>
+#else
+#define ORDERED_MULTIMAP_HAS_AVX2 0
+#endif
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief The instruction sets which can search the keys.
+enum class simd_level_t : unsigned char {
+    scalar, ///< Plain comparisons.
+    sse2,   ///< 128-bit comparisons, for 32-bit keys.
+    avx2,   ///< 256-bit comparisons, for 32-bit and 64-bit keys.
+};
+
+/// @brief Returns the best instruction set supported by the processor.
+/// @details The processor is queried once, AVX2 code is compiled for its own
+/// target, and only runs if the processor supports it.
+/// @return the instruction set.
+inline auto simd_level() -> simd_level_t
+{
+#if ORDERED_MULTIMAP_HAS_AVX2
+    static const simd_level_t level = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? simd_level_t::avx2 : simd_level_t::sse2;
+    }();
+    return level;
+#elif ORDERED_MULTIMAP_HAS_SSE2
+    return simd_level_t::sse2;
+#else
+    return simd_level_t::scalar;
+#endif
+}
+
+/// @brief Tells if a key type is signed, enumerations use their underlying type.
+template <typename Key, bool = std::is_enum<Key>::value> struct simd_signed : std::is_signed<Key> {
+};
+
+/// @brief Tells if a key type is signed, enumerations use their underlying type.
+template <typename Key> struct simd_signed<Key, true> : std::is_signed<typename std::underlying_type<Key>::type> {
+};
+
+/// @brief Describes how the vectorized search compares the keys.
+/// @details Only 32-bit and 64-bit integers and enumerations are compared with
+/// SIMD instructions, whose comparisons are signed: unsigned keys are biased
+/// by flipping their most significant bit, which preserves their order.
+/// @tparam Key the type of the key.
+template <typename Key> struct simd_key {
+    /// @brief True if the keys can be compared with SIMD instructions.
+    static constexpr bool enabled = (std::is_integral<Key>::value || std::is_enum<Key>::value) &&
+                                    !std::is_same<Key, bool>::value && (sizeof(Key) == 4U || sizeof(Key) == 8U);
+    /// @brief The unsigned integer with the same size of the key.
+    using lane_t = typename std::conditional<sizeof(Key) == 8U, std::uint64_t, std::uint32_t>::type;
+
+    /// @brief Returns the bias applied to the keys before comparing them.
+    /// @return the bias.
+    static constexpr auto bias() -> lane_t
+    {
+        return simd_signed<Key>::value ? lane_t(0) : static_cast<lane_t>(lane_t(1) << (sizeof(lane_t) * 8U - 1U));
+    }
+
+    /// @brief Returns the bits of the key.
+    /// @param key the key.
+    /// @return the bits of the key.
+    static auto bits(const Key &key) -> lane_t
+    {
+        lane_t lane;
+        std::memcpy(&lane, &key, sizeof(lane));
+        return lane;
+    }
+};
+
+/// @brief Returns the number of keys which are less than (lower), or not
+/// greater than (upper), the given one.
+/// @tparam Upper false to count the keys less than the given one, true to
+/// count the keys not greater than it.
+/// @tparam Key the type of the key.
+/// @param keys the keys.
+/// @param count the number of keys.
+/// @param key the key.
+/// @return the number of keys.
+template <bool Upper, typename Key> auto rank_scalar(const Key *keys, std::size_t count, const Key &key) -> std::size_t
+{
+    std::size_t rank = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        rank += static_cast<std::size_t>(Upper ? !(key < keys[i]) : (keys[i] < key));
+    }
+    return rank;
+}
+
+#if ORDERED_MULTIMAP_HAS_SSE2
+/// @brief Ranks a key among 32-bit keys, four at a time, with SSE2.
+/// @details Each comparison sets its matching lanes to -1, which are
+/// subtracted from per-lane counters, summed once at the end.
+/// @tparam Upper true to count the keys not greater than the given one.
+/// @param keys the keys.
+/// @param count the number of keys, a multiple of four.
+/// @param key the bits of the key.
+/// @param bias the bias of the keys.
+/// @return the number of keys less than (not greater than) the given one.
+template <bool Upper>
+auto rank_sse2_32(const void *keys, std::size_t count, std::uint32_t key, std::uint32_t bias) -> std::size_t
+{
+    const __m128i flip   = _mm_set1_epi32(static_cast<int>(bias));
+    const __m128i needle = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), flip);
+    const auto *data     = static_cast<const __m128i *>(keys);
+    __m128i matches      = _mm_setzero_si128();
+    for (std::size_t i = 0; i < count / 4U; ++i) {
+        __m128i lanes = _mm_xor_si128(_mm_loadu_si128(data + i), flip);
+        matches       = _mm_sub_epi32(matches, Upper ? _mm_cmpgt_epi32(lanes, needle) : _mm_cmplt_epi32(lanes, needle));
+    }
+    std::uint32_t sums[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), matches);
+    std::size_t total = static_cast<std::size_t>(sums[0]) + sums[1] + sums[2] + sums[3];
+    return Upper ? count - total : total;
+}
+#endif
+
+#if ORDERED_MULTIMAP_HAS_AVX2
+/// @brief Ranks a key among 32-bit keys, eight at a time, with AVX2.
+/// @tparam Upper true to count the keys not greater than the given one.
+/// @param keys the keys.
+/// @param count the number of keys, a multiple of eight.
+/// @param key the bits of the key.
+/// @param bias the bias of the keys.
+/// @return the number of keys less than (not greater than) the given one.
+template <bool Upper>
+__attribute__((target("avx2"))) auto
+rank_avx2_32(const void *keys, std::size_t count, std::uint32_t key, std::uint32_t bias) -> std::size_t
+{
+    const __m256i flip   = _mm256_set1_epi32(static_cast<int>(bias));
+    const __m256i needle = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), flip);
+    const auto *data     = static_cast<const __m256i *>(keys);
+    __m256i matches      = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < count / 8U; ++i) {
+        __m256i lanes = _mm256_xor_si256(_mm256_loadu_si256(data + i), flip);
+        matches = _mm256_sub_epi32(matches, Upper ? _mm256_cmpgt_epi32(lanes, needle) : _mm256_cmpgt_epi32(needle, lanes));
+    }
+    std::uint32_t sums[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), matches);
+    std::size_t total = 0;
+    for (std::uint32_t sum : sums) {
+        total += sum;
+    }
+    return Upper ? count - total : total;
+}
+
+/// @brief Ranks a key among 64-bit keys, four at a time, with AVX2.
+/// @tparam Upper true to count the keys not greater than the given one.
+/// @param keys the keys.
+/// @param count the number of keys, a multiple of four.
+/// @param key the bits of the key.
+/// @param bias the bias of the keys.
+/// @return the number of keys less than (not greater than) the given one.
+template <bool Upper>
+__attribute__((target("avx2"))) auto
+rank_avx2_64(const void *keys, std::size_t count, std::uint64_t key, std::uint64_t bias) -> std::size_t
+{
+    const __m256i flip   = _mm256_set1_epi64x(static_cast<long long>(bias));
+    const __m256i needle = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), flip);
+    const auto *data     = static_cast<const __m256i *>(keys);
+    __m256i matches      = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < count / 4U; ++i) {
+        __m256i lanes = _mm256_xor_si256(_mm256_loadu_si256(data + i), flip);
+        matches = _mm256_sub_epi64(matches, Upper ? _mm256_cmpgt_epi64(lanes, needle) : _mm256_cmpgt_epi64(needle, lanes));
+    }
+    std::uint64_t sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), matches);
+    auto total = static_cast<std::size_t>(sums[0] + sums[1] + sums[2] + sums[3]);
+    return Upper ? count - total : total;
+}
+#endif
+
+/// @brief Ranks a key among a few sorted keys, with the given instruction set.
+/// @details The keys are compared all, without branches, the vectors first,
+/// then the remainder one by one.
+/// @tparam Upper true to count the keys not greater than the given one.
+/// @tparam Key the type of the key.
+/// @param keys the keys.
+/// @param count the number of keys.
+/// @param key the key.
+/// @param level the instruction set.
+/// @return the number of keys less than (not greater than) the given one.
+template <bool Upper, typename Key>
+auto rank_window(const Key *keys, std::size_t count, const Key &key, simd_level_t level) -> std::size_t
+{
+    std::size_t vector = 0;
+    std::size_t rank   = 0;
+#if ORDERED_MULTIMAP_HAS_AVX2
+    if (level == simd_level_t::avx2) {
+        vector = count - count % (32U / sizeof(Key));
+        if (sizeof(Key) == 4U) {
+            rank = rank_avx2_32<Upper>(
+                keys, vector, static_cast<std::uint32_t>(simd_key<Key>::bits(key)),
+                static_cast<std::uint32_t>(simd_key<Key>::bias()));
+        } else {
+            rank = rank_avx2_64<Upper>(keys, vector, simd_key<Key>::bits(key), simd_key<Key>::bias());
+        }
+    }
+#endif
+#if ORDERED_MULTIMAP_HAS_SSE2
+    if (level == simd_level_t::sse2 && sizeof(Key) == 4U) {
+        vector = count - count % 4U;
+        rank   = rank_sse2_32<Upper>(
+            keys, vector, static_cast<std::uint32_t>(simd_key<Key>::bits(key)),
+            static_cast<std::uint32_t>(simd_key<Key>::bias()));
+    }
+#endif
+    (void)level;
+    return rank + rank_scalar<Upper>(keys + vector, count - vector, key);
+}
+
+/// @brief Returns the position of the first key not less than (lower), or
+/// greater than (upper), the given one, among sorted keys.
+/// @details This is a plain binary search, for keys which cannot be compared
+/// with SIMD instructions, or processors which lack them.
+/// @tparam Upper false for the lower bound, true for the upper bound.
+/// @tparam Key the type of the key.
+/// @param keys the keys, sorted.
+/// @param count the number of keys.
+/// @param key the key.
+/// @return the position.
+template <bool Upper, typename Key>
+auto search(const Key *keys, std::size_t count, const Key &key, simd_level_t, std::false_type) -> std::size_t
+{
+    const Key *position = Upper ? std::upper_bound(keys, keys + count, key) : std::lower_bound(keys, keys + count, key);
+    return static_cast<std::size_t>(position - keys);
+}
+
+/// @brief Returns the position of the first key not less than (lower), or
+/// greater than (upper), the given one, among sorted keys.
+/// @details A branchless binary search narrows the range down to a window of
+/// a couple of cache lines, whose keys are then compared all at once.
+/// @tparam Upper false for the lower bound, true for the upper bound.
+/// @tparam Key the type of the key.
+/// @param keys the keys, sorted.
+/// @param count the number of keys.
+/// @param key the key.
+/// @param level the instruction set.
+/// @return the position.
+template <bool Upper, typename Key>
+auto search(const Key *keys, std::size_t count, const Key &key, simd_level_t level, std::true_type) -> std::size_t
+{
+    if (level == simd_level_t::scalar) {
+        return search<Upper>(keys, count, key, level, std::false_type());
+    }
+    const std::size_t window = 128U / sizeof(Key);
+    std::size_t first        = 0;
+    while (count > window) {
+        std::size_t half = count / 2U;
+        // Both outcomes keep the bound inside [first, first + count], which
+        // lets the compiler pick a conditional move rather than a branch.
+        first += (Upper ? !(key < keys[first + half]) : (keys[first + half] < key)) ? half : 0U;
+        count -= half;
+    }
+    return first + rank_window<Upper>(keys + first, count, key, level);
+}
+
+/// @brief Returns the position of the first key not less than (lower), or
+/// greater than (upper), the given one, among sorted keys.
+/// @tparam Upper false for the lower bound, true for the upper bound.
+/// @tparam Key the type of the key.
+/// @param keys the keys, sorted.
+/// @param count the number of keys.
+/// @param key the key.
+/// @param level the instruction set, the best one by default.
+/// @return the position.
+template <bool Upper, typename Key>
+auto search(const Key *keys, std::size_t count, const Key &key, simd_level_t level = simd_level()) -> std::size_t
+{
+    return search<Upper>(keys, count, key, level, std::integral_constant<bool, simd_key<Key>::enabled>());
+}
+
+} // namespace detail
+
+/// @brief A multimap storing its keys sorted, in a contiguous array, apart
+/// from the mapped values.
+/// @details It implements the subset of the `std::multimap` interface used by
+/// `ordered_multimap_t`. Lookups are binary searches over the keys alone,
+/// which finish by comparing the last couple of cache lines of keys at once:
+/// with SSE2 or AVX2, selected at runtime, when the keys are 32-bit or 64-bit
+/// integers or enumerations, one by one otherwise. Insertions and removals
+/// shift the keys that follow, hence it suits maps which are small, built in
+/// bulk, or read far more often than they are written.
+/// @tparam Key the type of the key.
+/// @tparam Mapped the type of the mapped value.
+template <typename Key, typename Mapped> class flat_multimap_t
+{
+public:
+    /// @brief The type of the entries, when copied out of the map.
+    using value_type = std::pair<Key, Mapped>;
+
+    /// @brief A reference to an entry, with the members of a `std::pair`.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename MappedReference> struct reference_t {
+        /// @brief The key.
+        const Key &first;
+        /// @brief The mapped value.
+        MappedReference second;
+
+        /// @brief Copies the entry.
+        /// @return a copy of the entry.
+        operator value_type() const { return value_type(first, second); }
+    };
+
+    /// @brief An iterator over the entries, in key order.
+    /// @tparam Owner the type of the map, const or not.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename Owner, typename MappedReference> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::bidirectional_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename flat_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a reference to an entry.
+        using reference         = reference_t<MappedReference>;
+
+        /// @brief Provides `operator->` for the references.
+        struct pointer {
+            /// @brief The reference.
+            reference entry;
+
+            /// @brief Returns the reference.
+            /// @return a pointer to the reference.
+            auto operator->() -> reference * { return &entry; }
+        };
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : owner(nullptr)
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _owner the map.
+        /// @param _position the position of the entry.
+        basic_iterator(Owner *_owner, std::size_t _position)
+            : owner(_owner)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the mutable iterator.
+        template <typename OtherOwner, typename OtherReference>
+        basic_iterator(const basic_iterator<OtherOwner, OtherReference> &other)
+            : owner(other.owner)
+            , position(other.position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference { return reference{owner->keys[position], owner->mapped[position]}; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            ++position;
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of this iterator, before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++position;
+            return copy;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a reference to this iterator.
+        auto operator--() -> basic_iterator &
+        {
+            --position;
+            return *this;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a copy of this iterator, before moving.
+        auto operator--(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            --position;
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool { return position == other.position; }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return position != other.position; }
+
+    private:
+        friend class flat_multimap_t;
+        template <typename, typename> friend class basic_iterator;
+
+        /// @brief The map.
+        Owner *owner;
+        /// @brief The position of the entry.
+        std::size_t position;
+    };
+
+    /// @brief Iterator over the entries.
+    using iterator       = basic_iterator<flat_multimap_t, Mapped &>;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = basic_iterator<const flat_multimap_t, const Mapped &>;
+
+    /// @brief Compares the entries by key.
+    struct value_compare {
+        /// @brief Compares two entries.
+        /// @param lhs the first entry.
+        /// @param rhs the second entry.
+        /// @return true if the key of the first is less than the one of the second.
+        template <typename Lhs, typename Rhs> auto operator()(const Lhs &lhs, const Rhs &rhs) const -> bool
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    /// @brief Construct an empty map.
+    flat_multimap_t()
+        : keys()
+        , mapped()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return keys.size(); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return keys.empty(); }
+
+    /// @brief Removes all the entries.
+    void clear()
+    {
+        keys.clear();
+        mapped.clear();
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(flat_multimap_t &other)
+    {
+        keys.swap(other.keys);
+        mapped.swap(other.mapped);
+    }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return value_compare(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return iterator(this, 0); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return const_iterator(this, 0); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return iterator(this, keys.size()); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator { return const_iterator(this, keys.size()); }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        return this->insert_at(detail::search<true>(keys.data(), keys.size(), entry.first), entry);
+    }
+
+    /// @brief Inserts an entry, right before the hint if it keeps the keys sorted.
+    /// @details Inserting sorted entries at the end takes constant time.
+    /// @param hint the suggested position.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator hint, const value_type &entry) -> iterator
+    {
+        std::size_t position = hint.position;
+        if ((position > 0U && entry.first < keys[position - 1U]) ||
+            (position < keys.size() && keys[position] < entry.first)) {
+            position = detail::search<true>(keys.data(), keys.size(), entry.first);
+        }
+        return this->insert_at(position, entry);
+    }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first) {
+            this->insert(static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator { return this->erase(position, std::next(position)); }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        using difference_t = typename std::vector<Key>::difference_type;
+        auto begin         = static_cast<difference_t>(first.position);
+        auto end           = static_cast<difference_t>(last.position);
+        keys.erase(keys.begin() + begin, keys.begin() + end);
+        mapped.erase(mapped.begin() + begin, mapped.begin() + end);
+        return iterator(this, first.position);
+    }
+
+    /// @brief Removes entries whose key is in a sorted range of distinct
+    /// keys, compacting the arrays in a single pass.
+    /// @tparam ForwardIt the type of iterator, over keys.
+    /// @tparam Visitor the type of the callback.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param visit called with the key and the mapped value of each entry with
+    /// one of the keys, returns true if the entry is to be removed.
+    template <typename ForwardIt, typename Visitor> void erase_many(ForwardIt first, ForwardIt last, Visitor visit)
+    {
+        if (first == last) {
+            return;
+        }
+        // Entries before the first key stay where they are.
+        std::size_t kept = detail::search<false>(keys.data(), keys.size(), *first);
+        for (std::size_t position = kept; position < keys.size(); ++position) {
+            while (first != last && *first < keys[position]) {
+                ++first;
+            }
+            if (first == last || keys[position] < *first || !visit(keys[position], mapped[position])) {
+                if (kept != position) {
+                    keys[kept]   = std::move(keys[position]);
+                    mapped[kept] = std::move(mapped[position]);
+                }
+                ++kept;
+            }
+        }
+        using difference_t = typename std::vector<Key>::difference_type;
+        keys.erase(keys.begin() + static_cast<difference_t>(kept), keys.end());
+        mapped.erase(mapped.begin() + static_cast<difference_t>(kept), mapped.end());
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator { return iterator(this, this->find_position(key)); }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator { return const_iterator(this, this->find_position(key)); }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        return detail::search<true>(keys.data(), keys.size(), key) - detail::search<false>(keys.data(), keys.size(), key);
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator
+    {
+        return iterator(this, detail::search<false>(keys.data(), keys.size(), key));
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator
+    {
+        return const_iterator(this, detail::search<false>(keys.data(), keys.size(), key));
+    }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator
+    {
+        return iterator(this, detail::search<true>(keys.data(), keys.size(), key));
+    }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator
+    {
+        return const_iterator(this, detail::search<true>(keys.data(), keys.size(), key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        return std::make_pair(this->lower_bound(key), this->upper_bound(key));
+    }
+
+private:
+    /// @brief Inserts an entry in the given position.
+    /// @param position the position.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert_at(std::size_t position, const value_type &entry) -> iterator
+    {
+        using difference_t = typename std::vector<Key>::difference_type;
+        keys.insert(keys.begin() + static_cast<difference_t>(position), entry.first);
+        mapped.insert(mapped.begin() + static_cast<difference_t>(position), entry.second);
+        return iterator(this, position);
+    }
+
+    /// @brief Returns the position of the first entry with the given key.
+    /// @param key the key.
+    /// @return the position, or the size of the map if not found.
+    auto find_position(const Key &key) const -> std::size_t
+    {
+        std::size_t position = detail::search<false>(keys.data(), keys.size(), key);
+        return (position < keys.size() && !(key < keys[position])) ? position : keys.size();
+    }
+
+    /// @brief The keys, sorted, entries with the same key in insertion order.
+    std::vector<Key> keys;
+    /// @brief The mapped values, in the same order of the keys.
+    std::vector<Mapped> mapped;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which uses a
+/// `flat_multimap_t`.
+/// @details For instance:
+/// @code
+/// ordered_multimap_t<std::uint32_t, std::string, flat_index_t> map;
+/// @endcode
+struct flat_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle> using type = flat_multimap_t<Key, Handle>;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,671 @@
+/// @file frozen_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An immutable, position-independent, layout of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief A string stored inside a frozen map, it references the frozen bytes.
+class frozen_string_t
+{
+public:
+    /// @brief Construct an empty string.
+    frozen_string_t()
+        : pointer(nullptr)
+        , length(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct a string referencing the given characters.
+    /// @param _pointer the first character.
+    /// @param _length the number of characters.
+    frozen_string_t(const char *_pointer, std::size_t _length)
+        : pointer(_pointer)
+        , length(_length)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the characters, they are not null-terminated.
+    /// @return a pointer to the first character.
+    auto data() const -> const char * { return pointer; }
+
+    /// @brief Returns the number of characters.
+    /// @return the number of characters.
+    auto size() const -> std::size_t { return length; }
+
+    /// @brief Returns a copy of the string.
+    /// @return the copy.
+    auto str() const -> std::string { return std::string(pointer, length); }
+
+    /// @brief Returns a copy of the string.
+    /// @return the copy.
+    explicit operator std::string() const { return this->str(); }
+
+    /// @brief Compares the string with the given characters, lexicographically.
+    /// @param other the other characters.
+    /// @param other_length the number of other characters.
+    /// @return a negative value, zero, or a positive value, if this string is
+    /// less than, equal to, or greater than the other one.
+    auto compare(const char *other, std::size_t other_length) const -> int
+    {
+        std::size_t common = std::min(length, other_length);
+        int result         = common == 0 ? 0 : std::memcmp(pointer, other, common);
+        if (result != 0) {
+            return result;
+        }
+        return length < other_length ? -1 : (length > other_length ? 1 : 0);
+    }
+
+    /// @brief Checks if the strings are equal.
+    /// @param lhs the frozen string.
+    /// @param rhs the string.
+    /// @return true if they are equal.
+    friend auto operator==(const frozen_string_t &lhs, const std::string &rhs) -> bool
+    {
+        return lhs.compare(rhs.data(), rhs.size()) == 0;
+    }
+
+    /// @brief Checks if the strings are different.
+    /// @param lhs the frozen string.
+    /// @param rhs the string.
+    /// @return true if they are different.
+    friend auto operator!=(const frozen_string_t &lhs, const std::string &rhs) -> bool { return !(lhs == rhs); }
+
+    /// @brief Checks if the strings are equal.
+    /// @param lhs the frozen string.
+    /// @param rhs the other frozen string.
+    /// @return true if they are equal.
+    friend auto operator==(const frozen_string_t &lhs, const frozen_string_t &rhs) -> bool
+    {
+        return lhs.compare(rhs.data(), rhs.size()) == 0;
+    }
+
+    /// @brief Checks if the strings are different.
+    /// @param lhs the frozen string.
+    /// @param rhs the other frozen string.
+    /// @return true if they are different.
+    friend auto operator!=(const frozen_string_t &lhs, const frozen_string_t &rhs) -> bool { return !(lhs == rhs); }
+
+private:
+    /// @brief The first character.
+    const char *pointer;
+    /// @brief The number of characters.
+    std::size_t length;
+};
+
+/// @brief Describes how values of type `T` are laid out in a frozen map.
+/// @details Specialize this template to freeze your own types, the
+/// specialization must provide:
+///   - `view_t`, the type returned when reading the value back;
+///   - `static auto size(const T &) -> std::size_t`, the number of bytes;
+///   - `static void write(char *, const T &)`, which stores the value;
+///   - `static auto read(const char *) -> view_t`, which reads it back;
+///   - `static auto stored_size(const char *) -> std::size_t`, the number of
+///     bytes of a stored value;
+///   - `static auto compare(const view_t &, const T &) -> int`, used for keys.
+/// @tparam T the type of value.
+/// @tparam Enable used to select specializations with SFINAE.
+template <typename T, typename Enable = void> struct frozen_traits;
+
+/// @brief Trivially copyable types are stored as their bytes.
+/// @tparam T the type of value.
+template <typename T> struct frozen_traits<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+    /// @brief The value is read back by copy.
+    using view_t = T;
+
+    /// @brief Returns the number of bytes used to store the value.
+    /// @return the number of bytes.
+    static auto size(const T &) -> std::size_t { return sizeof(T); }
+
+    /// @brief Stores the value.
+    /// @param destination where the value is stored.
+    /// @param value the value.
+    static void write(char *destination, const T &value) { std::memcpy(destination, &value, sizeof(T)); }
+
+    /// @brief Reads the value back.
+    /// @param source where the value is stored.
+    /// @return the value.
+    static auto read(const char *source) -> view_t
+    {
+        T value;
+        std::memcpy(&value, source, sizeof(T));
+        return value;
+    }
+
+    /// @brief Returns the number of bytes of a stored value.
+    /// @return the number of bytes.
+    static auto stored_size(const char *) -> std::size_t { return sizeof(T); }
+
+    /// @brief Compares a stored value with a value.
+    /// @param lhs the stored value.
+    /// @param rhs the value.
+    /// @return a negative value, zero, or a positive value.
+    static auto compare(const view_t &lhs, const T &rhs) -> int { return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0); }
+};
+
+/// @brief Strings are stored as their length followed by their characters.
+template <> struct frozen_traits<std::string> {
+    /// @brief The value is read back as a reference to the stored characters.
+    using view_t = frozen_string_t;
+
+    /// @brief Returns the number of bytes used to store the value.
+    /// @param value the value.
+    /// @return the number of bytes.
+    static auto size(const std::string &value) -> std::size_t { return sizeof(std::uint64_t) + value.size(); }
+
+    /// @brief Stores the value.
+    /// @param destination where the value is stored.
+    /// @param value the value.
+    static void write(char *destination, const std::string &value)
+    {
+        std::uint64_t length = value.size();
+        std::memcpy(destination, &length, sizeof(length));
+        std::memcpy(destination + sizeof(length), value.data(), value.size());
+    }
+
+    /// @brief Reads the value back.
+    /// @param source where the value is stored.
+    /// @return the value.
+    static auto read(const char *source) -> view_t
+    {
+        std::uint64_t length = 0;
+        std::memcpy(&length, source, sizeof(length));
+        return frozen_string_t(source + sizeof(length), static_cast<std::size_t>(length));
+    }
+
+    /// @brief Returns the number of bytes of a stored value.
+    /// @param source where the value is stored.
+    /// @return the number of bytes.
+    static auto stored_size(const char *source) -> std::size_t { return sizeof(std::uint64_t) + read(source).size(); }
+
+    /// @brief Compares a stored value with a value.
+    /// @param lhs the stored value.
+    /// @param rhs the value.
+    /// @return a negative value, zero, or a positive value.
+    static auto compare(const view_t &lhs, const std::string &rhs) -> int { return lhs.compare(rhs.data(), rhs.size()); }
+};
+
+namespace detail
+{
+
+/// @brief The header of a frozen map.
+struct frozen_header_t {
+    /// @brief Identifies the format, the last byte is its version.
+    char magic[8];
+    /// @brief Detects blocks written with a different byte order.
+    std::uint64_t probe;
+    /// @brief The number of entries.
+    std::uint64_t count;
+    /// @brief The offset of the array with the offsets of the entries, in
+    /// insertion order.
+    std::uint64_t order;
+    /// @brief The offset of the array with the positions of the entries,
+    /// sorted by key.
+    std::uint64_t index;
+    /// @brief The size of the whole block.
+    std::uint64_t size;
+};
+
+/// @brief Rounds the offset up to a multiple of eight.
+/// @param offset the offset.
+/// @return the aligned offset.
+inline auto frozen_align(std::size_t offset) -> std::size_t { return (offset + 7U) & ~static_cast<std::size_t>(7U); }
+
+/// @brief Reads an unsigned integer from a possibly unaligned location.
+/// @param source the location.
+/// @return the integer.
+inline auto frozen_load(const char *source) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    std::memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+} // namespace detail
+
+template <typename Key, typename Value> class frozen_ordered_multimap_t;
+
+/// @brief Emits the immutable representation of a map.
+/// @details The block contains a header, the entries in insertion order, the
+/// offsets of the entries, and their positions sorted by key. It contains no
+/// pointers, hence it can be written to a file and mapped back at any address.
+/// Numbers use the byte order of the machine. The index of the map does not
+/// matter, the block is searched by key order.
+/// @param map the map to freeze.
+/// @return the block.
+template <typename Key, typename Value, typename Index>
+auto freeze(const ordered_multimap_t<Key, Value, Index> &map) -> std::vector<char>
+{
+    using frozen_t     = frozen_ordered_multimap_t<Key, Value>;
+    using key_traits   = frozen_traits<Key>;
+    using value_traits = frozen_traits<Value>;
+
+    const std::size_t count = map.size();
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(count);
+    std::size_t offset = detail::frozen_align(sizeof(detail::frozen_header_t));
+    for (const auto &entry : map) {
+        offsets.push_back(offset);
+        offset = detail::frozen_align(offset + key_traits::size(entry.first));
+        offset = detail::frozen_align(offset + value_traits::size(entry.second));
+    }
+
+    detail::frozen_header_t header = {};
+    std::memcpy(header.magic, frozen_t::magic, sizeof(header.magic));
+    header.probe = frozen_t::probe;
+    header.count = count;
+    header.order = offset;
+    header.index = offset + count * sizeof(std::uint64_t);
+    header.size  = header.index + count * sizeof(std::uint64_t);
+
+    std::vector<char> block(static_cast<std::size_t>(header.size), 0);
+    std::memcpy(block.data(), &header, sizeof(header));
+
+    std::vector<const Key *> keys;
+    keys.reserve(count);
+    std::size_t position = 0;
+    for (const auto &entry : map) {
+        char *destination = block.data() + offsets[position];
+        key_traits::write(destination, entry.first);
+        destination = block.data() + detail::frozen_align(offsets[position] + key_traits::size(entry.first));
+        value_traits::write(destination, entry.second);
+        keys.push_back(&entry.first);
+        ++position;
+    }
+    if (count > 0) {
+        std::memcpy(block.data() + header.order, offsets.data(), count * sizeof(std::uint64_t));
+    }
+
+    std::vector<std::uint64_t> sorted(count);
+    std::iota(sorted.begin(), sorted.end(), 0U);
+    std::stable_sort(sorted.begin(), sorted.end(), [&keys](std::uint64_t lhs, std::uint64_t rhs) {
+        return *keys[static_cast<std::size_t>(lhs)] < *keys[static_cast<std::size_t>(rhs)];
+    });
+    if (count > 0) {
+        std::memcpy(block.data() + header.index, sorted.data(), count * sizeof(std::uint64_t));
+    }
+    return block;
+}
+
+/// @brief Writes the immutable representation of a map to a stream.
+/// @param map the map to freeze.
+/// @param os the output stream.
+/// @return true if the stream is still good after writing.
+template <typename Key, typename Value, typename Index>
+auto freeze(const ordered_multimap_t<Key, Value, Index> &map, std::ostream &os) -> bool
+{
+    std::vector<char> block = freeze(map);
+    os.write(block.data(), static_cast<std::streamsize>(block.size()));
+    return static_cast<bool>(os);
+}
+
+/// @brief A read-only view over a block produced by `freeze`.
+/// @details Queries read the block directly, nothing is decoded upfront, hence
+/// attaching a view to a memory mapped file is immediate. The block must stay
+/// alive, and unchanged, while the view is in use.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> class frozen_ordered_multimap_t
+{
+public:
+    /// @brief How keys are stored.
+    using key_traits   = frozen_traits<Key>;
+    /// @brief How values are stored.
+    using value_traits = frozen_traits<Value>;
+    /// @brief The type returned when reading a key.
+    using key_view_t   = typename key_traits::view_t;
+    /// @brief The type returned when reading a value.
+    using value_view_t = typename value_traits::view_t;
+    /// @brief The type of the entries.
+    using value_type   = std::pair<key_view_t, value_view_t>;
+
+    /// @brief Iterates over the entries, either in insertion order or by key.
+    class const_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::bidirectional_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename frozen_ordered_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief Entries are returned by value.
+        using reference         = value_type;
+
+        /// @brief Holds an entry, so that `operator->` can return its address.
+        struct pointer {
+            /// @brief The entry.
+            value_type entry;
+            /// @brief Accesses the entry.
+            /// @return the address of the entry.
+            auto operator->() const -> const value_type * { return &entry; }
+        };
+
+        /// @brief Construct an iterator that points nowhere.
+        const_iterator()
+            : owner(nullptr)
+            , indirection(nullptr)
+            , position(0)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _owner the view.
+        /// @param _indirection the array of positions, null to iterate in
+        /// insertion order.
+        /// @param _position the position inside the sequence.
+        const_iterator(const frozen_ordered_multimap_t *_owner, const char *_indirection, std::size_t _position)
+            : owner(_owner)
+            , indirection(_indirection)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the position of the entry in insertion order.
+        /// @return the position.
+        auto index() const -> std::size_t
+        {
+            if (indirection == nullptr) {
+                return position;
+            }
+            return static_cast<std::size_t>(detail::frozen_load(indirection + position * sizeof(std::uint64_t)));
+        }
+
+        /// @brief Returns the key of the entry.
+        /// @return the key.
+        auto key() const -> key_view_t { return key_traits::read(owner->entry(this->index())); }
+
+        /// @brief Returns the value of the entry.
+        /// @return the value.
+        auto value() const -> value_view_t { return owner->value_of(this->index()); }
+
+        /// @brief Returns the entry.
+        /// @return the entry.
+        auto operator*() const -> reference { return value_type(this->key(), this->value()); }
+
+        /// @brief Accesses the entry.
+        /// @return a proxy holding the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> const_iterator &
+        {
+            ++position;
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return the iterator before moving.
+        auto operator++(int) -> const_iterator
+        {
+            const_iterator previous = *this;
+            ++position;
+            return previous;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a reference to this iterator.
+        auto operator--() -> const_iterator &
+        {
+            --position;
+            return *this;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return the iterator before moving.
+        auto operator--(int) -> const_iterator
+        {
+            const_iterator previous = *this;
+            --position;
+            return previous;
+        }
+
+        /// @brief Checks if the iterators are equal.
+        /// @param other the other iterator.
+        /// @return true if they are equal.
+        auto operator==(const const_iterator &other) const -> bool
+        {
+            return owner == other.owner && indirection == other.indirection && position == other.position;
+        }
+
+        /// @brief Checks if the iterators are different.
+        /// @param other the other iterator.
+        /// @return true if they are different.
+        auto operator!=(const const_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        /// @brief The view.
+        const frozen_ordered_multimap_t *owner;
+        /// @brief The array of positions, null when iterating in insertion order.
+        const char *indirection;
+        /// @brief The position inside the sequence.
+        std::size_t position;
+    };
+
+    /// @brief Construct an empty view.
+    frozen_ordered_multimap_t()
+        : base(nullptr)
+        , entries(0)
+        , order(nullptr)
+        , index(nullptr)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct a view over the given block.
+    /// @param data the first byte of the block.
+    /// @param size the size of the block.
+    frozen_ordered_multimap_t(const void *data, std::size_t size)
+        : frozen_ordered_multimap_t()
+    {
+        this->attach(data, size);
+    }
+
+    /// @brief Attaches the view to the given block.
+    /// @details Only the header and the bounds of the arrays are validated,
+    /// the block must come from `freeze`, with the same key and value types.
+    /// @param data the first byte of the block.
+    /// @param size the size of the block.
+    /// @return true if the block is valid, otherwise the view is left empty.
+    auto attach(const void *data, std::size_t size) -> bool
+    {
+        *this = frozen_ordered_multimap_t();
+        detail::frozen_header_t header = {};
+        if (data == nullptr || size < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        const std::uint64_t array = header.count * sizeof(std::uint64_t);
+        if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 ||
+            header.probe != probe || header.size > size || header.count > header.size ||
+            header.order > header.size || header.index > header.size || array > header.size - header.order ||
+            array > header.size - header.index) {
+            return false;
+        }
+        base  = static_cast<const char *>(data);
+        entries = static_cast<std::size_t>(header.count);
+        order = base + header.order;
+        index = base + header.index;
+        return true;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return entries; }
+
+    /// @brief Checks if the view has no entries.
+    /// @return true if there are no entries.
+    auto empty() const -> bool { return entries == 0; }
+
+    /// @brief Returns an iterator to the first entry, in insertion order.
+    /// @return the iterator.
+    auto begin() const -> const_iterator { return const_iterator(this, nullptr, 0); }
+
+    /// @brief Returns an iterator past the last entry, in insertion order.
+    /// @return the iterator.
+    auto end() const -> const_iterator { return const_iterator(this, nullptr, entries); }
+
+    /// @brief Returns an iterator to the entry in the given position.
+    /// @param position the position, in insertion order.
+    /// @return the iterator, or `end()` if the position is out of range.
+    auto at(std::size_t position) const -> const_iterator
+    {
+        return const_iterator(this, nullptr, std::min(position, entries));
+    }
+
+    /// @brief Returns the first entry, in insertion order, with the given key.
+    /// @param key the key to search for.
+    /// @return an iterator in insertion order, or `end()` if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        std::size_t first = this->lower_bound(key);
+        if (first == entries || key_traits::compare(this->key_at(first), key) != 0) {
+            return this->end();
+        }
+        return const_iterator(this, nullptr, const_iterator(this, index, first).index());
+    }
+
+    /// @brief Checks whether at least one entry has the given key.
+    /// @param key the key to check.
+    /// @return true if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return this->find(key) != this->end(); }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        return this->upper_bound(key) - this->lower_bound(key);
+    }
+
+    /// @brief Returns the entries with the given key, in insertion order.
+    /// @param key the key to search for.
+    /// @return a pair of iterators [begin, end), which follow the key order.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        return std::make_pair(
+            const_iterator(this, index, this->lower_bound(key)), const_iterator(this, index, this->upper_bound(key)));
+    }
+
+    /// @brief Thaws the view into a regular, mutable, map.
+    /// @return the new map.
+    template <typename Map = ordered_multimap_t<Key, Value>> auto thaw() const -> Map
+    {
+        Map map;
+        for (const_iterator it = this->begin(); it != this->end(); ++it) {
+            map.insert(Key(it.key()), Value(it.value()));
+        }
+        return map;
+    }
+
+private:
+    template <typename K, typename V, typename I>
+    friend auto freeze(const ordered_multimap_t<K, V, I> &map) -> std::vector<char>;
+
+    /// @brief Identifies the format.
+    static constexpr char magic[8] = {'O', 'M', 'M', 'F', 'R', 'Z', 0, 1};
+    /// @brief A known value, to detect blocks written with another byte order.
+    static constexpr std::uint64_t probe = 0x0102030405060708ULL;
+
+    /// @brief Returns the first byte of an entry.
+    /// @param position the position of the entry, in insertion order.
+    /// @return a pointer to the entry.
+    auto entry(std::size_t position) const -> const char *
+    {
+        return base + detail::frozen_load(order + position * sizeof(std::uint64_t));
+    }
+
+    /// @brief Returns the value of an entry.
+    /// @param position the position of the entry, in insertion order.
+    /// @return the value.
+    auto value_of(std::size_t position) const -> value_view_t
+    {
+        const char *key = this->entry(position);
+        return value_traits::read(
+            base + detail::frozen_align(static_cast<std::size_t>(key - base) + key_traits::stored_size(key)));
+    }
+
+    /// @brief Returns the key of an entry.
+    /// @param sorted the position of the entry, in key order.
+    /// @return the key.
+    auto key_at(std::size_t sorted) const -> key_view_t
+    {
+        return key_traits::read(this->entry(const_iterator(this, index, sorted).index()));
+    }
+
+    /// @brief Finds the first entry, in key order, whose key is not less than
+    /// the given one.
+    /// @param key the key.
+    /// @return the position in key order.
+    auto lower_bound(const Key &key) const -> std::size_t
+    {
+        std::size_t first = 0;
+        std::size_t last  = entries;
+        while (first < last) {
+            std::size_t middle = first + (last - first) / 2U;
+            if (key_traits::compare(this->key_at(middle), key) < 0) {
+                first = middle + 1U;
+            } else {
+                last = middle;
+            }
+        }
+        return first;
+    }
+
+    /// @brief Finds the first entry, in key order, whose key is greater than
+    /// the given one.
+    /// @param key the key.
+    /// @return the position in key order.
+    auto upper_bound(const Key &key) const -> std::size_t
+    {
+        std::size_t first = 0;
+        std::size_t last  = entries;
+        while (first < last) {
+            std::size_t middle = first + (last - first) / 2U;
+            if (key_traits::compare(this->key_at(middle), key) <= 0) {
+                first = middle + 1U;
+            } else {
+                last = middle;
+            }
+        }
+        return first;
+    }
+
+    /// @brief The first byte of the block.
+    const char *base;
+    /// @brief The number of entries.
+    std::size_t entries;
+    /// @brief The offsets of the entries, in insertion order.
+    const char *order;
+    /// @brief The positions of the entries, in key order.
+    const char *index;
+};
+
+template <typename Key, typename Value> constexpr char frozen_ordered_multimap_t<Key, Value>::magic[8];
+template <typename Key, typename Value> constexpr std::uint64_t frozen_ordered_multimap_t<Key, Value>::probe;
+
+} // namespace ordered_multimap
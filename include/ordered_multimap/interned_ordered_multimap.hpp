@@ -0,0 +1,244 @@
+/// @file interned_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Ordered maps whose string keys are interned in a shared pool.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief A thread-safe pool of strings, each one stored once, and identified
+/// by a 32-bit integer.
+/// @details Identifiers are assigned in interning order, starting from zero,
+/// and strings are never removed: references returned by `str` remain valid
+/// for the lifetime of the pool.
+class intern_pool_t
+{
+public:
+    /// @brief The identifier of no string.
+    enum : std::uint32_t {
+        none = 0xFFFFFFFFU, ///< Returned by `find` for strings never interned.
+    };
+
+    /// @brief Construct an empty pool.
+    intern_pool_t()
+        : mutex()
+        , ids()
+        , names()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The pool hands out references to its strings, it cannot be copied.
+    intern_pool_t(const intern_pool_t &) = delete;
+
+    /// @brief The pool hands out references to its strings, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const intern_pool_t &) -> intern_pool_t & = delete;
+
+    /// @brief Destructor.
+    ~intern_pool_t() = default;
+
+    /// @brief Returns the identifier of the string, adding it if needed.
+    /// @param name the string.
+    /// @return the identifier.
+    auto intern(const std::string &name) -> std::uint32_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(name);
+        if (it == ids.end()) {
+            it = ids.emplace(name, static_cast<std::uint32_t>(names.size())).first;
+            // The nodes of the table never move, the string is stored once.
+            names.push_back(&it->first);
+        }
+        return it->second;
+    }
+
+    /// @brief Returns the identifier of the string, without adding it.
+    /// @param name the string.
+    /// @return the identifier, or `none` if the string was never interned.
+    auto find(const std::string &name) const -> std::uint32_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(name);
+        return it == ids.end() ? static_cast<std::uint32_t>(none) : it->second;
+    }
+
+    /// @brief Returns the string with the given identifier.
+    /// @param id the identifier.
+    /// @return a reference to the string, empty if the identifier is unknown.
+    auto str(std::uint32_t id) const -> const std::string &
+    {
+        static const std::string empty;
+        std::lock_guard<std::mutex> lock(mutex);
+        return id < names.size() ? *names[id] : empty;
+    }
+
+    /// @brief Returns the number of strings in the pool.
+    /// @return the number of strings.
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return names.size();
+    }
+
+    /// @brief Returns the pool shared by all the `symbol_t`.
+    /// @return a reference to the pool.
+    static auto global() -> intern_pool_t &
+    {
+        static intern_pool_t pool;
+        return pool;
+    }
+
+private:
+    /// @brief Protects the pool.
+    mutable std::mutex mutex;
+    /// @brief The identifiers of the strings.
+    std::unordered_map<std::string, std::uint32_t> ids;
+    /// @brief The strings, by identifier, owned by `ids`.
+    std::vector<const std::string *> names;
+};
+
+/// @brief A string interned in the global pool, held as a 32-bit identifier.
+/// @details Copies, comparisons, and hashes are those of an integer. Symbols
+/// are ordered by interning order, not alphabetically: compare their `str()`
+/// for the latter. Constructing a symbol interns its string for the lifetime
+/// of the program, hence there is no implicit conversion from strings, and
+/// lookups should use `find`, so that probing unknown keys does not grow the
+/// pool.
+class symbol_t
+{
+public:
+    /// @brief Construct the empty symbol, which refers to no string.
+    symbol_t()
+        : id(intern_pool_t::none)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct the symbol of the given string, interning it.
+    /// @param name the string.
+    explicit symbol_t(const std::string &name)
+        : id(intern_pool_t::global().intern(name))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct the symbol of the given string, interning it.
+    /// @param name the string.
+    explicit symbol_t(const char *name)
+        : id(intern_pool_t::global().intern(name))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the symbol of the given string, without interning it.
+    /// @details Lookups should use this function, so that keys which are not
+    /// in any map do not grow the pool.
+    /// @param name the string.
+    /// @return the symbol, empty if the string was never interned.
+    static auto find(const std::string &name) -> symbol_t { return from_id(intern_pool_t::global().find(name)); }
+
+    /// @brief Returns the symbol with the given identifier.
+    /// @param identifier the identifier.
+    /// @return the symbol.
+    static auto from_id(std::uint32_t identifier) -> symbol_t
+    {
+        symbol_t symbol;
+        symbol.id = identifier;
+        return symbol;
+    }
+
+    /// @brief Returns the identifier.
+    /// @return the identifier.
+    auto get_id() const -> std::uint32_t { return id; }
+
+    /// @brief Checks if the symbol refers to a string.
+    /// @return true if the symbol is not empty.
+    auto valid() const -> bool { return id != intern_pool_t::none; }
+
+    /// @brief Returns the string.
+    /// @return a reference to the string, empty for the empty symbol.
+    auto str() const -> const std::string & { return intern_pool_t::global().str(id); }
+
+    /// @brief Compares two symbols.
+    /// @param other the other symbol.
+    /// @return true if they refer to the same string.
+    auto operator==(const symbol_t &other) const -> bool { return id == other.id; }
+
+    /// @brief Compares two symbols.
+    /// @param other the other symbol.
+    /// @return true if they refer to different strings.
+    auto operator!=(const symbol_t &other) const -> bool { return id != other.id; }
+
+    /// @brief Orders two symbols, by interning order.
+    /// @param other the other symbol.
+    /// @return true if this symbol was interned first.
+    auto operator<(const symbol_t &other) const -> bool { return id < other.id; }
+
+private:
+    /// @brief The identifier of the string in the global pool.
+    std::uint32_t id;
+};
+
+/// @brief Codec for symbols, stored as their string, and interned on read.
+template <> struct codec<symbol_t> {
+    /// @brief Writes the value.
+    /// @param os the output stream.
+    /// @param value the value.
+    static void write(std::ostream &os, const symbol_t &value) { codec<std::string>::write(os, value.str()); }
+
+    /// @brief Reads the value.
+    /// @param is the input stream.
+    /// @return the value.
+    static auto read(std::istream &is) -> symbol_t
+    {
+        std::string name = codec<std::string>::read(is);
+        return is ? symbol_t(name) : symbol_t();
+    }
+};
+
+/// @brief An ordered map whose keys are symbols: each key string is stored
+/// once, in the global pool, and the list and the index hold 4-byte
+/// identifiers.
+/// @details For instance:
+/// @code
+/// interned_ordered_multimap_t<int> config;
+/// config.insert(symbol_t("service.http.port"), 80);
+/// config.find(symbol_t::find("service.http.port"));
+/// @endcode
+/// @tparam Value the value stored inside the map.
+/// @tparam Index the policy providing the index, see `multimap_index_t`.
+template <typename Value, typename Index = multimap_index_t>
+using interned_ordered_multimap_t = ordered_multimap_t<symbol_t, Value, Index>;
+
+} // namespace ordered_multimap
+
+namespace std
+{
+
+/// @brief Hashes symbols by identifier.
+template <> struct hash<ordered_multimap::symbol_t> {
+    /// @brief Hashes the symbol.
+    /// @param symbol the symbol.
+    /// @return the hash.
+    auto operator()(const ordered_multimap::symbol_t &symbol) const -> std::size_t
+    {
+        return std::hash<std::uint32_t>()(symbol.get_id());
+    }
+};
+
+} // namespace std
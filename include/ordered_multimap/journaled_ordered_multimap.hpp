@@ -0,0 +1,616 @@
+/// @file journaled_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map whose changes are recorded in a write-ahead journal.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/durable_file.hpp"
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief Computes the 32-bit FNV-1a hash of some bytes.
+/// @param data the bytes.
+/// @param size the number of bytes.
+/// @return the hash.
+inline auto fnv1a(const char *data, std::size_t size) -> std::uint32_t
+{
+    std::uint32_t hash = 2166136261U;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+} // namespace detail
+
+/// @brief An `ordered_multimap_t` that survives crashes.
+/// @details Every change is applied to the map and appended, as a compact
+/// binary record, to a journal. Records are accumulated in memory and written,
+/// and synced, in groups, either when `commit()` is called or when the group
+/// reaches the configured size: changes are durable once committed. On open
+/// the last snapshot is loaded and the journal replayed on top of it; a torn
+/// record at the end of the journal, left by a crash, is discarded.
+/// `compact()` writes a new snapshot and starts an empty journal.
+///
+/// If writing a group fails, the group is kept in memory, the journal is cut
+/// back to the end of the last committed one, and the map fails: changes are
+/// refused, and mutators return the end of the list, or nothing removed,
+/// until `commit()` or `compact()` succeeds, see `good()`. Changes are also
+/// refused while the journal is closed.
+///
+/// Two files are used, `<prefix>.snapshot` and `<prefix>.journal`. Both
+/// carry a generation number, so that a journal older than the snapshot, left
+/// by a crash during compaction, is ignored. A journal newer than the
+/// snapshot means that the snapshot it was started from is lost: `open()`
+/// fails and leaves both files untouched, rather than dropping the records.
+/// @tparam Key the type of the key, it needs a `codec<Key>`.
+/// @tparam Value the type of the value, it needs a `codec<Value>`.
+template <typename Key, typename Value> class journaled_ordered_multimap_t
+{
+public:
+    /// @brief The type of the journaled map.
+    using map_t           = ordered_multimap_t<Key, Value>;
+    /// @brief Iterator for the list, for the user.
+    using iterator        = typename map_t::iterator;
+    /// @brief Constant iterator for the list, for the user.
+    using const_iterator  = typename map_t::const_iterator;
+    /// @brief The type of a compatible sort function.
+    using sort_function_t = typename map_t::sort_function_t;
+
+    /// @brief Construct a closed journaled map.
+    journaled_ordered_multimap_t()
+        : table()
+        , prefix()
+        , journal(nullptr)
+        , pending()
+        , pending_records(0)
+        , group_size(64U)
+        , generation(0)
+        , committed(0)
+        , failed(false)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The journal is owned by a single map, it cannot be copied.
+    journaled_ordered_multimap_t(const journaled_ordered_multimap_t &) = delete;
+
+    /// @brief The journal is owned by a single map, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const journaled_ordered_multimap_t &) -> journaled_ordered_multimap_t & = delete;
+
+    /// @brief Commits the pending records, and closes the journal.
+    ~journaled_ordered_multimap_t() { this->close(); }
+
+    /// @brief Opens the files with the given prefix, and recovers their state.
+    /// @param _prefix the path prefix of the snapshot and journal files.
+    /// @return true on success, false otherwise.
+    auto open(const std::string &_prefix) -> bool
+    {
+        this->close();
+        prefix = _prefix;
+        table.clear();
+        generation = 0;
+        failed     = false;
+
+        std::string content;
+        if (detail::read_file(this->snapshot_path(), content)) {
+            std::istringstream is(content);
+            generation = read_varint(is);
+            if (!is || !table.load(is)) {
+                return false;
+            }
+        }
+
+        replay_t result = replay_clean;
+        if (detail::read_file(this->journal_path(), content)) {
+            result = this->replay(content);
+        } else {
+            content.clear();
+        }
+        if (result == replay_ahead) {
+            return false;
+        }
+        if (result != replay_clean) {
+            // Drop the torn tail, or the stale journal, by folding everything
+            // into a snapshot.
+            return this->compact();
+        }
+        journal = std::fopen(this->journal_path().c_str(), "ab");
+        if (journal == nullptr) {
+            return false;
+        }
+        committed = content.size();
+        if (content.empty()) {
+            // New journal, stamp it with the generation of the snapshot.
+            std::ostringstream header;
+            write_varint(header, generation);
+            pending = header.str();
+            return this->commit() && detail::sync_directory(this->journal_path());
+        }
+        return true;
+    }
+
+    /// @brief Commits the pending records, and closes the journal.
+    /// @return true if the pending records were committed.
+    auto close() -> bool
+    {
+        bool success = true;
+        if (journal != nullptr) {
+            success = this->commit();
+            success = std::fclose(journal) == 0 && success;
+            journal = nullptr;
+        }
+        pending.clear();
+        pending_records = 0;
+        return success;
+    }
+
+    /// @brief Checks if the journal is open.
+    /// @return true if the journal is open.
+    auto is_open() const -> bool { return journal != nullptr; }
+
+    /// @brief Checks if the map accepts changes.
+    /// @return true if the journal is open, and the last commit succeeded.
+    auto good() const -> bool { return journal != nullptr && !failed; }
+
+    /// @brief Sets how many records are grouped before being written and
+    /// synced automatically.
+    /// @param records the number of records, one makes every change durable
+    /// immediately, zero disables automatic commits.
+    void set_group_size(std::size_t records) { group_size = records; }
+
+    /// @brief Writes and syncs the pending records.
+    /// @details On failure, the records stay pending, the journal is cut back
+    /// to the last committed record, and the map refuses changes until a
+    /// later call succeeds.
+    /// @return true on success.
+    auto commit() -> bool
+    {
+        if (journal == nullptr) {
+            return false;
+        }
+        if (pending.empty()) {
+            return true;
+        }
+        bool success = std::fwrite(pending.data(), 1U, pending.size(), journal) == pending.size();
+        success      = success && std::fflush(journal) == 0 && detail::sync_file(journal);
+        if (!success) {
+            failed = true;
+            this->rewind();
+            return false;
+        }
+        committed += pending.size();
+        pending.clear();
+        pending_records = 0;
+        failed          = false;
+        return true;
+    }
+
+    /// @brief Writes a new snapshot of the map, and starts an empty journal.
+    /// @details The snapshot is written to a temporary file, synced, and then
+    /// renamed over the previous one. It holds the pending records too, hence
+    /// it also recovers a map which failed to commit them.
+    /// @return true on success.
+    auto compact() -> bool
+    {
+        if (journal != nullptr) {
+            this->commit();
+        }
+        if (journal != nullptr) {
+            std::fclose(journal);
+            journal = nullptr;
+        }
+        std::ostringstream os;
+        write_varint(os, generation + 1U);
+        table.save(os);
+        if (!detail::replace_file(this->snapshot_path(), os.str())) {
+            return false;
+        }
+        ++generation;
+        committed       = 0;
+        failed          = false;
+        pending_records = 0;
+        journal         = std::fopen(this->journal_path().c_str(), "wb");
+        if (journal == nullptr) {
+            pending.clear();
+            return false;
+        }
+        std::ostringstream header;
+        write_varint(header, generation);
+        pending = header.str();
+        return this->commit() && detail::sync_directory(this->journal_path());
+    }
+
+    /// @brief Returns the journaled map, for reading.
+    /// @return a const reference to the map.
+    auto map() const -> const map_t & { return table; }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return table.size(); }
+
+    /// @brief Returns a const iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() const -> const_iterator { return table.begin(); }
+
+    /// @brief Returns a const iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() const -> const_iterator { return table.end(); }
+
+    /// @brief Returns an iterator to the element associated with the given key.
+    /// @details Changes made through the iterator are not recorded, use it to
+    /// read or to `erase` the element, and `update` to change its value.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) -> iterator { return table.find(key); }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    auto count(const Key &key) const -> std::size_t { return table.count(key); }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return table.has(key); }
+
+    /// @brief Inserts the `<key,value>` pair, and records it.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return the iterator to the newly inserted element in the map, or the
+    /// end if the map refuses changes.
+    auto insert(const Key &key, const Value &value) -> iterator
+    {
+        if (!this->good()) {
+            return table.end();
+        }
+        iterator it = table.insert(key, value);
+        this->record(record_insert, key, value);
+        return it;
+    }
+
+    /// @brief Constructs a value in-place at the end of the map, and records
+    /// the resulting value.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    /// @return An iterator to the newly inserted element, or the end if the
+    /// map refuses changes.
+    template <typename... Args> auto emplace(const Key &key, Args &&...args) -> iterator
+    {
+        if (!this->good()) {
+            return table.end();
+        }
+        iterator it = table.emplace(key, std::forward<Args>(args)...);
+        this->record(record_insert, key, it->second);
+        return it;
+    }
+
+    /// @brief Updates all values associated with the given key, and records it.
+    /// @param key The key to update.
+    /// @param value The new value to assign.
+    /// @return An iterator to the first updated or newly inserted element,
+    /// or the end if the map refuses changes.
+    auto update(const Key &key, const Value &value) -> iterator
+    {
+        if (!this->good()) {
+            return table.end();
+        }
+        iterator it = table.update(key, value);
+        this->record(record_update, key, value);
+        return it;
+    }
+
+    /// @brief Erases all the elements with the given key, and records it.
+    /// @param key the key of the elements to remove.
+    /// @return an iterator to the element after the first one removed, the
+    /// end if the map refuses changes.
+    auto erase(const Key &key) -> iterator
+    {
+        if (!this->good()) {
+            return table.end();
+        }
+        iterator it = table.erase(key);
+        std::ostringstream payload;
+        codec<Key>::write(payload, key);
+        this->append(record_erase_key, payload.str());
+        return it;
+    }
+
+    /// @brief Erases the element, and records its position.
+    /// @details Finding the position takes linear time.
+    /// @param it the iterator of the element to remove.
+    /// @return an iterator to the element after the one removed, the end if
+    /// the map refuses changes.
+    auto erase(iterator it) -> iterator
+    {
+        if (!this->good()) {
+            return table.end();
+        }
+        std::ostringstream payload;
+        write_varint(payload, table.index_of(it));
+        iterator next = table.erase(it);
+        this->append(record_erase_position, payload.str());
+        return next;
+    }
+
+    /// @brief Erases the first element matching both key and value, and
+    /// records it.
+    /// @param key The key to search for.
+    /// @param value The value to match against.
+    /// @return The number of elements removed (0 or 1), zero if the map
+    /// refuses changes.
+    auto erase(const Key &key, const Value &value) -> std::size_t
+    {
+        if (!this->good()) {
+            return 0;
+        }
+        std::size_t removed = table.erase(key, value);
+        if (removed != 0) {
+            this->record(record_erase_key_value, key, value);
+        }
+        return removed;
+    }
+
+    /// @brief Removes all the elements, and records it.
+    /// @return false if the map refuses changes.
+    auto clear() -> bool
+    {
+        if (!this->good()) {
+            return false;
+        }
+        table.clear();
+        this->append(record_clear, std::string());
+        return true;
+    }
+
+    /// @brief Sorts the map, and records the resulting permutation.
+    /// @details The comparison function cannot be stored, the new order of
+    /// the elements is recorded instead, as their former positions.
+    /// @param fun the sorting function.
+    /// @return false if the map refuses changes.
+    auto sort(const sort_function_t &fun) -> bool
+    {
+        if (!this->good()) {
+            return false;
+        }
+        std::unordered_map<const void *, std::size_t> positions;
+        std::size_t position = 0;
+        for (const auto &entry : table) {
+            positions[&entry] = position++;
+        }
+        table.sort(fun);
+        std::ostringstream payload;
+        write_varint(payload, table.size());
+        for (const auto &entry : table) {
+            write_varint(payload, positions[&entry]);
+        }
+        this->append(record_sort, payload.str());
+        return true;
+    }
+
+private:
+    /// @brief The kinds of records.
+    enum record_t : unsigned char {
+        record_insert          = 1U, ///< A key and a value were inserted.
+        record_update          = 2U, ///< All the values of a key were updated.
+        record_erase_key       = 3U, ///< All the entries of a key were erased.
+        record_erase_position  = 4U, ///< The entry at a position was erased.
+        record_erase_key_value = 5U, ///< An entry matching key and value was erased.
+        record_clear           = 6U, ///< All the entries were erased.
+        record_sort            = 7U, ///< The entries were reordered.
+    };
+
+    /// @brief The outcomes of replaying a journal.
+    enum replay_t : unsigned char {
+        replay_clean, ///< Every record was applied.
+        replay_torn,  ///< A torn or corrupted record was found.
+        replay_stale, ///< The journal is older than the snapshot, it was skipped.
+        replay_ahead, ///< The journal is newer than the snapshot, it was skipped.
+    };
+
+    /// @brief Returns the path of the snapshot.
+    /// @return the path.
+    auto snapshot_path() const -> std::string { return prefix + ".snapshot"; }
+
+    /// @brief Returns the path of the journal.
+    /// @return the path.
+    auto journal_path() const -> std::string { return prefix + ".journal"; }
+
+    /// @brief Records a change involving a key and a value.
+    /// @param type the kind of record.
+    /// @param key the key.
+    /// @param value the value.
+    void record(record_t type, const Key &key, const Value &value)
+    {
+        std::ostringstream payload;
+        codec<Key>::write(payload, key);
+        codec<Value>::write(payload, value);
+        this->append(type, payload.str());
+    }
+
+    /// @brief Appends a record to the pending group.
+    /// @details A record is made of its kind, the size of the payload, the
+    /// payload, and a checksum of kind and payload. Mutators check `good()`
+    /// before changing the map, hence the journal is open.
+    /// @param type the kind of record.
+    /// @param payload the encoded arguments of the change.
+    void append(record_t type, const std::string &payload)
+    {
+        std::string body(1U, static_cast<char>(type));
+        body += payload;
+        std::ostringstream os;
+        os.put(static_cast<char>(type));
+        write_varint(os, payload.size());
+        os.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        codec<std::uint64_t>::write(os, detail::fnv1a(body.data(), body.size()));
+        pending += os.str();
+        if (group_size != 0 && ++pending_records >= group_size) {
+            this->commit();
+        }
+    }
+
+    /// @brief Cuts the journal back to the last committed record, dropping
+    /// what a failed commit may have written.
+    /// @details The journal is closed first, so that no buffered bytes reach
+    /// the file later. If it cannot be cut or opened again, it stays closed.
+    void rewind()
+    {
+        std::fclose(journal);
+        journal = nullptr;
+        if (detail::truncate_file(this->journal_path(), committed)) {
+            journal = std::fopen(this->journal_path().c_str(), "ab");
+        }
+    }
+
+    /// @brief Applies the records of a journal to the map.
+    /// @param content the content of the journal.
+    /// @return whether the journal was applied, torn, or skipped.
+    auto replay(const std::string &content) -> replay_t
+    {
+        std::istringstream is(content);
+        if (content.empty()) {
+            return replay_clean;
+        }
+        std::uint64_t journal_generation = read_varint(is);
+        if (!is) {
+            return replay_torn;
+        }
+        if (journal_generation < generation) {
+            // Left behind by a compaction, the snapshot already has it.
+            return replay_stale;
+        }
+        if (journal_generation > generation) {
+            // Its snapshot was lost, replaying it on this one would be wrong.
+            return replay_ahead;
+        }
+        while (is.peek() != std::char_traits<char>::eof()) {
+            int type             = is.get();
+            std::uint64_t length = read_varint(is);
+            if (!is || length > content.size()) {
+                return replay_torn;
+            }
+            std::string body(static_cast<std::size_t>(length) + 1U, static_cast<char>(type));
+            is.read(&body[1], static_cast<std::streamsize>(length));
+            std::uint64_t checksum = codec<std::uint64_t>::read(is);
+            if (!is || checksum != detail::fnv1a(body.data(), body.size())) {
+                return replay_torn;
+            }
+            std::istringstream payload(body.substr(1U));
+            if (!this->apply(static_cast<record_t>(type), payload)) {
+                return replay_torn;
+            }
+        }
+        return replay_clean;
+    }
+
+    /// @brief Applies a single record to the map.
+    /// @param type the kind of record.
+    /// @param payload the encoded arguments of the change.
+    /// @return false if the payload is malformed.
+    auto apply(record_t type, std::istream &payload) -> bool
+    {
+        switch (type) {
+        case record_insert:
+        case record_update:
+        case record_erase_key_value: {
+            Key key     = codec<Key>::read(payload);
+            Value value = codec<Value>::read(payload);
+            if (!payload) {
+                return false;
+            }
+            if (type == record_insert) {
+                table.insert(key, value);
+            } else if (type == record_update) {
+                table.update(key, value);
+            } else {
+                table.erase(key, value);
+            }
+            return true;
+        }
+        case record_erase_key: {
+            Key key = codec<Key>::read(payload);
+            if (!payload) {
+                return false;
+            }
+            table.erase(key);
+            return true;
+        }
+        case record_erase_position: {
+            std::uint64_t position = read_varint(payload);
+            if (!payload || position >= table.size()) {
+                return false;
+            }
+            table.erase(table.at(static_cast<std::size_t>(position)));
+            return true;
+        }
+        case record_clear:
+            table.clear();
+            return true;
+        case record_sort: {
+            std::uint64_t size = read_varint(payload);
+            if (!payload || size != table.size()) {
+                return false;
+            }
+            std::vector<iterator> entries;
+            entries.reserve(table.size());
+            for (iterator it = table.begin(); it != table.end(); ++it) {
+                entries.push_back(it);
+            }
+            map_t sorted;
+            for (std::uint64_t i = 0; i < size; ++i) {
+                std::uint64_t position = read_varint(payload);
+                if (!payload || position >= size) {
+                    return false;
+                }
+                iterator it = entries[static_cast<std::size_t>(position)];
+                sorted.insert(it->first, it->second);
+            }
+            table = std::move(sorted);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    /// @brief The journaled map.
+    map_t table;
+    /// @brief The path prefix of the files.
+    std::string prefix;
+    /// @brief The journal.
+    std::FILE *journal;
+    /// @brief The records not yet written.
+    std::string pending;
+    /// @brief The number of records not yet written.
+    std::size_t pending_records;
+    /// @brief The number of records written together.
+    std::size_t group_size;
+    /// @brief The generation of the snapshot and journal.
+    std::uint64_t generation;
+    /// @brief The size of the journal, up to the last committed record.
+    std::uint64_t committed;
+    /// @brief True if the last commit failed.
+    bool failed;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,397 @@
+/// @file mapped_file.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Access to the content of files, mapped in memory.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ORDERED_MULTIMAP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define ORDERED_MULTIMAP_HAS_MMAP 0
+#endif
+
+/// @brief When set, shared memory objects are regular files in the temporary
+/// directory, mapped shared. Darwin cannot resize a POSIX shared memory object
+/// once it has a size, hence it is the default there.
+#ifndef ORDERED_MULTIMAP_SHM_FILES
+#if defined(__APPLE__)
+#define ORDERED_MULTIMAP_SHM_FILES 1
+#else
+#define ORDERED_MULTIMAP_SHM_FILES 0
+#endif
+#endif
+
+namespace ordered_multimap
+{
+
+/// @brief The read-only content of a file.
+/// @details On POSIX systems the file is mapped with `mmap`, hence opening it
+/// costs a system call, pages are loaded lazily, and processes mapping the same
+/// file share them. Elsewhere, the file is read into memory.
+class mapped_file_t
+{
+public:
+    /// @brief Construct an empty mapping.
+    mapped_file_t()
+        : address(nullptr)
+        , length(0)
+        , buffer()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Mappings cannot be copied.
+    mapped_file_t(const mapped_file_t &) = delete;
+
+    /// @brief Mappings cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const mapped_file_t &) -> mapped_file_t & = delete;
+
+    /// @brief Unmaps the file.
+    ~mapped_file_t() { this->close(); }
+
+    /// @brief Maps the given file, replacing the current mapping.
+    /// @param path the path of the file.
+    /// @return true on success, false otherwise.
+    auto open(const std::string &path) -> bool
+    {
+        this->close();
+#if ORDERED_MULTIMAP_HAS_MMAP
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return false;
+        }
+        struct stat status = {};
+        if (::fstat(descriptor, &status) != 0) {
+            ::close(descriptor);
+            return false;
+        }
+        length = static_cast<std::size_t>(status.st_size);
+        if (length > 0) {
+            void *mapping = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(descriptor);
+                length = 0;
+                return false;
+            }
+            address = static_cast<const char *>(mapping);
+        }
+        // The mapping keeps the file alive.
+        ::close(descriptor);
+        return true;
+#else
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        address = buffer.empty() ? nullptr : buffer.data();
+        length  = buffer.size();
+        return true;
+#endif
+    }
+
+    /// @brief Releases the mapping.
+    void close()
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        if (address != nullptr) {
+            ::munmap(const_cast<char *>(address), length);
+        }
+#endif
+        buffer.clear();
+        address = nullptr;
+        length  = 0;
+    }
+
+    /// @brief Returns the content of the file.
+    /// @return a pointer to the first byte, null if the file is empty.
+    auto data() const -> const char * { return address; }
+
+    /// @brief Returns the size of the file.
+    /// @return the number of bytes.
+    auto size() const -> std::size_t { return length; }
+
+private:
+    /// @brief The first byte of the content.
+    const char *address;
+    /// @brief The number of bytes.
+    std::size_t length;
+    /// @brief Holds the content when memory mapping is not available.
+    std::vector<char> buffer;
+};
+
+/// @brief A writable file mapped in memory, which can grow.
+/// @details On POSIX systems the file is mapped shared, hence changes reach
+/// the file through the page cache, and `sync` forces them to the device.
+/// Elsewhere, the file is read into memory, and written back by `sync` and
+/// `close`. Growing the region may move it, hence its content must be
+/// addressed by offsets.
+class mapped_region_t
+{
+public:
+    /// @brief Construct an empty region.
+    mapped_region_t()
+        : address(nullptr)
+        , length(0)
+        , descriptor(-1)
+        , path()
+        , buffer()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Regions cannot be copied.
+    mapped_region_t(const mapped_region_t &) = delete;
+
+    /// @brief Regions cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const mapped_region_t &) -> mapped_region_t & = delete;
+
+    /// @brief Unmaps the file.
+    ~mapped_region_t() { this->close(); }
+
+    /// @brief Maps the given file, creating it if it does not exist.
+    /// @param _path the path of the file.
+    /// @param minimum_size the file is extended to at least this size.
+    /// @return true on success, false otherwise.
+    auto open(const std::string &_path, std::size_t minimum_size) -> bool
+    {
+        this->close();
+        path = _path;
+#if ORDERED_MULTIMAP_HAS_MMAP
+        return this->attach(::open(path.c_str(), O_RDWR | O_CREAT, 0644), minimum_size);
+#else
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (file) {
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        length = buffer.size();
+        if (!this->resize(length < minimum_size ? minimum_size : length)) {
+            this->close();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    /// @brief Maps the given POSIX shared memory object, creating it if it
+    /// does not exist.
+    /// @details Every process mapping the object sees the same content. The
+    /// object outlives the processes, until it is removed by `unlink_shared`.
+    /// With `ORDERED_MULTIMAP_SHM_FILES`, the object is a file in the
+    /// temporary directory, see `shared_path`.
+    /// @param name the name of the object, starting with a slash.
+    /// @param minimum_size the object is extended to at least this size.
+    /// @return true on success, false otherwise, or if shared memory is not
+    /// available.
+    auto open_shared(const std::string &name, std::size_t minimum_size) -> bool
+    {
+        this->close();
+#if ORDERED_MULTIMAP_HAS_MMAP && ORDERED_MULTIMAP_SHM_FILES
+        path = shared_path(name);
+        return this->attach(::open(path.c_str(), O_RDWR | O_CREAT, 0644), minimum_size);
+#elif ORDERED_MULTIMAP_HAS_MMAP
+        return this->attach(::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644), minimum_size);
+#else
+        (void)name;
+        (void)minimum_size;
+        return false;
+#endif
+    }
+
+    /// @brief Removes a POSIX shared memory object, processes which mapped it
+    /// keep their mapping.
+    /// @param name the name of the object.
+    /// @return true on success.
+    static auto unlink_shared(const std::string &name) -> bool
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP && ORDERED_MULTIMAP_SHM_FILES
+        return ::unlink(shared_path(name).c_str()) == 0;
+#elif ORDERED_MULTIMAP_HAS_MMAP
+        return ::shm_unlink(name.c_str()) == 0;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    /// @brief Returns the file which holds a shared memory object, when
+    /// `ORDERED_MULTIMAP_SHM_FILES` is set.
+    /// @param name the name of the object, starting with a slash.
+    /// @return the path of the file, in `TMPDIR`, or in `/tmp`.
+    static auto shared_path(const std::string &name) -> std::string
+    {
+        const char *directory = std::getenv("TMPDIR");
+        std::string result    = directory != nullptr && directory[0] != 0 ? directory : "/tmp";
+        if (result[result.size() - 1] == '/') {
+            result.erase(result.size() - 1);
+        }
+        return result + (name.empty() || name[0] != '/' ? "/" : "") + name;
+    }
+
+    /// @brief Maps again the file, if another process extended it.
+    /// @return true on success, false otherwise.
+    auto refresh() -> bool
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        struct stat status = {};
+        if (descriptor < 0 || ::fstat(descriptor, &status) != 0) {
+            return false;
+        }
+        std::size_t size = static_cast<std::size_t>(status.st_size);
+        return size <= length || this->resize(size);
+#else
+        return true;
+#endif
+    }
+
+    /// @brief Extends the file, the content may move.
+    /// @param size the new size, smaller sizes are ignored.
+    /// @return true on success, false otherwise.
+    auto grow(std::size_t size) -> bool
+    {
+        if (size <= length) {
+            return true;
+        }
+        return this->resize(size);
+    }
+
+    /// @brief Forces the content down to the storage device.
+    /// @return true on success, false otherwise.
+    auto sync() -> bool
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        return address == nullptr || (::msync(address, length, MS_SYNC) == 0 && ::fsync(descriptor) == 0);
+#else
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        bool success = std::fwrite(buffer.data(), 1U, buffer.size(), file) == buffer.size();
+        return std::fclose(file) == 0 && success;
+#endif
+    }
+
+    /// @brief Writes back, and releases the mapping.
+    void close()
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        if (address != nullptr) {
+            ::munmap(address, length);
+        }
+        if (descriptor >= 0) {
+            ::close(descriptor);
+        }
+#else
+        if (!path.empty()) {
+            this->sync();
+        }
+#endif
+        buffer.clear();
+        address    = nullptr;
+        length     = 0;
+        descriptor = -1;
+        path.clear();
+    }
+
+    /// @brief Checks if a file is mapped.
+    /// @return true if a file is mapped.
+    auto is_open() const -> bool { return address != nullptr; }
+
+    /// @brief Returns the content of the file.
+    /// @return a pointer to the first byte.
+    auto data() const -> char * { return address; }
+
+    /// @brief Returns the size of the file.
+    /// @return the number of bytes.
+    auto size() const -> std::size_t { return length; }
+
+private:
+#if ORDERED_MULTIMAP_HAS_MMAP
+    /// @brief Maps an open file.
+    /// @param _descriptor the descriptor of the file, negative on failure.
+    /// @param minimum_size the file is extended to at least this size.
+    /// @return true on success, false otherwise.
+    auto attach(int _descriptor, std::size_t minimum_size) -> bool
+    {
+        descriptor = _descriptor;
+        if (descriptor < 0) {
+            return false;
+        }
+        struct stat status = {};
+        if (::fstat(descriptor, &status) != 0) {
+            this->close();
+            return false;
+        }
+        length = static_cast<std::size_t>(status.st_size);
+        if (!this->resize(length < minimum_size ? minimum_size : length)) {
+            this->close();
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    /// @brief Changes the size of the file, and maps it again.
+    /// @details The file is resized and mapped anew before the old mapping
+    /// is released, hence on failure the old mapping is kept, and the content
+    /// stays accessible.
+    /// @param size the new size.
+    /// @return true on success, false otherwise.
+    auto resize(std::size_t size) -> bool
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        if (size != length && ::ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+            return false;
+        }
+        char *mapping = nullptr;
+        if (size > 0) {
+            void *result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+            if (result == MAP_FAILED) {
+                return false;
+            }
+            mapping = static_cast<char *>(result);
+        }
+        if (address != nullptr) {
+            ::munmap(address, length);
+        }
+        address = mapping;
+        length  = size;
+#else
+        buffer.resize(size);
+        length  = buffer.size();
+        address = buffer.empty() ? nullptr : buffer.data();
+#endif
+        return true;
+    }
+
+    /// @brief The first byte of the content.
+    char *address;
+    /// @brief The number of bytes.
+    std::size_t length;
+    /// @brief The descriptor of the file, when memory mapping is available.
+    int descriptor;
+    /// @brief The path of the file.
+    std::string path;
+    /// @brief Holds the content when memory mapping is not available.
+    std::vector<char> buffer;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,929 @@
+/// @file mapped_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map stored in a memory-mapped file, which can be larger
+/// than the available memory.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/mapped_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief Hashes the keys of a `mapped_ordered_multimap_t`.
+/// @details The hash is stored in the file, hence it must not change between
+/// runs, unlike `std::hash`. The default hashes the bytes of the key, which is
+/// correct for keys without padding whose equal values have equal bytes;
+/// specialize it for other keys.
+/// @tparam T the type of the key.
+template <typename T> struct mapped_hash {
+    /// @brief Hashes a key.
+    /// @param key the key.
+    /// @return the hash of the key.
+    auto operator()(const T &key) const -> std::uint64_t
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &key, sizeof(T));
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash ^ (hash >> 32U);
+    }
+};
+
+/// @brief An entry of a `mapped_ordered_multimap_t`.
+/// @details Unlike `std::pair`, it is trivially copyable, hence it can live in
+/// a file.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> struct mapped_entry_t {
+    /// @brief The key.
+    Key first;
+    /// @brief The value.
+    Value second;
+};
+
+/// @brief An ordered multimap whose entries and index live in a memory-mapped
+/// file.
+/// @details The file is an arena that grows in chunks, and holds a header,
+/// the nodes of the list, and a hash index over the keys. The index chains
+/// one node per distinct key in each bucket, and that node heads the group of
+/// nodes sharing its key, in insertion order; hence lookups stop at the first
+/// match, without visiting the duplicates, each of which may cost a page
+/// fault. Nodes refer to each other by offsets, so the file is
+/// position-independent: it can be closed, reopened, and moved around.
+/// Residency is left to the page cache of the OS, hence the map can be larger
+/// than the available memory.
+///
+/// The API mirrors the one of `ordered_multimap_t`, except for `sort` and
+/// `merge`, which would rewrite the whole file, and for the key-ordered
+/// traversals, since the index is hashed. Iterators hold offsets and survive
+/// the growth of the file; references and pointers to entries are
+/// invalidated by insertions, like those of a `std::vector`. A closed map
+/// behaves as an empty one, and insertions into it fail.
+/// @tparam Key the type of the key, it must be trivially copyable.
+/// @tparam Value the type of the value, it must be trivially copyable.
+/// @tparam Hash the hash of the keys, it must be stable across runs.
+template <typename Key, typename Value, typename Hash = mapped_hash<Key>> class mapped_ordered_multimap_t
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "Keys are stored in a file, they must be trivially copyable.");
+    static_assert(std::is_trivially_copyable<Value>::value, "Values are stored in a file, they must be trivially copyable.");
+
+    /// @brief An offset in the file, zero is used as the null offset.
+    using offset_t = std::uint64_t;
+
+    /// @brief The header at the beginning of the file.
+    struct header_t {
+        /// @brief Identifies the format.
+        char magic[8];
+        /// @brief A known value, to detect files written with another byte order.
+        std::uint64_t probe;
+        /// @brief The size of a node, to detect files written for other types.
+        std::uint64_t node_size;
+        /// @brief The number of bytes allocated in the file.
+        std::uint64_t used;
+        /// @brief The number of entries.
+        std::uint64_t count;
+        /// @brief The first node of the list.
+        offset_t head;
+        /// @brief The last node of the list.
+        offset_t tail;
+        /// @brief The first unused node.
+        offset_t free_nodes;
+        /// @brief The array of buckets of the hash index.
+        offset_t buckets;
+        /// @brief The number of buckets, a power of two.
+        std::uint64_t bucket_count;
+    };
+
+    /// @brief A node of the list, also chained in a bucket of the index.
+    struct node_t {
+        /// @brief The previous node in the list.
+        offset_t prev;
+        /// @brief The next node in the list.
+        offset_t next;
+        /// @brief The next group in the same bucket, or the next node in the
+        /// free list.
+        offset_t chain;
+        /// @brief The next node in the same group, zero for the last one.
+        offset_t group_next;
+        /// @brief The previous node in the same group, the first node of the
+        /// group refers to the last one.
+        offset_t group_prev;
+        /// @brief The hash of the key.
+        std::uint64_t hash;
+        /// @brief The entry.
+        mapped_entry_t<Key, Value> entry;
+    };
+
+public:
+    /// @brief The type of the entries.
+    using list_entry_t = mapped_entry_t<Key, Value>;
+
+    /// @brief Iterator over the entries, in insertion order.
+    /// @tparam Owner the type of the map, const for constant iterators.
+    /// @tparam Entry the type of the entry, const for constant iterators.
+    template <typename Owner, typename Entry> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::bidirectional_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = list_entry_t;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a pointer to an entry.
+        using pointer           = Entry *;
+        /// @brief The type of a reference to an entry.
+        using reference         = Entry &;
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : owner(nullptr)
+            , offset(0)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the other iterator.
+        template <typename OtherOwner, typename OtherEntry>
+        basic_iterator(const basic_iterator<OtherOwner, OtherEntry> &other)
+            : owner(other.owner)
+            , offset(other.offset)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference { return owner->node(offset)->entry; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return &owner->node(offset)->entry; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            offset = owner->node(offset)->next;
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of the iterator before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Moves to the previous entry, the end moves to the last one.
+        /// @return a reference to this iterator.
+        auto operator--() -> basic_iterator &
+        {
+            offset = offset == 0 ? owner->header()->tail : owner->node(offset)->prev;
+            return *this;
+        }
+
+        /// @brief Moves to the previous entry, the end moves to the last one.
+        /// @return a copy of the iterator before moving.
+        auto operator--(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            --(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool { return offset == other.offset; }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return offset != other.offset; }
+
+    private:
+        friend class mapped_ordered_multimap_t;
+        template <typename OtherOwner, typename OtherEntry> friend class basic_iterator;
+
+        /// @brief Construct an iterator to the node at the given offset.
+        /// @param _owner the map.
+        /// @param _offset the offset of the node, zero for the end.
+        basic_iterator(Owner *_owner, offset_t _offset)
+            : owner(_owner)
+            , offset(_offset)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The map.
+        Owner *owner;
+        /// @brief The offset of the node, zero for the end.
+        offset_t offset;
+    };
+
+    /// @brief Iterator for the list, for the user.
+    using iterator       = basic_iterator<mapped_ordered_multimap_t, list_entry_t>;
+    /// @brief Constant iterator for the list, for the user.
+    using const_iterator = basic_iterator<const mapped_ordered_multimap_t, const list_entry_t>;
+    /// @brief Reverse iterator for the list, for the user.
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    /// @brief Constant reverse iterator for the list, for the user.
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    /// @brief Construct a closed map.
+    mapped_ordered_multimap_t()
+        : region()
+        , chunk_size(1U << 20U)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The map owns its mapping, it cannot be copied.
+    mapped_ordered_multimap_t(const mapped_ordered_multimap_t &) = delete;
+
+    /// @brief The map owns its mapping, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const mapped_ordered_multimap_t &) -> mapped_ordered_multimap_t & = delete;
+
+    /// @brief Unmaps the file.
+    ~mapped_ordered_multimap_t() = default;
+
+    /// @brief Opens the given file, creating an empty map if it does not exist.
+    /// @param path the path of the file.
+    /// @param _chunk_size the file grows by multiples of this number of bytes.
+    /// @return true on success, false if the file is not a compatible map.
+    auto open(const std::string &path, std::size_t _chunk_size = 1U << 20U) -> bool
+    {
+        chunk_size = _chunk_size < sizeof(header_t) * 2U ? sizeof(header_t) * 2U : _chunk_size;
+        return region.open(path, 0) && this->attach();
+    }
+
+    /// @brief Opens the given POSIX shared memory object, creating an empty
+    /// map if it does not exist.
+    /// @details Processes sharing the map must serialize their accesses, and
+    /// call `refresh` before each one, see `shared_ordered_multimap_t`.
+    /// @param name the name of the object, starting with a slash.
+    /// @param _chunk_size the object grows by multiples of this number of bytes.
+    /// @return true on success, false if the object is not a compatible map.
+    auto open_shared(const std::string &name, std::size_t _chunk_size = 1U << 20U) -> bool
+    {
+        chunk_size = _chunk_size < sizeof(header_t) * 2U ? sizeof(header_t) * 2U : _chunk_size;
+        return region.open_shared(name, 0) && this->attach();
+    }
+
+    /// @brief Checks if another process extended the file beyond the part
+    /// mapped by this one, which must then call `refresh`.
+    /// @return true if the mapping is stale.
+    auto stale() const -> bool { return this->is_open() && this->header()->used > region.size(); }
+
+    /// @brief Maps again the file, if another process extended it.
+    /// @return true on success, false if the map is closed, or if the file
+    /// could not be mapped again; the old mapping is then kept.
+    auto refresh() -> bool { return this->is_open() && (!this->stale() || region.refresh()); }
+
+    /// @brief Unmaps the file, after writing back the changes.
+    void close()
+    {
+        if (region.is_open()) {
+            region.sync();
+        }
+        region.close();
+    }
+
+    /// @brief Checks if the file is open.
+    /// @return true if the file is open.
+    auto is_open() const -> bool { return region.is_open(); }
+
+    /// @brief Forces the changes down to the storage device.
+    /// @return true on success.
+    auto sync() -> bool { return region.sync(); }
+
+    /// @brief Returns the size of the file.
+    /// @return the number of bytes.
+    auto file_size() const -> std::size_t { return region.size(); }
+
+    /// @brief Clears the content of the map.
+    /// @details The space in the file is kept, and reused by later insertions.
+    void clear()
+    {
+        while (this->is_open() && this->header()->head != 0) {
+            this->unlink(this->header()->head);
+        }
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return this->is_open() ? static_cast<std::size_t>(this->header()->count) : 0U; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return this->size() == 0; }
+
+    /// @brief Returns an iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() -> iterator { return iterator(this, this->is_open() ? this->header()->head : 0); }
+
+    /// @brief Returns a const iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() const -> const_iterator { return const_iterator(this, this->is_open() ? this->header()->head : 0); }
+
+    /// @brief Returns an iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() -> iterator { return iterator(this, 0); }
+
+    /// @brief Returns a const iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() const -> const_iterator { return const_iterator(this, 0); }
+
+    /// @brief Returns a reverse iterator to the last element of the list.
+    /// @return a reverse iterator to the last element of the list.
+    auto rbegin() -> reverse_iterator { return reverse_iterator(this->end()); }
+
+    /// @brief Returns a const reverse iterator to the last element of the list.
+    /// @return a reverse iterator to the last element of the list.
+    auto rbegin() const -> const_reverse_iterator { return const_reverse_iterator(this->end()); }
+
+    /// @brief Returns a reverse iterator before the first element of the list.
+    /// @return a reverse iterator before the first element of the list.
+    auto rend() -> reverse_iterator { return reverse_iterator(this->begin()); }
+
+    /// @brief Returns a const reverse iterator before the first element of
+    /// the list.
+    /// @return a reverse iterator before the first element of the list.
+    auto rend() const -> const_reverse_iterator { return const_reverse_iterator(this->begin()); }
+
+    /// @brief Returns a reference to the first element in the map.
+    /// @return An iterator to the first element.
+    auto front() -> iterator { return this->begin(); }
+
+    /// @brief Returns a reference to the last element in the map.
+    /// @return An iterator to the last element.
+    auto back() -> iterator { return iterator(this, this->is_open() ? this->header()->tail : 0); }
+
+    /// @brief Returns a vector containing all keys in the map, in insertion
+    /// order.
+    /// @return A vector of keys.
+    auto keys() const -> std::vector<Key>
+    {
+        std::vector<Key> result;
+        result.reserve(this->size());
+        for (const auto &entry : *this) {
+            result.push_back(entry.first);
+        }
+        return result;
+    }
+
+    /// @brief Returns a vector containing all values in the map, in insertion
+    /// order.
+    /// @return A vector of values.
+    auto values() const -> std::vector<Value>
+    {
+        std::vector<Value> result;
+        result.reserve(this->size());
+        for (const auto &entry : *this) {
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    /// @brief Returns a vector containing all key-value pairs in insertion
+    /// order.
+    /// @return A vector of key-value pairs.
+    auto to_vector() const -> std::vector<std::pair<Key, Value>>
+    {
+        std::vector<std::pair<Key, Value>> result;
+        result.reserve(this->size());
+        for (const auto &entry : *this) {
+            result.emplace_back(entry.first, entry.second);
+        }
+        return result;
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return the iterator to the newly inserted element, or the end if the
+    /// file could not grow.
+    auto insert(const Key &key, const Value &value) -> iterator
+    {
+        // The arguments may refer to an entry, which moves if the file grows.
+        const Value copy = value;
+        return this->emplace(key, copy);
+    }
+
+    /// @brief Constructs a value in-place at the end of the map with the given
+    /// key.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`, they must
+    /// not refer to entries of the map, which move if the file grows.
+    /// @return An iterator to the newly inserted element, or the end if the
+    /// file could not grow.
+    template <typename... Args> auto emplace(const Key &_key, Args &&...args) -> iterator
+    {
+        const Key key = _key;
+        if (!this->is_open() || !this->reserve_for_insert()) {
+            return this->end();
+        }
+        offset_t offset = this->allocate_node();
+        if (offset == 0) {
+            return this->end();
+        }
+        header_t *h  = this->header();
+        node_t *n    = this->node(offset);
+        n->hash      = Hash()(key);
+        n->entry.first = key;
+        ::new (static_cast<void *>(&n->entry.second)) Value(std::forward<Args>(args)...);
+        // Append to the list.
+        n->prev = h->tail;
+        n->next = 0;
+        if (h->tail != 0) {
+            this->node(h->tail)->next = offset;
+        } else {
+            h->head = offset;
+        }
+        h->tail = offset;
+        this->link(offset);
+        ++h->count;
+        return iterator(this, offset);
+    }
+
+    /// @brief Updates all values associated with the given key to the new
+    /// value.
+    /// @details If no such entries exist, a new one is appended at the end.
+    /// @param key The key to update.
+    /// @param value The new value to assign.
+    /// @return An iterator to the first updated or newly inserted element.
+    auto update(const Key &key, const Value &value) -> iterator
+    {
+        offset_t first = this->find_offset(key);
+        for (offset_t offset = first; offset != 0; offset = this->node(offset)->group_next) {
+            this->node(offset)->entry.second = value;
+        }
+        return first != 0 ? iterator(this, first) : this->insert(key, value);
+    }
+
+    /// @brief Erases all the elements with the given key.
+    /// @param key the key of the elements to remove.
+    /// @return an iterator to the element following the first one removed.
+    auto erase(const Key &key) -> iterator
+    {
+        offset_t first = this->find_offset(key);
+        if (first == 0) {
+            return this->end();
+        }
+        offset_t next = this->node(first)->next;
+        while (next != 0 && this->node(next)->entry.first == key) {
+            next = this->node(next)->next;
+        }
+        this->unlink_group(first);
+        return iterator(this, next);
+    }
+
+    /// @brief Erases the elment from the list, and returns an iteator to the
+    /// same position in the list (i.e., the elment after the one removed).
+    /// @param it_list the iterator of the element to remove.
+    /// @return an iterator to the same position in the list.
+    auto erase(iterator it_list) -> iterator
+    {
+        if (it_list.offset == 0 || !this->is_open()) {
+            return this->end();
+        }
+        offset_t next = this->node(it_list.offset)->next;
+        this->unlink(it_list.offset);
+        return iterator(this, next);
+    }
+
+    /// @brief Erases a single element that matches the given key and value.
+    /// @details This function removes the first occurrence, in insertion
+    /// order, of the specified key-value pair.
+    /// @param key The key to search for.
+    /// @param value The value to match against.
+    /// @return The number of elements removed (0 or 1).
+    auto erase(const Key &key, const Value &value) -> std::size_t
+    {
+        offset_t found = this->find_offset(key);
+        while (found != 0 && !(this->node(found)->entry.second == value)) {
+            found = this->node(found)->group_next;
+        }
+        if (found == 0) {
+            return 0;
+        }
+        this->unlink(found);
+        return 1;
+    }
+
+    /// @brief Returns an iterator to the element in the given position.
+    /// @param position the position of the element to retrieve.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto at(std::size_t position) -> iterator
+    {
+        iterator itr = this->begin();
+        for (std::size_t i = 0; i < position && itr != this->end(); ++i) {
+            ++itr;
+        }
+        return itr;
+    }
+
+    /// @brief Returns the index of the given iterator in the list.
+    /// @param it The iterator to locate.
+    /// @return The index of the iterator in the list.
+    auto index_of(const const_iterator &it) const -> std::size_t
+    {
+        return static_cast<std::size_t>(std::distance(this->begin(), it));
+    }
+
+    /// @brief Returns an iterator to the first element, in insertion order,
+    /// associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) -> iterator { return iterator(this, this->find_offset(key)); }
+
+    /// @brief Returns an iterator to the first element, in insertion order,
+    /// associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) const -> const_iterator { return const_iterator(this, this->find_offset(key)); }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return this->find_offset(key) != 0; }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    auto count(const Key &key) const -> std::size_t
+    {
+        std::size_t result = 0;
+        for (offset_t offset = this->find_offset(key); offset != 0; offset = this->node(offset)->group_next) {
+            ++result;
+        }
+        return result;
+    }
+
+    /// @brief Returns a range of iterators to the elements with the given key.
+    /// @details Like `ordered_multimap_t::equal_range`, the range spans the
+    /// list from the first to the last element with the key, in insertion
+    /// order, hence it may include elements with other keys in between.
+    /// @param key The key to search for.
+    /// @return A pair of iterators [begin, end) to elements in the list that match the key.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        offset_t first = this->find_offset(key);
+        if (first == 0) {
+            return {this->end(), this->end()};
+        }
+        return {iterator(this, first), iterator(this, this->node(this->node(first)->group_prev)->next)};
+    }
+
+    /// @brief Returns a range of iterators to the elements with the given key.
+    /// @details Like `ordered_multimap_t::equal_range`, the range spans the
+    /// list from the first to the last element with the key, in insertion
+    /// order, hence it may include elements with other keys in between.
+    /// @param key The key to search for.
+    /// @return A pair of iterators [begin, end) to elements in the list that match the key.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        offset_t first = this->find_offset(key);
+        if (first == 0) {
+            return {this->end(), this->end()};
+        }
+        return {const_iterator(this, first), const_iterator(this, this->node(this->node(first)->group_prev)->next)};
+    }
+
+    /// @brief Extracts and removes all values associated with the given key.
+    /// @param key The key to extract.
+    /// @return A vector containing all values that were associated with the key.
+    auto extract(const Key &key) -> std::vector<Value>
+    {
+        std::vector<Value> result;
+        offset_t first = this->find_offset(key);
+        for (offset_t offset = first; offset != 0; offset = this->node(offset)->group_next) {
+            result.push_back(this->node(offset)->entry.second);
+        }
+        if (first != 0) {
+            this->unlink_group(first);
+        }
+        return result;
+    }
+
+private:
+    /// @brief Identifies the format.
+    static constexpr char magic[8] = {'O', 'M', 'M', 'M', 'A', 'P', 0, 2};
+    /// @brief A known value, to detect files written with another byte order.
+    static constexpr std::uint64_t probe = 0x0102030405060708ULL;
+    /// @brief The number of buckets of a new map.
+    static constexpr std::uint64_t initial_buckets = 64U;
+
+    /// @brief Returns the header.
+    /// @return a pointer to the header.
+    auto header() const -> header_t * { return reinterpret_cast<header_t *>(region.data()); }
+
+    /// @brief Returns the node at the given offset.
+    /// @param offset the offset.
+    /// @return a pointer to the node.
+    auto node(offset_t offset) const -> node_t * { return reinterpret_cast<node_t *>(region.data() + offset); }
+
+    /// @brief Returns the bucket of the given hash.
+    /// @param hash the hash.
+    /// @return a reference to the offset of the first node in the bucket.
+    auto bucket(std::uint64_t hash) const -> offset_t &
+    {
+        const header_t *h = this->header();
+        offset_t *buckets = reinterpret_cast<offset_t *>(region.data() + h->buckets);
+        return buckets[hash & (h->bucket_count - 1U)];
+    }
+
+    /// @brief Returns the offset of the first node, in insertion order, with
+    /// the given key, which heads the group of the key.
+    /// @param key the key.
+    /// @return the offset, zero if not found, or if the map is closed.
+    auto find_offset(const Key &key) const -> offset_t
+    {
+        if (!this->is_open()) {
+            return 0;
+        }
+        return this->find_group(Hash()(key), key);
+    }
+
+    /// @brief Returns the first node of the group with the given key.
+    /// @param hash the hash of the key.
+    /// @param key the key.
+    /// @return the offset, zero if not found.
+    auto find_group(std::uint64_t hash, const Key &key) const -> offset_t
+    {
+        for (offset_t offset = this->bucket(hash); offset != 0; offset = this->node(offset)->chain) {
+            const node_t *n = this->node(offset);
+            if (n->hash == hash && n->entry.first == key) {
+                return offset;
+            }
+        }
+        return 0;
+    }
+
+    /// @brief Appends a node to the group of its key, or makes it the first
+    /// node of a new group in its bucket.
+    /// @param offset the offset of the node, with its hash and key set.
+    void link(offset_t offset)
+    {
+        node_t *n     = this->node(offset);
+        n->group_next = 0;
+        offset_t head = this->find_group(n->hash, n->entry.first);
+        if (head == 0) {
+            offset_t &bucket = this->bucket(n->hash);
+            n->chain         = bucket;
+            n->group_prev    = offset;
+            bucket           = offset;
+            return;
+        }
+        node_t *h                            = this->node(head);
+        n->chain                             = 0;
+        n->group_prev                        = h->group_prev;
+        this->node(h->group_prev)->group_next = offset;
+        h->group_prev                        = offset;
+    }
+
+    /// @brief Returns the link of a bucket which refers to the given group.
+    /// @param head the first node of the group.
+    /// @return a reference to the link.
+    auto group_link(offset_t head) -> offset_t &
+    {
+        offset_t *link = &this->bucket(this->node(head)->hash);
+        while (*link != head) {
+            link = &this->node(*link)->chain;
+        }
+        return *link;
+    }
+
+    /// @brief Checks the content of a newly mapped file, or formats it if empty.
+    /// @return true on success, false if the file is not a compatible map.
+    auto attach() -> bool
+    {
+        if (region.size() == 0) {
+            if (!this->format()) {
+                region.close();
+                return false;
+            }
+            return true;
+        }
+        if (region.size() < sizeof(header_t)) {
+            region.close();
+            return false;
+        }
+        const header_t *h = this->header();
+        if (std::memcmp(h->magic, magic, sizeof(magic)) != 0 || h->probe != probe || h->node_size != sizeof(node_t) ||
+            h->used > region.size() || h->buckets + h->bucket_count * sizeof(offset_t) > h->used) {
+            region.close();
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Initializes an empty file.
+    /// @return true on success.
+    auto format() -> bool
+    {
+        if (!region.grow(chunk_size)) {
+            return false;
+        }
+        header_t *h = this->header();
+        std::memset(static_cast<void *>(h), 0, sizeof(header_t));
+        std::memcpy(h->magic, magic, sizeof(magic));
+        h->probe     = probe;
+        h->node_size = sizeof(node_t);
+        h->used      = align(sizeof(header_t));
+        offset_t buckets = this->allocate(initial_buckets * sizeof(offset_t));
+        if (buckets == 0) {
+            return false;
+        }
+        h               = this->header();
+        h->buckets      = buckets;
+        h->bucket_count = initial_buckets;
+        return true;
+    }
+
+    /// @brief Rounds a size up to the alignment of the nodes.
+    /// @param size the size.
+    /// @return the rounded size.
+    static auto align(std::uint64_t size) -> std::uint64_t
+    {
+        const std::uint64_t alignment = alignof(node_t) < alignof(header_t) ? alignof(header_t) : alignof(node_t);
+        return (size + alignment - 1U) / alignment * alignment;
+    }
+
+    /// @brief Allocates zeroed bytes at the end of the arena, growing the
+    /// file by whole chunks.
+    /// @param size the number of bytes.
+    /// @return the offset of the bytes, zero if the file could not grow.
+    auto allocate(std::uint64_t size) -> offset_t
+    {
+        size              = align(size);
+        std::uint64_t end = this->header()->used + size;
+        if (end > region.size()) {
+            std::uint64_t chunks = (end + chunk_size - 1U) / chunk_size;
+            if (!region.grow(static_cast<std::size_t>(chunks * chunk_size))) {
+                return 0;
+            }
+        }
+        header_t *h     = this->header();
+        offset_t offset = h->used;
+        h->used         = end;
+        std::memset(region.data() + offset, 0, static_cast<std::size_t>(size));
+        return offset;
+    }
+
+    /// @brief Takes a node from the free list, or from the arena.
+    /// @return the offset of the node, zero if the file could not grow.
+    auto allocate_node() -> offset_t
+    {
+        header_t *h = this->header();
+        if (h->free_nodes != 0) {
+            offset_t offset = h->free_nodes;
+            h->free_nodes   = this->node(offset)->chain;
+            return offset;
+        }
+        return this->allocate(sizeof(node_t));
+    }
+
+    /// @brief Puts a node in the free list.
+    /// @param offset the offset of the node.
+    void release_node(offset_t offset)
+    {
+        header_t *h              = this->header();
+        this->node(offset)->chain = h->free_nodes;
+        h->free_nodes            = offset;
+    }
+
+    /// @brief Removes a node from the list and from its bucket, and releases it.
+    /// @param offset the offset of the node.
+    void unlink(offset_t offset)
+    {
+        header_t *h = this->header();
+        node_t *n   = this->node(offset);
+        if (n->prev != 0) {
+            this->node(n->prev)->next = n->next;
+        } else {
+            h->head = n->next;
+        }
+        if (n->next != 0) {
+            this->node(n->next)->prev = n->prev;
+        } else {
+            h->tail = n->prev;
+        }
+        if (this->node(n->group_prev)->group_next == 0) {
+            // The node heads its group, the next one takes its place.
+            offset_t &link = this->group_link(offset);
+            if (n->group_next == 0) {
+                link = n->chain;
+            } else {
+                node_t *successor     = this->node(n->group_next);
+                successor->chain      = n->chain;
+                successor->group_prev = n->group_prev;
+                link                  = n->group_next;
+            }
+        } else {
+            this->node(n->group_prev)->group_next = n->group_next;
+            if (n->group_next != 0) {
+                this->node(n->group_next)->group_prev = n->group_prev;
+            } else {
+                this->node(this->find_group(n->hash, n->entry.first))->group_prev = n->group_prev;
+            }
+        }
+        --h->count;
+        this->release_node(offset);
+    }
+
+    /// @brief Removes a whole group from its bucket and from the list, and
+    /// releases its nodes.
+    /// @param head the first node of the group.
+    void unlink_group(offset_t head)
+    {
+        header_t *h           = this->header();
+        this->group_link(head) = this->node(head)->chain;
+        offset_t offset       = head;
+        while (offset != 0) {
+            node_t *n = this->node(offset);
+            if (n->prev != 0) {
+                this->node(n->prev)->next = n->next;
+            } else {
+                h->head = n->next;
+            }
+            if (n->next != 0) {
+                this->node(n->next)->prev = n->prev;
+            } else {
+                h->tail = n->prev;
+            }
+            offset_t next = n->group_next;
+            --h->count;
+            this->release_node(offset);
+            offset = next;
+        }
+    }
+
+    /// @brief Doubles the buckets of the index, when the next insertion would
+    /// exceed one entry per bucket on average.
+    /// @details The old array of buckets is carved into free nodes.
+    /// @return true on success, false if the file could not grow.
+    auto reserve_for_insert() -> bool
+    {
+        if (this->header()->count < this->header()->bucket_count) {
+            return true;
+        }
+        std::uint64_t bucket_count = this->header()->bucket_count * 2U;
+        offset_t buckets           = this->allocate(bucket_count * sizeof(offset_t));
+        if (buckets == 0) {
+            return false;
+        }
+        header_t *h             = this->header();
+        offset_t old_buckets    = h->buckets;
+        std::uint64_t old_bytes = h->bucket_count * sizeof(offset_t);
+        h->buckets              = buckets;
+        h->bucket_count         = bucket_count;
+        // Only the first node of each group is chained in a bucket.
+        for (offset_t offset = h->head; offset != 0; offset = this->node(offset)->next) {
+            node_t *n = this->node(offset);
+            if (this->node(n->group_prev)->group_next == 0) {
+                offset_t &bucket = this->bucket(n->hash);
+                n->chain         = bucket;
+                bucket           = offset;
+            }
+        }
+        for (std::uint64_t used = 0; used + sizeof(node_t) <= old_bytes; used += align(sizeof(node_t))) {
+            this->release_node(old_buckets + used);
+        }
+        return true;
+    }
+
+    /// @brief The mapped file.
+    mapped_region_t region;
+    /// @brief The file grows by multiples of this number of bytes.
+    std::size_t chunk_size;
+};
+
+template <typename Key, typename Value, typename Hash> constexpr char mapped_ordered_multimap_t<Key, Value, Hash>::magic[8];
+template <typename Key, typename Value, typename Hash> constexpr std::uint64_t mapped_ordered_multimap_t<Key, Value, Hash>::probe;
+template <typename Key, typename Value, typename Hash> constexpr std::uint64_t mapped_ordered_multimap_t<Key, Value, Hash>::initial_buckets;
+
+} // namespace ordered_multimap
@@ -8,6 +8,11 @@
 
 #pragma once
 
+#include "ordered_multimap/codec.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <list>
 #include <map>
 #include <vector>
@@ -22,10 +27,269 @@ enum : unsigned char {
 namespace ordered_multimap
 {
 
+/// @brief The default index of an `ordered_multimap_t`, a `std::multimap`.
+/// @details An index policy exposes a `type` template, which, given the key
+/// and the handle to an element, names a container with the interface of a
+/// `std::multimap` (see `flat_index_t` for an alternative).
+struct multimap_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle> using type = std::multimap<Key, Handle>;
+};
+
+/// @brief Iterates over the entries of an index, in key order, yielding the
+/// elements of the list they refer to.
+/// @tparam TableIterator the type of iterator of the index.
+/// @tparam ListIterator the type of iterator of the list.
+template <typename TableIterator, typename ListIterator> class index_iterator_t
+{
+public:
+    /// @brief The category of the iterator.
+    using iterator_category = std::forward_iterator_tag;
+    /// @brief The type of the elements.
+    using value_type        = typename std::iterator_traits<ListIterator>::value_type;
+    /// @brief The type of the distance between iterators.
+    using difference_type   = std::ptrdiff_t;
+    /// @brief The type of a pointer to an element.
+    using pointer           = typename std::iterator_traits<ListIterator>::pointer;
+    /// @brief The type of a reference to an element.
+    using reference         = typename std::iterator_traits<ListIterator>::reference;
+
+    /// @brief Construct a singular iterator, with a value-initialized position.
+    index_iterator_t()
+        : position()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct an iterator.
+    /// @param _position the position in the index.
+    explicit index_iterator_t(TableIterator _position)
+        : position(_position)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the iterator to the element in the list, which can be
+    /// used to erase it, or to find its neighbours in insertion order.
+    /// @return the iterator to the element.
+    auto element() const -> ListIterator { return position->second; }
+
+    /// @brief Returns the element.
+    /// @return a reference to the element.
+    auto operator*() const -> reference { return *this->element(); }
+
+    /// @brief Returns the element.
+    /// @return a pointer to the element.
+    auto operator->() const -> pointer { return &*this->element(); }
+
+    /// @brief Moves to the next entry of the index.
+    /// @return a reference to this iterator.
+    auto operator++() -> index_iterator_t &
+    {
+        ++position;
+        return *this;
+    }
+
+    /// @brief Moves to the next entry of the index.
+    /// @return a copy of this iterator, before moving.
+    auto operator++(int) -> index_iterator_t
+    {
+        index_iterator_t copy(*this);
+        ++position;
+        return copy;
+    }
+
+    /// @brief Compares two iterators.
+    /// @param other the other iterator.
+    /// @return true if they refer to the same entry.
+    auto operator==(const index_iterator_t &other) const -> bool { return position == other.position; }
+
+    /// @brief Compares two iterators.
+    /// @param other the other iterator.
+    /// @return true if they refer to different entries.
+    auto operator!=(const index_iterator_t &other) const -> bool { return position != other.position; }
+
+private:
+    /// @brief The position in the index.
+    TableIterator position;
+};
+
+/// @brief A range of iterators, usable in range-based for loops.
+/// @tparam Iterator the type of iterator.
+template <typename Iterator> class iterator_range_t
+{
+public:
+    /// @brief Construct a range.
+    /// @param _first the beginning of the range.
+    /// @param _last the end of the range.
+    iterator_range_t(Iterator _first, Iterator _last)
+        : first(_first)
+        , last(_last)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the beginning of the range.
+    /// @return the beginning of the range.
+    auto begin() const -> Iterator { return first; }
+
+    /// @brief Returns the end of the range.
+    /// @return the end of the range.
+    auto end() const -> Iterator { return last; }
+
+    /// @brief Checks if the range is empty.
+    /// @return true if the range is empty.
+    auto empty() const -> bool { return first == last; }
+
+private:
+    /// @brief The beginning of the range.
+    Iterator first;
+    /// @brief The end of the range.
+    Iterator last;
+};
+
+namespace detail
+{
+
+/// @brief Returns the entries of an index whose key starts with the given
+/// prefix, for indices which answer it themselves.
+/// @param table the index.
+/// @param prefix the prefix.
+/// @param preferred unused, selects this overload when both are viable.
+/// @return the range of entries.
+template <typename Table, typename Key>
+auto prefix_bounds(Table &table, const Key &prefix, int preferred) -> decltype(table.prefix_range(prefix))
+{
+    (void)preferred;
+    return table.prefix_range(prefix);
+}
+
+/// @brief Returns the entries of an ordered index whose key starts with the
+/// given prefix.
+/// @details The range ends at the first key not less than the smallest string
+/// greater than all the strings starting with the prefix: the prefix without
+/// its trailing 0xFF bytes, and with its last byte incremented.
+/// @param table the index.
+/// @param prefix the prefix.
+/// @return the range of entries.
+template <typename Table, typename Key>
+auto prefix_bounds(Table &table, const Key &prefix, long) -> std::pair<decltype(table.begin()), decltype(table.begin())>
+{
+    Key bound(prefix);
+    while (!bound.empty() && static_cast<unsigned char>(bound.back()) == 0xFFU) {
+        bound.pop_back();
+    }
+    if (bound.empty()) {
+        return std::make_pair(table.lower_bound(prefix), table.end());
+    }
+    bound.back() = static_cast<typename Key::value_type>(static_cast<unsigned char>(bound.back()) + 1U);
+    return std::make_pair(table.lower_bound(prefix), table.lower_bound(bound));
+}
+
+/// @brief Turns an index into its read-optimized layout, for indices which
+/// provide one.
+/// @param table the index.
+/// @param preferred unused, selects this overload when both are viable.
+template <typename Table>
+auto optimize_for_reads(Table &table, int preferred) -> decltype(table.optimize_for_reads())
+{
+    (void)preferred;
+    table.optimize_for_reads();
+}
+
+/// @brief Leaves unchanged the indices without a read-optimized layout.
+/// @param table the index.
+template <typename Table> void optimize_for_reads(Table &table, long) { (void)table; }
+
+/// @brief Finds the first entry of each key of a range, for indices which
+/// batch the searches themselves.
+/// @param table the index.
+/// @param first the beginning of the keys.
+/// @param last the end of the keys.
+/// @param visit called with the result of each key, in order.
+/// @param preferred unused, selects this overload when both are viable.
+template <typename Table, typename ForwardIt, typename Visitor>
+auto find_many(Table &table, ForwardIt first, ForwardIt last, Visitor visit, int preferred)
+    -> decltype(table.find_many(first, last, visit))
+{
+    (void)preferred;
+    table.find_many(first, last, visit);
+}
+
+/// @brief Finds the first entry of each key of a range, one key at a time.
+/// @param table the index.
+/// @param first the beginning of the keys.
+/// @param last the end of the keys.
+/// @param visit called with the result of each key, in order.
+template <typename Table, typename ForwardIt, typename Visitor>
+void find_many(Table &table, ForwardIt first, ForwardIt last, Visitor visit, long)
+{
+    for (; first != last; ++first) {
+        visit(table.find(*first));
+    }
+}
+
+/// @brief Removes entries whose key is in a sorted range of distinct keys,
+/// for indices which remove them in a single pass themselves.
+/// @param table the index.
+/// @param first the beginning of the keys.
+/// @param last the end of the keys.
+/// @param visit called with the key and the mapped value of each entry with
+/// one of the keys, returns true if the entry is to be removed.
+/// @param preferred unused, selects this overload when both are viable.
+template <typename Table, typename ForwardIt, typename Visitor>
+auto erase_many(Table &table, ForwardIt first, ForwardIt last, Visitor visit, int preferred)
+    -> decltype(table.erase_many(first, last, visit))
+{
+    (void)preferred;
+    table.erase_many(first, last, visit);
+}
+
+/// @brief Removes entries whose key is in a sorted range of distinct keys,
+/// walking the index once, and removing them in place.
+/// @details Keys close to the current position are reached by stepping, the
+/// others by a search, so that a few keys do not cost a walk of the index.
+/// Consecutive entries to be removed are removed together.
+/// @param table the index.
+/// @param first the beginning of the keys.
+/// @param last the end of the keys.
+/// @param visit called with the key and the mapped value of each entry with
+/// one of the keys, returns true if the entry is to be removed.
+template <typename Table, typename ForwardIt, typename Visitor>
+void erase_many(Table &table, ForwardIt first, ForwardIt last, Visitor visit, long)
+{
+    auto it = table.begin();
+    for (; first != last; ++first) {
+        for (std::size_t step = 0; it != table.end() && it->first < *first; ++step) {
+            if (step == 8U) {
+                it = table.lower_bound(*first);
+                break;
+            }
+            ++it;
+        }
+        while (it != table.end() && !(*first < it->first)) {
+            if (!visit(it->first, it->second)) {
+                ++it;
+                continue;
+            }
+            auto stop = std::next(it);
+            while (stop != table.end() && !(*first < stop->first) && visit(stop->first, stop->second)) {
+                ++stop;
+            }
+            it = table.erase(it, stop);
+        }
+    }
+}
+
+} // namespace detail
+
 /// @brief A wrapper for a `std::list` container, which uses a `std::map` for accessing the data.
 /// @tparam Key the type of the key for building the `std::map`.
 /// @tparam Value the value stored inside the `std::list`.
-template <typename Key, typename Value> class ordered_multimap_t
+/// @tparam Index the policy providing the index, see `multimap_index_t`.
+template <typename Key, typename Value, typename Index = multimap_index_t> class ordered_multimap_t
 {
 public:
     /// @brief This stores the key->value association.
@@ -36,6 +300,19 @@ public:
     using iterator        = typename list_t::iterator;
     /// @brief Constant iterator for the list, for the user.
     using const_iterator  = typename list_t::const_iterator;
+
+private:
+    /// @brief Type of the map.
+    using table_t              = typename Index::template type<Key, iterator>;
+    using table_iterator       = typename table_t::iterator;
+    using table_const_iterator = typename table_t::const_iterator;
+
+public:
+    /// @brief Iterator over the elements in key order, for the user.
+    using key_iterator       = index_iterator_t<table_iterator, iterator>;
+    /// @brief Constant iterator over the elements in key order, for the user.
+    using const_key_iterator = index_iterator_t<table_const_iterator, const_iterator>;
+
     /// @brief The type of a compatible sort function.
     using sort_function_t = bool (*)(const list_entry_t &, const list_entry_t &);
 
@@ -47,19 +324,31 @@ public:
         // Nothing to do.
     }
 
+    /// @brief Construct a new ordered map from a range of `<key,value>` pairs.
+    /// @details The elements keep the order of the range. The index is built
+    /// bottom-up, from the keys sorted in one go, rather than by inserting
+    /// them one at a time.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt>
+    ordered_multimap_t(InputIt first, InputIt last)
+        : list(first, last)
+        , table()
+    {
+        this->build_index();
+    }
+
     /// @brief Copy constructor.
     /// @param other a reference to the map to copy.
     /// @details I had to define one, otherwise copying this map will screw up
     /// the copy of the iterators contained inside the `std::map`. That is why,
-    /// here I copy each individual element of the list and store the iterator,
-    /// again.
+    /// here I copy the list, and build the index again from its iterators.
     ordered_multimap_t(const ordered_multimap_t &other)
-        : list()
+        : list(other.list)
         , table()
     {
-        for (const auto &entry : other.list) {
-            table.insert({entry.first, list.insert(list.end(), entry)});
-        }
+        this->build_index();
     }
 
     /// @brief Move constructor.
@@ -256,20 +545,82 @@ public:
         return next;
     }
 
+    /// @brief Erases all the elements whose key is in the given range of keys.
+    /// @details The keys are sorted, then the index is walked once, side by
+    /// side with them, instead of being searched from the root for each key.
+    /// @tparam InputIt the type of iterator, over keys.
+    /// @param first the first key.
+    /// @param last the end of the keys.
+    /// @return the number of elements removed.
+    template <typename InputIt> auto erase_many(InputIt first, InputIt last) -> std::size_t
+    {
+        std::vector<Key> keys(first, last);
+        std::sort(keys.begin(), keys.end());
+        auto equal = [](const Key &lhs, const Key &rhs) { return !(lhs < rhs) && !(rhs < lhs); };
+        keys.erase(std::unique(keys.begin(), keys.end(), equal), keys.end());
+        std::size_t removed = 0;
+        detail::erase_many(
+            table, keys.cbegin(), keys.cend(),
+            [this, &removed](const Key &, iterator handle) {
+                list.erase(handle);
+                ++removed;
+                return true;
+            },
+            0);
+        return removed;
+    }
+
     /// @brief Erases the elment from the list, and returns an iteator to the
     /// same position in the list (i.e., the elment after the one removed).
+    /// @details When several elements share the key, the index entry pointing
+    /// to the given element is the one removed.
     /// @param it_list the iterator of the element to remove.
     /// @return an iterator to the same position in the list.
     auto erase(iterator it_list) -> iterator
     {
-        table_iterator it_table = table.find(it_list->first);
-        if (it_table == table.end()) {
-            return list.end();
+        auto range = table.equal_range(it_list->first);
+        for (table_iterator it_table = range.first; it_table != range.second; ++it_table) {
+            if (it_table->second == it_list) {
+                table.erase(it_table);
+                return list.erase(it_list);
+            }
         }
-        ++it_list;
-        list.erase(it_table->second);
-        table.erase(it_table);
-        return it_list;
+        return list.end();
+    }
+
+    /// @brief Erases the elements in the given range of the list.
+    /// @details The index entries of the elements are removed in a single
+    /// walk of the index, see `erase_if`.
+    /// @param first the first element to remove.
+    /// @param last the element after the last one to remove.
+    /// @return an iterator to the same position in the list, i.e., `last`.
+    auto erase(iterator first, iterator last) -> iterator
+    {
+        std::vector<std::pair<Key, iterator>> handles;
+        for (; first != last; ++first) {
+            handles.emplace_back(first->first, first);
+        }
+        this->erase_handles(handles);
+        return last;
+    }
+
+    /// @brief Erases the elements satisfying the predicate.
+    /// @details The list is walked once, calling the predicate on each element
+    /// in insertion order; the index entries of the matching elements, exactly
+    /// those and not others with the same key, are then removed in a single
+    /// walk of the index, and the elements unlinked.
+    /// @param predicate a callable accepting a `const list_entry_t &`.
+    /// @return the number of elements removed.
+    template <typename Predicate> auto erase_if(Predicate predicate) -> std::size_t
+    {
+        std::vector<std::pair<Key, iterator>> handles;
+        for (iterator it = list.begin(); it != list.end(); ++it) {
+            const list_entry_t &entry = *it;
+            if (predicate(entry)) {
+                handles.emplace_back(entry.first, it);
+            }
+        }
+        return this->erase_handles(handles);
     }
 
     /// @brief Erases a single element that matches the given key and value.
@@ -347,6 +698,45 @@ public:
         return itr->second;
     }
 
+    /// @brief Finds the first element of each key of a range, as `find` does.
+    /// @details Indices which support it (`btree_index_t`, and
+    /// `eytzinger_index_t` once optimized for reads) search the keys in
+    /// groups, interleaving their descents, which overlaps the cache misses
+    /// of lookups in maps larger than the cache. The others search each key
+    /// in turn.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param out receives an iterator for each key, in the order of the keys:
+    /// the first element with the key, or the end of the list.
+    /// @return the output iterator, past the last result.
+    template <typename ForwardIt, typename OutputIt> auto find_many(ForwardIt first, ForwardIt last, OutputIt out) -> OutputIt
+    {
+        table_iterator table_end = table.end();
+        iterator list_end        = list.end();
+        detail::find_many(
+            table, first, last, [&out, &table_end, &list_end](table_iterator it) { *out++ = it == table_end ? list_end : it->second; },
+            0);
+        return out;
+    }
+
+    /// @brief Finds the first element of each key of a range, as `find` does.
+    /// @param first the beginning of the keys.
+    /// @param last the end of the keys.
+    /// @param out receives an iterator for each key, in the order of the keys:
+    /// the first element with the key, or the end of the list.
+    /// @return the output iterator, past the last result.
+    template <typename ForwardIt, typename OutputIt>
+    auto find_many(ForwardIt first, ForwardIt last, OutputIt out) const -> OutputIt
+    {
+        table_const_iterator table_end = table.end();
+        const_iterator list_end        = list.end();
+        detail::find_many(
+            table, first, last,
+            [&out, &table_end, &list_end](table_const_iterator it) { *out++ = it == table_end ? list_end : const_iterator(it->second); },
+            0);
+        return out;
+    }
+
     /// @brief Checks whether at least one element with the given key exists.
     /// @details This function is a shorthand for `find(key) != end()`. It is
     /// useful for making code more expressive and readable.
@@ -356,20 +746,106 @@ public:
 
     /// @brief Counts the number of elements associated with the given key.
     /// @details This function returns how many entries in the map match the
-    /// given key. It uses the internal multimap to retrieve the range
-    /// efficiently.
+    /// given key. It asks the index, which some index policies answer without
+    /// visiting the entries.
     /// @param key The key to count occurrences for.
     /// @return The number of elements associated with the key.
-    auto count(const Key &key) const -> std::size_t
-    {
-        auto range = table.equal_range(key);
-        return static_cast<std::size_t>(std::distance(range.first, range.second));
-    }
+    auto count(const Key &key) const -> std::size_t { return table.count(key); }
 
     /// @brief Sorts the internal list.
     /// @param fun the sorting function.
     void sort(const sort_function_t &fun) { list.sort(fun); }
 
+    /// @brief Turns the index into its read-optimized layout, if it has one.
+    /// @details With `eytzinger_index_t`, the index becomes a sorted array
+    /// searched through an Eytzinger layout, until the next insertion or
+    /// removal, which moves it back into a tree. Other indices are unchanged.
+    /// Iterators over the list remain valid, those in key order do not.
+    void optimize_for_reads() { detail::optimize_for_reads(table, 0); }
+
+    /// @brief Returns the first element, in key order, whose key is not less
+    /// than the given one.
+    /// @param key the key.
+    /// @return an iterator in key order, `by_key().end()` if there is none.
+    auto lower_bound(const Key &key) -> key_iterator { return key_iterator(table.lower_bound(key)); }
+
+    /// @brief Returns the first element, in key order, whose key is not less
+    /// than the given one.
+    /// @param key the key.
+    /// @return an iterator in key order, `by_key().end()` if there is none.
+    auto lower_bound(const Key &key) const -> const_key_iterator { return const_key_iterator(table.lower_bound(key)); }
+
+    /// @brief Returns the first element, in key order, whose key is greater
+    /// than the given one.
+    /// @param key the key.
+    /// @return an iterator in key order, `by_key().end()` if there is none.
+    auto upper_bound(const Key &key) -> key_iterator { return key_iterator(table.upper_bound(key)); }
+
+    /// @brief Returns the first element, in key order, whose key is greater
+    /// than the given one.
+    /// @param key the key.
+    /// @return an iterator in key order, `by_key().end()` if there is none.
+    auto upper_bound(const Key &key) const -> const_key_iterator { return const_key_iterator(table.upper_bound(key)); }
+
+    /// @brief Returns the elements whose key is in [lo, hi), in key order,
+    /// entries with the same key in insertion order.
+    /// @param lo the smallest key of the range.
+    /// @param hi the first key past the range.
+    /// @return the range of elements, empty if `hi` is not greater than `lo`.
+    auto key_range(const Key &lo, const Key &hi) -> iterator_range_t<key_iterator>
+    {
+        table_iterator first = table.lower_bound(lo);
+        return {key_iterator(first), key_iterator(lo < hi ? table.lower_bound(hi) : first)};
+    }
+
+    /// @brief Returns the elements whose key is in [lo, hi), in key order,
+    /// entries with the same key in insertion order.
+    /// @param lo the smallest key of the range.
+    /// @param hi the first key past the range.
+    /// @return the range of elements, empty if `hi` is not greater than `lo`.
+    auto key_range(const Key &lo, const Key &hi) const -> iterator_range_t<const_key_iterator>
+    {
+        table_const_iterator first = table.lower_bound(lo);
+        return {const_key_iterator(first), const_key_iterator(lo < hi ? table.lower_bound(hi) : first)};
+    }
+
+    /// @brief Returns all the elements in key order, entries with the same
+    /// key in insertion order, without copying or sorting them.
+    /// @return the range of elements, iterated in key order.
+    auto by_key() -> iterator_range_t<key_iterator> { return {key_iterator(table.begin()), key_iterator(table.end())}; }
+
+    /// @brief Returns all the elements in key order, entries with the same
+    /// key in insertion order, without copying or sorting them.
+    /// @return the range of elements, iterated in key order.
+    auto by_key() const -> iterator_range_t<const_key_iterator>
+    {
+        return {const_key_iterator(table.begin()), const_key_iterator(table.end())};
+    }
+
+    /// @brief Returns the elements whose key starts with the given prefix, in
+    /// key order, entries with the same key in insertion order.
+    /// @details Requires string keys. The default index finds the range with
+    /// two binary searches, `radix_index_t` walks the prefix alone.
+    /// @param prefix the prefix of the keys.
+    /// @return the range of matching elements, iterated in key order.
+    auto prefix_range(const Key &prefix) -> iterator_range_t<key_iterator>
+    {
+        auto range = detail::prefix_bounds(table, prefix, 0);
+        return {key_iterator(range.first), key_iterator(range.second)};
+    }
+
+    /// @brief Returns the elements whose key starts with the given prefix, in
+    /// key order, entries with the same key in insertion order.
+    /// @details Requires string keys. The default index finds the range with
+    /// two binary searches, `radix_index_t` walks the prefix alone.
+    /// @param prefix the prefix of the keys.
+    /// @return the range of matching elements, iterated in key order.
+    auto prefix_range(const Key &prefix) const -> iterator_range_t<const_key_iterator>
+    {
+        auto range = detail::prefix_bounds(table, prefix, 0);
+        return {const_key_iterator(range.first), const_key_iterator(range.second)};
+    }
+
     /// @brief Returns a range of iterators to the elements with the given key.
     /// @details This function allows traversal over all elements that match the
     /// given key, preserving their insertion order.
@@ -409,13 +885,28 @@ public:
     /// @brief Merges the contents of another ordered_multimap_t into this one.
     /// @details All elements from the other map are inserted at the end of this
     /// map. The other map is cleared after the operation. Insertion order is
-    /// preserved.
+    /// preserved. The nodes of the other list are spliced, not copied, hence
+    /// iterators to the elements of the other map remain valid, and now refer
+    /// to this map; the same holds for its index entries, which are inserted
+    /// in a single sorted batch.
     /// @param other The other ordered_multimap_t to merge (rvalue).
     void merge(ordered_multimap_t &&other)
     {
-        for (auto it = other.list.begin(); it != other.list.end(); ++it) {
-            iterator new_it = list.insert(list.end(), std::move(*it));
-            table.insert(std::make_pair(new_it->first, new_it));
+        if (this == &other) {
+            return;
+        }
+        list.splice(list.end(), other.list);
+        if (other.table.size() < table.size() / 4U) {
+            table.insert(other.table.begin(), other.table.end());
+        } else {
+            // Both indices are sorted, merging them into a new one is linear,
+            // and cheaper than one lookup per element when they are similar
+            // in size. Ties keep the entries of this map first.
+            table_t merged;
+            std::merge(
+                table.begin(), table.end(), other.table.begin(), other.table.end(), std::inserter(merged, merged.end()),
+                table.value_comp());
+            table.swap(merged);
         }
         other.clear();
     }
@@ -437,33 +928,163 @@ public:
         return result;
     }
 
+    /// @brief Writes the map to a stream, in a compact binary format.
+    /// @details The format starts with a small header and the number of
+    /// entries, followed by the entries in insertion order. Sizes are stored
+    /// as varints, keys and values are written by `codec<Key>` and
+    /// `codec<Value>`, which can be specialized for user-defined types.
+    /// @param os the output stream.
+    /// @return true if the stream is still good after writing.
+    auto save(std::ostream &os) const -> bool { return ordered_multimap_t::save(os, list.begin(), list.end(), list.size()); }
+
+    /// @brief Writes a sequence of entries in the format of `save`, hence
+    /// they can be read back with `load`.
+    /// @details This allows to save a copy of the entries, without building a
+    /// map out of them.
+    /// @tparam InputIt the type of iterator, over `<key,value>` pairs.
+    /// @param os the output stream.
+    /// @param first the first entry.
+    /// @param last the end of the entries.
+    /// @param count the number of entries in the range.
+    /// @return true if the stream is still good after writing.
+    template <typename InputIt> static auto save(std::ostream &os, InputIt first, InputIt last, std::size_t count) -> bool
+    {
+        os.write(binary_magic, sizeof(binary_magic));
+        write_varint(os, count);
+        for (; first != last; ++first) {
+            codec<Key>::write(os, first->first);
+            codec<Value>::write(os, first->second);
+        }
+        return static_cast<bool>(os);
+    }
+
+    /// @brief Replaces the content of the map with the one read from a stream.
+    /// @details Entries are decoded straight into the list, and the index is
+    /// built once all of them are loaded, without intermediate copies. If the
+    /// stream is malformed or truncated the map is left empty.
+    /// @param is the input stream, written by `save`.
+    /// @return true on success, false otherwise.
+    auto load(std::istream &is) -> bool
+    {
+        this->clear();
+        char magic[sizeof(binary_magic)] = {};
+        is.read(magic, sizeof(magic));
+        if (!is || !std::equal(magic, magic + sizeof(magic), binary_magic)) {
+            return false;
+        }
+        std::uint64_t count = read_varint(is);
+        for (std::uint64_t index = 0; is && index < count; ++index) {
+            Key key = codec<Key>::read(is);
+            list.emplace_back(std::move(key), codec<Value>::read(is));
+        }
+        if (!is) {
+            list.clear();
+            return false;
+        }
+        this->build_index();
+        return true;
+    }
+
     /// @brief Assign operator.
     /// @details I had to define one, otherwise copying this map will screw up
     /// the copy of the iterators contained inside the `std::map`. That is why,
-    /// here I copy each individual element of the list and store the iterator,
-    /// again.
+    /// here I copy the list, and build the index again from its iterators.
     /// @param other a reference to the map to copy.
     /// @return a reference to the current map.
     auto operator=(const ordered_multimap_t &other) -> ordered_multimap_t &
     {
         if (this != &other) {
-            this->clear();
-            for (const auto &entry : other.list) {
-                table.insert({entry.first, list.insert(list.end(), entry)});
-            }
+            list = other.list;
+            this->build_index();
         }
         return *this;
     }
 
 private:
-    /// @brief Type of the map.
-    using table_t              = std::multimap<Key, iterator>;
-    using table_iterator       = typename table_t::iterator;
-    using table_const_iterator = typename table_t::const_iterator;
+    /// @brief Rebuilds the index from the content of the list.
+    /// @details The handles are sorted by key, stably, so that duplicates keep
+    /// their insertion order, then appended to the index with an end hint,
+    /// which takes amortized constant time per element.
+    void build_index()
+    {
+        std::vector<iterator> handles;
+        handles.reserve(list.size());
+        for (iterator it = list.begin(); it != list.end(); ++it) {
+            handles.push_back(it);
+        }
+        std::stable_sort(handles.begin(), handles.end(), [](const iterator &lhs, const iterator &rhs) {
+            return lhs->first < rhs->first;
+        });
+        table.clear();
+        for (const iterator &handle : handles) {
+            table.insert(table.end(), std::make_pair(handle->first, handle));
+        }
+    }
+
+    /// @brief Removes the given elements, and their index entries.
+    /// @details The elements are sorted by key, and, among those with the same
+    /// key, by address, so that the walk of the index tells the entries of the
+    /// elements from the others with the same key by a binary search. Keys are
+    /// copied next to the handles, the sort does not visit the elements.
+    /// @param handles the keys and the elements, without repetitions, in
+    /// insertion order, which is also the one of their removal from the list.
+    /// @return the number of elements removed.
+    auto erase_handles(std::vector<std::pair<Key, iterator>> &handles) -> std::size_t
+    {
+        using handle_t = std::pair<Key, iterator>;
+        std::vector<iterator> elements;
+        elements.reserve(handles.size());
+        for (const handle_t &handle : handles) {
+            elements.push_back(handle.second);
+        }
+        auto by_address = [](const iterator &lhs, const iterator &rhs) {
+            return std::less<const list_entry_t *>()(&*lhs, &*rhs);
+        };
+        std::sort(handles.begin(), handles.end(), [&by_address](const handle_t &lhs, const handle_t &rhs) {
+            return lhs.first < rhs.first || (!(rhs.first < lhs.first) && by_address(lhs.second, rhs.second));
+        });
+        // The distinct keys, and where the elements with each one begin.
+        std::vector<Key> keys;
+        std::vector<std::size_t> bounds;
+        for (std::size_t i = 0; i < handles.size(); ++i) {
+            if (keys.empty() || keys.back() < handles[i].first) {
+                keys.push_back(handles[i].first);
+                bounds.push_back(i);
+            }
+        }
+        bounds.push_back(handles.size());
+        std::size_t group = 0;
+        detail::erase_many(
+            table, keys.cbegin(), keys.cend(),
+            [&handles, &keys, &bounds, &group, &by_address](const Key &key, iterator handle) {
+                while (keys[group] < key) {
+                    ++group;
+                }
+                auto before = [&by_address](const handle_t &lhs, const iterator &rhs) {
+                    return by_address(lhs.second, rhs);
+                };
+                auto begin  = handles.begin() + static_cast<std::ptrdiff_t>(bounds[group]);
+                auto end    = handles.begin() + static_cast<std::ptrdiff_t>(bounds[group + 1U]);
+                auto it     = std::lower_bound(begin, end, handle, before);
+                return it != end && it->second == handle;
+            },
+            0);
+        for (const iterator &element : elements) {
+            list.erase(element);
+        }
+        return elements.size();
+    }
+
+    /// @brief The header of the binary format, the last byte is its version.
+    static constexpr char binary_magic[4] = {'O', 'M', 'M', 1};
+
     /// @brief The list containing the actual data.
     list_t list;
     /// @brief A table for easy access to the data by using a key.
     table_t table;
 };
 
+template <typename Key, typename Value, typename Index>
+constexpr char ordered_multimap_t<Key, Value, Index>::binary_magic[4];
+
 } // namespace ordered_multimap
@@ -0,0 +1,490 @@
+/// @file parallel.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Parallel bulk operations over the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief A small work-stealing thread pool.
+/// @details Every worker owns a queue, it pops tasks from the back of its own
+/// queue and, when that is empty, steals from the front of the others. The
+/// thread waiting for a batch of tasks helps executing them, so batches can be
+/// nested without deadlocks.
+class thread_pool_t
+{
+public:
+    /// @brief Construct a new pool.
+    /// @param threads the number of workers, zero means one per hardware
+    /// thread.
+    explicit thread_pool_t(std::size_t threads = 0)
+        : queues()
+        , workers()
+        , mutex()
+        , wakeup()
+        , queued(0)
+        , next_queue(0)
+        , stop(false)
+    {
+        if (threads == 0) {
+            threads = std::max<std::size_t>(1U, std::thread::hardware_concurrency());
+        }
+        for (std::size_t index = 0; index < threads; ++index) {
+            queues.emplace_back(new queue_t());
+        }
+        for (std::size_t index = 0; index < threads; ++index) {
+            workers.emplace_back(&thread_pool_t::work, this, index);
+        }
+    }
+
+    /// @brief Workers keep a pointer to the pool, it cannot be copied.
+    thread_pool_t(const thread_pool_t &) = delete;
+
+    /// @brief Workers keep a pointer to the pool, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const thread_pool_t &) -> thread_pool_t & = delete;
+
+    /// @brief Stops and joins all the workers.
+    ~thread_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stop = true;
+        }
+        wakeup.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    /// @brief Returns the number of workers.
+    /// @return the number of workers.
+    auto size() const -> std::size_t { return workers.size(); }
+
+    /// @brief Runs `function(index)` for every index in `[0, tasks)`, and
+    /// waits for all of them to complete.
+    /// @details If one or more tasks throw, the first exception is rethrown
+    /// once all the tasks are done.
+    /// @tparam Function the type of the function.
+    /// @param tasks the number of tasks.
+    /// @param function a callable accepting the index of the task.
+    template <typename Function> void parallel_for(std::size_t tasks, const Function &function)
+    {
+        if (tasks == 0) {
+            return;
+        }
+        std::shared_ptr<batch_t> batch(new batch_t(tasks));
+        for (std::size_t index = 0; index < tasks; ++index) {
+            this->push([batch, &function, index]() {
+                try {
+                    function(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(batch->mutex);
+                    if (!batch->error) {
+                        batch->error = std::current_exception();
+                    }
+                }
+                if (batch->remaining.fetch_sub(1U, std::memory_order_acq_rel) == 1U) {
+                    std::lock_guard<std::mutex> guard(batch->mutex);
+                    batch->done.notify_all();
+                }
+            });
+        }
+        // Help the workers, instead of just waiting for them.
+        task_t task;
+        while (batch->remaining.load(std::memory_order_acquire) != 0) {
+            if (this->pop(0, task)) {
+                task();
+            } else {
+                std::unique_lock<std::mutex> lock(batch->mutex);
+                batch->done.wait(lock, [&batch]() { return batch->remaining.load(std::memory_order_acquire) == 0; });
+            }
+        }
+        if (batch->error) {
+            std::rethrow_exception(batch->error);
+        }
+    }
+
+private:
+    /// @brief The type of a task.
+    using task_t = std::function<void()>;
+
+    /// @brief The queue of a worker.
+    struct queue_t {
+        /// @brief Protects the tasks.
+        std::mutex mutex;
+        /// @brief The tasks.
+        std::deque<task_t> tasks;
+    };
+
+    /// @brief Tracks the completion of a group of tasks.
+    struct batch_t {
+        /// @brief Construct a new batch.
+        /// @param tasks the number of tasks in the batch.
+        explicit batch_t(std::size_t tasks)
+            : remaining(tasks)
+            , mutex()
+            , done()
+            , error()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The number of tasks still running or queued.
+        std::atomic<std::size_t> remaining;
+        /// @brief Protects the error, and pairs with the condition variable.
+        std::mutex mutex;
+        /// @brief Signaled when the last task completes.
+        std::condition_variable done;
+        /// @brief The first exception thrown by a task.
+        std::exception_ptr error;
+    };
+
+    /// @brief Queues a task, distributing tasks among workers round-robin.
+    /// @param task the task.
+    void push(task_t task)
+    {
+        queue_t &queue = *queues[next_queue.fetch_add(1U, std::memory_order_relaxed) % queues.size()];
+        {
+            // Count the task first, so that the counter never underflows.
+            std::lock_guard<std::mutex> guard(mutex);
+            ++queued;
+        }
+        {
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        wakeup.notify_one();
+    }
+
+    /// @brief Takes a task, from the back of the given queue first, and then
+    /// from the front of the other queues.
+    /// @param index the queue to start from.
+    /// @param task where the task is stored.
+    /// @return true if a task was found.
+    auto pop(std::size_t index, task_t &task) -> bool
+    {
+        for (std::size_t offset = 0; offset < queues.size(); ++offset) {
+            queue_t &queue = *queues[(index + offset) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            std::lock_guard<std::mutex> pool_guard(mutex);
+            --queued;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief The loop of a worker.
+    /// @param index the index of the worker.
+    void work(std::size_t index)
+    {
+        task_t task;
+        while (true) {
+            if (this->pop(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stop || queued != 0; });
+            if (stop && queued == 0) {
+                return;
+            }
+        }
+    }
+
+    /// @brief The queues, one per worker.
+    std::vector<std::unique_ptr<queue_t>> queues;
+    /// @brief The workers.
+    std::vector<std::thread> workers;
+    /// @brief Protects the counter of queued tasks and the stop flag.
+    std::mutex mutex;
+    /// @brief Wakes up the idle workers.
+    std::condition_variable wakeup;
+    /// @brief The number of tasks waiting in the queues.
+    std::size_t queued;
+    /// @brief The queue receiving the next task.
+    std::atomic<std::size_t> next_queue;
+    /// @brief Tells the workers to terminate.
+    bool stop;
+};
+
+/// @brief Returns the pool used by the parallel algorithms by default.
+/// @return a pool with one worker per hardware thread.
+inline auto default_thread_pool() -> thread_pool_t &
+{
+    static thread_pool_t pool;
+    return pool;
+}
+
+namespace detail
+{
+
+/// @brief Returns the length of the chunks a sequence is split into.
+/// @details A few chunks per worker are created, so that faster workers can
+/// steal the remaining ones.
+/// @param size the length of the sequence.
+/// @param workers the number of workers.
+/// @return the length of every chunk, but the last one.
+inline auto chunk_length(std::size_t size, std::size_t workers) -> std::size_t
+{
+    return std::max<std::size_t>(1U, size / (workers * 4U));
+}
+
+/// @brief Splits the sequence of a map into contiguous chunks.
+/// @tparam Iterator the type of iterator.
+/// @param first the beginning of the sequence.
+/// @param last the end of the sequence.
+/// @param size the length of the sequence.
+/// @param workers the number of workers.
+/// @return the boundaries of the chunks, the last one being `last`.
+template <typename Iterator>
+auto split_chunks(Iterator first, Iterator last, std::size_t size, std::size_t workers) -> std::vector<Iterator>
+{
+    const std::size_t chunk = chunk_length(size, workers);
+    std::vector<Iterator> bounds;
+    bounds.reserve(size / chunk + 2U);
+    std::size_t position = 0;
+    for (Iterator it = first; it != last; ++it, ++position) {
+        if (position % chunk == 0) {
+            bounds.push_back(it);
+        }
+    }
+    bounds.push_back(last);
+    return bounds;
+}
+
+} // namespace detail
+
+/// @brief Calls `function(entry)` on every entry of the map, in parallel.
+/// @details The function must not modify the keys, and must be safe to call
+/// concurrently on different entries.
+/// @param pool the pool running the tasks.
+/// @param map the map.
+/// @param function a callable accepting a `list_entry_t &`.
+template <typename Key, typename Value, typename Index, typename Function>
+void parallel_for_each(thread_pool_t &pool, ordered_multimap_t<Key, Value, Index> &map, const Function &function)
+{
+    using iterator = typename ordered_multimap_t<Key, Value, Index>::iterator;
+    std::vector<iterator> bounds = detail::split_chunks(map.begin(), map.end(), map.size(), pool.size());
+    pool.parallel_for(bounds.size() - 1U, [&bounds, &function](std::size_t chunk) {
+        for (iterator it = bounds[chunk]; it != bounds[chunk + 1U]; ++it) {
+            function(*it);
+        }
+    });
+}
+
+/// @brief Calls `function(entry)` on every entry of the map, in parallel,
+/// using the default pool.
+/// @param map the map.
+/// @param function a callable accepting a `list_entry_t &`.
+template <typename Key, typename Value, typename Index, typename Function>
+void parallel_for_each(ordered_multimap_t<Key, Value, Index> &map, const Function &function)
+{
+    parallel_for_each(default_thread_pool(), map, function);
+}
+
+/// @brief Replaces every value of the map with `function(value)`, in parallel.
+/// @param pool the pool running the tasks.
+/// @param map the map.
+/// @param function a callable accepting a `const Value &` and returning the
+/// new value.
+template <typename Key, typename Value, typename Index, typename Function>
+void parallel_transform_values(thread_pool_t &pool, ordered_multimap_t<Key, Value, Index> &map, const Function &function)
+{
+    using entry_t = typename ordered_multimap_t<Key, Value, Index>::list_entry_t;
+    parallel_for_each(pool, map, [&function](entry_t &entry) { entry.second = function(entry.second); });
+}
+
+/// @brief Replaces every value of the map with `function(value)`, in parallel,
+/// using the default pool.
+/// @param map the map.
+/// @param function a callable accepting a `const Value &` and returning the
+/// new value.
+template <typename Key, typename Value, typename Index, typename Function>
+void parallel_transform_values(ordered_multimap_t<Key, Value, Index> &map, const Function &function)
+{
+    parallel_transform_values(default_thread_pool(), map, function);
+}
+
+/// @brief Counts the entries satisfying the predicate, in parallel.
+/// @param pool the pool running the tasks.
+/// @param map the map.
+/// @param predicate a callable accepting a `const list_entry_t &`.
+/// @return the number of entries satisfying the predicate.
+template <typename Key, typename Value, typename Index, typename Predicate>
+auto parallel_count_if(thread_pool_t &pool, const ordered_multimap_t<Key, Value, Index> &map, const Predicate &predicate)
+    -> std::size_t
+{
+    using const_iterator = typename ordered_multimap_t<Key, Value, Index>::const_iterator;
+    std::vector<const_iterator> bounds = detail::split_chunks(map.begin(), map.end(), map.size(), pool.size());
+    std::vector<std::size_t> counts(bounds.size() - 1U, 0U);
+    pool.parallel_for(counts.size(), [&bounds, &counts, &predicate](std::size_t chunk) {
+        std::size_t count = 0;
+        for (const_iterator it = bounds[chunk]; it != bounds[chunk + 1U]; ++it) {
+            if (predicate(*it)) {
+                ++count;
+            }
+        }
+        counts[chunk] = count;
+    });
+    std::size_t total = 0;
+    for (std::size_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+/// @brief Counts the entries satisfying the predicate, in parallel, using the
+/// default pool.
+/// @param map the map.
+/// @param predicate a callable accepting a `const list_entry_t &`.
+/// @return the number of entries satisfying the predicate.
+template <typename Key, typename Value, typename Index, typename Predicate>
+auto parallel_count_if(const ordered_multimap_t<Key, Value, Index> &map, const Predicate &predicate) -> std::size_t
+{
+    return parallel_count_if(default_thread_pool(), map, predicate);
+}
+
+/// @brief Erases the entries satisfying the predicate.
+/// @details The predicate is evaluated in parallel, then the matching entries
+/// are removed by `erase_if`, in a final sequential pass.
+/// @param pool the pool running the tasks.
+/// @param map the map.
+/// @param predicate a callable accepting a `const list_entry_t &`.
+/// @return the number of erased entries.
+template <typename Key, typename Value, typename Index, typename Predicate>
+auto parallel_erase_if(thread_pool_t &pool, ordered_multimap_t<Key, Value, Index> &map, const Predicate &predicate)
+    -> std::size_t
+{
+    using iterator = typename ordered_multimap_t<Key, Value, Index>::iterator;
+    using entry_t  = typename ordered_multimap_t<Key, Value, Index>::list_entry_t;
+    std::vector<iterator> bounds = detail::split_chunks(map.begin(), map.end(), map.size(), pool.size());
+    // Use a byte per entry, `std::vector<bool>` cannot be written concurrently.
+    std::vector<unsigned char> marks(map.size(), 0U);
+    const std::size_t chunk_size = detail::chunk_length(map.size(), pool.size());
+    pool.parallel_for(bounds.size() - 1U, [&bounds, &marks, &predicate, chunk_size](std::size_t chunk) {
+        std::size_t position = chunk * chunk_size;
+        for (iterator it = bounds[chunk]; it != bounds[chunk + 1U]; ++it, ++position) {
+            marks[position] = predicate(*it) ? 1U : 0U;
+        }
+    });
+    // The entries are visited in insertion order, as when they were marked.
+    std::size_t position = 0;
+    return map.erase_if([&marks, &position](const entry_t &) { return marks[position++] != 0U; });
+}
+
+/// @brief Erases the entries satisfying the predicate, using the default pool.
+/// @param map the map.
+/// @param predicate a callable accepting a `const list_entry_t &`.
+/// @return the number of erased entries.
+template <typename Key, typename Value, typename Index, typename Predicate>
+auto parallel_erase_if(ordered_multimap_t<Key, Value, Index> &map, const Predicate &predicate) -> std::size_t
+{
+    return parallel_erase_if(default_thread_pool(), map, predicate);
+}
+
+namespace detail
+{
+
+/// @brief The map built from a range of `<key,value>` pairs.
+/// @tparam Iterator the type of iterator.
+template <typename Iterator> struct map_of_range {
+    /// @brief The pairs of the range, their key might be const.
+    using pair_t = typename std::iterator_traits<Iterator>::value_type;
+    /// @brief The resulting map.
+    using type =
+        ordered_multimap_t<typename std::remove_const<typename pair_t::first_type>::type, typename pair_t::second_type>;
+};
+
+} // namespace detail
+
+/// @brief Builds a map from a large range of `<key,value>` pairs, in parallel.
+/// @details The range is split in chunks, and every chunk is turned into a
+/// map by a different task: list nodes are allocated, and the keys of the
+/// chunk sorted, in parallel. The chunk maps are then merged pairwise, in
+/// parallel as well, each merge splicing the lists and merging the sorted
+/// indices in linear time. The resulting map keeps the order of the range.
+/// @tparam Iterator a random access iterator to `<key,value>` pairs.
+/// @param pool the pool running the tasks.
+/// @param first the beginning of the range.
+/// @param last the end of the range.
+/// @return the new map.
+template <typename Iterator>
+auto build_parallel(thread_pool_t &pool, Iterator first, Iterator last) -> typename detail::map_of_range<Iterator>::type
+{
+    using map_t             = typename detail::map_of_range<Iterator>::type;
+    const std::size_t size  = static_cast<std::size_t>(std::distance(first, last));
+    const std::size_t chunk = std::max<std::size_t>(1U, (size + pool.size() - 1U) / pool.size());
+    const std::size_t count = (size + chunk - 1U) / chunk;
+    if (count <= 1U) {
+        return map_t(first, last);
+    }
+    std::vector<map_t> maps(count);
+    pool.parallel_for(count, [&maps, first, size, chunk](std::size_t index) {
+        Iterator begin = first + static_cast<std::ptrdiff_t>(index * chunk);
+        Iterator end   = first + static_cast<std::ptrdiff_t>(std::min(size, (index + 1U) * chunk));
+        maps[index]    = map_t(begin, end);
+    });
+    // Merge neighbours, doubling the distance at each round, so that the
+    // first map accumulates everything in the original order.
+    for (std::size_t stride = 1U; stride < count; stride *= 2U) {
+        const std::size_t pairs = (count + 2U * stride - 1U) / (2U * stride);
+        pool.parallel_for(pairs, [&maps, stride, count](std::size_t pair) {
+            const std::size_t target = pair * 2U * stride;
+            if (target + stride < count) {
+                maps[target].merge(std::move(maps[target + stride]));
+            }
+        });
+    }
+    return std::move(maps.front());
+}
+
+/// @brief Builds a map from a large range of `<key,value>` pairs, in parallel.
+/// @tparam Iterator a random access iterator to `<key,value>` pairs.
+/// @param first the beginning of the range.
+/// @param last the end of the range.
+/// @param threads the number of threads, zero means using the default pool.
+/// @return the new map.
+template <typename Iterator>
+auto build_parallel(Iterator first, Iterator last, std::size_t threads = 0)
+    -> typename detail::map_of_range<Iterator>::type
+{
+    if (threads == 0) {
+        return build_parallel(default_thread_pool(), first, last);
+    }
+    thread_pool_t pool(threads);
+    return build_parallel(pool, first, last);
+}
+
+} // namespace ordered_multimap
@@ -0,0 +1,986 @@
+/// @file radix_index.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An adaptive radix tree index, for string keys.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief A multimap from strings, stored in an adaptive radix tree.
+/// @details It implements the subset of the `std::multimap` interface used by
+/// `ordered_multimap_t`, plus `prefix_range`. Lookups follow the bytes of the
+/// key, one node per byte, and never compare whole keys: their cost depends on
+/// the length of the key, not on the number of keys. Chains of nodes with a
+/// single child are compressed into a prefix, and nodes grow from 4 to 16, 48,
+/// and 256 children as needed, which keeps the tree small on sparse bytes.
+/// The mapped values with the same key form a group, and groups are linked in
+/// key order, for iteration.
+/// @tparam Key the type of the key, `std::string`.
+/// @tparam Mapped the type of the mapped value.
+template <typename Key, typename Mapped> class radix_multimap_t
+{
+    static_assert(std::is_same<Key, std::string>::value, "The radix index requires std::string keys.");
+
+    /// @brief The mapped values with the same key, linked in key order.
+    struct group_t {
+        /// @brief The key.
+        Key key;
+        /// @brief The mapped values, in insertion order.
+        std::vector<Mapped> mapped;
+        /// @brief The group with the previous key.
+        group_t *previous;
+        /// @brief The group with the next key.
+        group_t *next;
+    };
+
+    /// @brief The kinds of node, by capacity.
+    enum kind_t : std::uint8_t {
+        leaf_kind,    ///< No children.
+        node4_kind,   ///< Up to 4 children, sorted.
+        node16_kind,  ///< Up to 16 children, sorted.
+        node48_kind,  ///< Up to 48 children, indexed by byte.
+        node256_kind, ///< One child per byte.
+    };
+
+    /// @brief The common part of the nodes.
+    struct node_t {
+        /// @brief The kind of node.
+        kind_t kind;
+        /// @brief The number of children.
+        std::uint16_t count;
+        /// @brief The bytes shared by all keys below the node, after the byte
+        /// leading to it.
+        std::string prefix;
+        /// @brief The group of the key ending at this node, if any.
+        group_t *group;
+    };
+
+    /// @brief A node with up to N children, whose bytes are sorted.
+    template <std::size_t N> struct small_node_t : node_t {
+        /// @brief The bytes of the children.
+        unsigned char bytes[N];
+        /// @brief The children.
+        node_t *children[N];
+    };
+
+    /// @brief A node with up to 48 children, indexed by byte.
+    struct node48_t : node_t {
+        /// @brief The position of the child of each byte, plus one, zero for none.
+        std::uint8_t index[256];
+        /// @brief The children.
+        node_t *children[48];
+    };
+
+    /// @brief A node with one child per byte.
+    struct node256_t : node_t {
+        /// @brief The children.
+        node_t *children[256];
+    };
+
+    /// @brief A node with up to 4 children.
+    using node4_t  = small_node_t<4>;
+    /// @brief A node with up to 16 children.
+    using node16_t = small_node_t<16>;
+
+public:
+    /// @brief The type of the entries, when copied out of the map.
+    using value_type = std::pair<Key, Mapped>;
+
+    /// @brief A reference to an entry, with the members of a `std::pair`.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename MappedReference> struct reference_t {
+        /// @brief The key.
+        const Key &first;
+        /// @brief The mapped value.
+        MappedReference second;
+
+        /// @brief Copies the entry.
+        /// @return a copy of the entry.
+        operator value_type() const { return value_type(first, second); }
+    };
+
+    /// @brief An iterator over the entries, in key order.
+    /// @tparam Group the type of the groups, const or not.
+    /// @tparam MappedReference the type of the reference to the mapped value.
+    template <typename Group, typename MappedReference> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = typename radix_multimap_t::value_type;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a reference to an entry.
+        using reference         = reference_t<MappedReference>;
+
+        /// @brief Provides `operator->` for the references.
+        struct pointer {
+            /// @brief The reference.
+            reference entry;
+
+            /// @brief Returns the reference.
+            /// @return a pointer to the reference.
+            auto operator->() -> reference * { return &entry; }
+        };
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : group(nullptr)
+            , position()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _group the group, null for the end.
+        /// @param _position the position inside the group.
+        basic_iterator(Group *_group, std::size_t _position)
+            : group(_group)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the mutable iterator.
+        template <typename OtherGroup, typename OtherReference>
+        basic_iterator(const basic_iterator<OtherGroup, OtherReference> &other)
+            : group(other.group)
+            , position(other.position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference { return reference{group->key, group->mapped[position]}; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return pointer{**this}; }
+
+        /// @brief Moves to the next entry, possibly in the next group.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            if (++position == group->mapped.size()) {
+                group    = group->next;
+                position = 0;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry, possibly in the next group.
+        /// @return a copy of this iterator, before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool
+        {
+            return group == other.group && position == other.position;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class radix_multimap_t;
+        template <typename, typename> friend class basic_iterator;
+
+        /// @brief The group.
+        Group *group;
+        /// @brief The position inside the group.
+        std::size_t position;
+    };
+
+    /// @brief Iterator over the entries.
+    using iterator       = basic_iterator<group_t, Mapped &>;
+    /// @brief Constant iterator over the entries.
+    using const_iterator = basic_iterator<const group_t, const Mapped &>;
+
+    /// @brief Compares the entries by key.
+    struct value_compare {
+        /// @brief Compares two entries.
+        /// @param lhs the first entry.
+        /// @param rhs the second entry.
+        /// @return true if the key of the first is less than the one of the second.
+        template <typename Lhs, typename Rhs> auto operator()(const Lhs &lhs, const Rhs &rhs) const -> bool
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    /// @brief Construct an empty map.
+    radix_multimap_t()
+        : root()
+        , head()
+        , entries()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The map is only copied through `ordered_multimap_t`, which
+    /// builds a new index.
+    radix_multimap_t(const radix_multimap_t &) = delete;
+
+    /// @brief Move constructor.
+    /// @param other the map to move from, left empty.
+    radix_multimap_t(radix_multimap_t &&other) noexcept
+        : radix_multimap_t()
+    {
+        this->swap(other);
+    }
+
+    /// @brief Destructor.
+    ~radix_multimap_t() { this->clear(); }
+
+    /// @brief The map is only copied through `ordered_multimap_t`, which
+    /// builds a new index.
+    /// @return nothing, this function is deleted.
+    auto operator=(const radix_multimap_t &) -> radix_multimap_t & = delete;
+
+    /// @brief Move assignment.
+    /// @param other the map to move from, left empty.
+    /// @return a reference to the current map.
+    auto operator=(radix_multimap_t &&other) noexcept -> radix_multimap_t &
+    {
+        if (this != &other) {
+            this->clear();
+            this->swap(other);
+        }
+        return *this;
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return entries; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return entries == 0; }
+
+    /// @brief Removes all the entries.
+    void clear()
+    {
+        destroy(root);
+        root    = nullptr;
+        head    = nullptr;
+        entries = 0;
+    }
+
+    /// @brief Exchanges the content of two maps.
+    /// @param other the other map.
+    void swap(radix_multimap_t &other)
+    {
+        std::swap(root, other.root);
+        std::swap(head, other.head);
+        std::swap(entries, other.entries);
+    }
+
+    /// @brief Returns the comparison of the entries.
+    /// @return the comparison.
+    auto value_comp() const -> value_compare { return value_compare(); }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() -> iterator { return iterator(head, 0); }
+
+    /// @brief Returns a constant iterator to the first entry.
+    /// @return an iterator to the first entry.
+    auto begin() const -> const_iterator { return const_iterator(head, 0); }
+
+    /// @brief Returns an iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() -> iterator { return iterator(nullptr, 0); }
+
+    /// @brief Returns a constant iterator past the last entry.
+    /// @return an iterator past the last entry.
+    auto end() const -> const_iterator { return const_iterator(nullptr, 0); }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const value_type &entry) -> iterator
+    {
+        group_t *group = this->find_group(entry.first);
+        if (group == nullptr) {
+            group = this->add_group(entry.first);
+        }
+        group->mapped.push_back(entry.second);
+        ++entries;
+        return iterator(group, group->mapped.size() - 1U);
+    }
+
+    /// @brief Inserts an entry, after those with the same key.
+    /// @details The position of the entry is given by its key, the hint is
+    /// ignored.
+    /// @param entry the entry.
+    /// @return an iterator to the new entry.
+    auto insert(const_iterator, const value_type &entry) -> iterator { return this->insert(entry); }
+
+    /// @brief Inserts a range of entries.
+    /// @tparam InputIt the type of iterator.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    template <typename InputIt> void insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first) {
+            this->insert(static_cast<value_type>(*first));
+        }
+    }
+
+    /// @brief Removes an entry.
+    /// @param position the entry.
+    /// @return an iterator to the entry which followed it.
+    auto erase(const_iterator position) -> iterator { return this->erase(position, std::next(position)); }
+
+    /// @brief Removes a range of entries.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @return an iterator to the entry which followed the range.
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        using difference_t   = typename std::vector<Mapped>::difference_type;
+        auto *group          = const_cast<group_t *>(first.group);
+        std::size_t position = first.position;
+        // Removes the tail of every group before the last one.
+        while (group != last.group) {
+            group_t *next = group->next;
+            entries -= group->mapped.size() - position;
+            group->mapped.erase(group->mapped.begin() + static_cast<difference_t>(position), group->mapped.end());
+            if (group->mapped.empty()) {
+                this->remove_group(group);
+            }
+            group    = next;
+            position = 0;
+        }
+        // The last iterator refers to an entry, which remains in its group.
+        if (position < last.position) {
+            entries -= last.position - position;
+            group->mapped.erase(
+                group->mapped.begin() + static_cast<difference_t>(position),
+                group->mapped.begin() + static_cast<difference_t>(last.position));
+        }
+        return iterator(group, position);
+    }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) -> iterator { return iterator(this->find_group(key), 0); }
+
+    /// @brief Returns the first entry with the given key.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto find(const Key &key) const -> const_iterator { return const_iterator(this->find_group(key), 0); }
+
+    /// @brief Counts the entries with the given key.
+    /// @param key the key.
+    /// @return the number of entries.
+    auto count(const Key &key) const -> std::size_t
+    {
+        const group_t *group = this->find_group(key);
+        return group != nullptr ? group->mapped.size() : 0U;
+    }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) -> iterator { return iterator(this->lower_group(key), 0); }
+
+    /// @brief Returns the first entry whose key is not less than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto lower_bound(const Key &key) const -> const_iterator { return const_iterator(this->lower_group(key), 0); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) -> iterator { return iterator(this->upper_group(key), 0); }
+
+    /// @brief Returns the first entry whose key is greater than the given one.
+    /// @param key the key.
+    /// @return an iterator to the entry, or the end if not found.
+    auto upper_bound(const Key &key) const -> const_iterator { return const_iterator(this->upper_group(key), 0); }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) -> std::pair<iterator, iterator>
+    {
+        group_t *group = this->find_group(key);
+        return std::make_pair(iterator(group, 0), iterator(group != nullptr ? group->next : nullptr, 0));
+    }
+
+    /// @brief Returns the range of entries with the given key.
+    /// @param key the key.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto equal_range(const Key &key) const -> std::pair<const_iterator, const_iterator>
+    {
+        const group_t *group = this->find_group(key);
+        return std::make_pair(const_iterator(group, 0), const_iterator(group != nullptr ? group->next : nullptr, 0));
+    }
+
+    /// @brief Returns the range of entries whose key starts with the given
+    /// prefix, found by following the bytes of the prefix alone.
+    /// @param prefix the prefix.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto prefix_range(const Key &prefix) -> std::pair<iterator, iterator>
+    {
+        std::pair<group_t *, group_t *> range = this->prefix_groups(prefix);
+        return std::make_pair(iterator(range.first, 0), iterator(range.second, 0));
+    }
+
+    /// @brief Returns the range of entries whose key starts with the given
+    /// prefix, found by following the bytes of the prefix alone.
+    /// @param prefix the prefix.
+    /// @return a pair of iterators [begin, end) over the entries.
+    auto prefix_range(const Key &prefix) const -> std::pair<const_iterator, const_iterator>
+    {
+        std::pair<group_t *, group_t *> range = this->prefix_groups(prefix);
+        return std::make_pair(const_iterator(range.first, 0), const_iterator(range.second, 0));
+    }
+
+private:
+    /// @brief Returns the byte of a key, as an unsigned value.
+    /// @param key the key.
+    /// @param depth the position of the byte.
+    /// @return the byte.
+    static auto byte_at(const Key &key, std::size_t depth) -> unsigned char
+    {
+        return static_cast<unsigned char>(key[depth]);
+    }
+
+    /// @brief Returns the bytes of the children of a node with up to 16 children.
+    /// @param node the node.
+    /// @return the bytes.
+    static auto small_bytes(node_t *node) -> unsigned char *
+    {
+        return node->kind == node4_kind ? static_cast<node4_t *>(node)->bytes : static_cast<node16_t *>(node)->bytes;
+    }
+
+    /// @brief Returns the children of a node with up to 16 children.
+    /// @param node the node.
+    /// @return the children.
+    static auto small_children(node_t *node) -> node_t **
+    {
+        return node->kind == node4_kind ? static_cast<node4_t *>(node)->children : static_cast<node16_t *>(node)->children;
+    }
+
+    /// @brief Returns the slot holding the child with the given byte.
+    /// @param node the node.
+    /// @param byte the byte.
+    /// @return a pointer to the slot, null if there is no such child.
+    static auto child_slot(node_t *node, unsigned char byte) -> node_t **
+    {
+        switch (node->kind) {
+        case node4_kind:
+        case node16_kind: {
+            const unsigned char *bytes = small_bytes(node);
+            node_t **children          = small_children(node);
+            for (std::size_t i = 0; i < node->count; ++i) {
+                if (bytes[i] == byte) {
+                    return &children[i];
+                }
+            }
+            return nullptr;
+        }
+        case node48_kind: {
+            auto *wide = static_cast<node48_t *>(node);
+            return wide->index[byte] != 0U ? &wide->children[wide->index[byte] - 1U] : nullptr;
+        }
+        case node256_kind: {
+            auto *full = static_cast<node256_t *>(node);
+            return full->children[byte] != nullptr ? &full->children[byte] : nullptr;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    /// @brief Returns the child with the smallest byte not less than the given one.
+    /// @param node the node.
+    /// @param from the smallest byte to consider, up to 256.
+    /// @param byte set to the byte of the child, if found.
+    /// @return the child, null if there is none.
+    static auto next_child(const node_t *node, std::size_t from, unsigned char *byte = nullptr) -> node_t *
+    {
+        switch (node->kind) {
+        case node4_kind:
+        case node16_kind: {
+            const unsigned char *bytes = small_bytes(const_cast<node_t *>(node));
+            node_t **children          = small_children(const_cast<node_t *>(node));
+            for (std::size_t i = 0; i < node->count; ++i) {
+                if (bytes[i] >= from) {
+                    if (byte != nullptr) {
+                        *byte = bytes[i];
+                    }
+                    return children[i];
+                }
+            }
+            return nullptr;
+        }
+        case node48_kind: {
+            const auto *wide = static_cast<const node48_t *>(node);
+            for (std::size_t b = from; b < 256U; ++b) {
+                if (wide->index[b] != 0U) {
+                    if (byte != nullptr) {
+                        *byte = static_cast<unsigned char>(b);
+                    }
+                    return wide->children[wide->index[b] - 1U];
+                }
+            }
+            return nullptr;
+        }
+        case node256_kind: {
+            const auto *full = static_cast<const node256_t *>(node);
+            for (std::size_t b = from; b < 256U; ++b) {
+                if (full->children[b] != nullptr) {
+                    if (byte != nullptr) {
+                        *byte = static_cast<unsigned char>(b);
+                    }
+                    return full->children[b];
+                }
+            }
+            return nullptr;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    /// @brief Returns the child with the greatest byte.
+    /// @param node the node.
+    /// @return the child, null if there is none.
+    static auto last_child(const node_t *node) -> node_t *
+    {
+        switch (node->kind) {
+        case node4_kind:
+        case node16_kind: return node->count > 0U ? small_children(const_cast<node_t *>(node))[node->count - 1U] : nullptr;
+        case node48_kind: {
+            const auto *wide = static_cast<const node48_t *>(node);
+            for (std::size_t b = 256U; b-- > 0U;) {
+                if (wide->index[b] != 0U) {
+                    return wide->children[wide->index[b] - 1U];
+                }
+            }
+            return nullptr;
+        }
+        case node256_kind: {
+            const auto *full = static_cast<const node256_t *>(node);
+            for (std::size_t b = 256U; b-- > 0U;) {
+                if (full->children[b] != nullptr) {
+                    return full->children[b];
+                }
+            }
+            return nullptr;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    /// @brief Returns the group with the smallest key below the node.
+    /// @param node the node.
+    /// @return the group.
+    static auto min_group(const node_t *node) -> group_t *
+    {
+        // Nodes without a group have children, the first leads to the smallest key.
+        for (const node_t *child = nullptr; node->group == nullptr && (child = next_child(node, 0)) != nullptr;) {
+            node = child;
+        }
+        return node->group;
+    }
+
+    /// @brief Returns the group with the greatest key below the node.
+    /// @details The key ending at a node is less than those of its children.
+    /// @param node the node.
+    /// @return the group.
+    static auto max_group(const node_t *node) -> group_t *
+    {
+        for (const node_t *child = last_child(node); child != nullptr; child = last_child(node)) {
+            node = child;
+        }
+        return node->group;
+    }
+
+    /// @brief Returns the group following all the keys below the node.
+    /// @param node the node.
+    /// @return the group, null if there is none.
+    static auto after(const node_t *node) -> group_t * { return max_group(node)->next; }
+
+    /// @brief Allocates a node.
+    /// @param kind the kind of node.
+    /// @param prefix the prefix of the node.
+    /// @return the node.
+    static auto make_node(kind_t kind, const std::string &prefix) -> node_t *
+    {
+        node_t *node = nullptr;
+        switch (kind) {
+        case node4_kind: node = new node4_t(); break;
+        case node16_kind: node = new node16_t(); break;
+        case node48_kind: node = new node48_t(); break;
+        case node256_kind: node = new node256_t(); break;
+        default: node = new node_t(); break;
+        }
+        node->kind   = kind;
+        node->prefix = prefix;
+        return node;
+    }
+
+    /// @brief Releases a node, without its children.
+    /// @param node the node.
+    static void free_node(node_t *node)
+    {
+        switch (node->kind) {
+        case node4_kind: delete static_cast<node4_t *>(node); break;
+        case node16_kind: delete static_cast<node16_t *>(node); break;
+        case node48_kind: delete static_cast<node48_t *>(node); break;
+        case node256_kind: delete static_cast<node256_t *>(node); break;
+        default: delete node; break;
+        }
+    }
+
+    /// @brief Releases a node, its children, and their groups.
+    /// @param node the node, possibly null.
+    static void destroy(node_t *node)
+    {
+        if (node == nullptr) {
+            return;
+        }
+        unsigned char byte = 0;
+        for (node_t *child = next_child(node, 0, &byte); child != nullptr; child = next_child(node, byte + 1U, &byte)) {
+            destroy(child);
+        }
+        delete node->group;
+        free_node(node);
+    }
+
+    /// @brief Adds a child to a node, replacing the node with a larger one if
+    /// it is full.
+    /// @param slot the slot holding the node.
+    /// @param byte the byte of the child.
+    /// @param child the child.
+    static void add_child(node_t **slot, unsigned char byte, node_t *child)
+    {
+        node_t *node = *slot;
+        if (node->kind == leaf_kind || (node->kind == node4_kind && node->count == 4U) ||
+            (node->kind == node16_kind && node->count == 16U) || (node->kind == node48_kind && node->count == 48U)) {
+            node_t *larger = make_node(static_cast<kind_t>(node->kind + 1U), std::string());
+            larger->prefix.swap(node->prefix);
+            larger->group = node->group;
+            unsigned char moved = 0;
+            for (node_t *other = next_child(node, 0, &moved); other != nullptr; other = next_child(node, moved + 1U, &moved)) {
+                add_child(&larger, moved, other);
+            }
+            free_node(node);
+            *slot = node = larger;
+        }
+        switch (node->kind) {
+        case node4_kind:
+        case node16_kind: {
+            unsigned char *bytes = small_bytes(node);
+            node_t **children    = small_children(node);
+            std::size_t position = node->count;
+            while (position > 0U && bytes[position - 1U] > byte) {
+                bytes[position]    = bytes[position - 1U];
+                children[position] = children[position - 1U];
+                --position;
+            }
+            bytes[position]    = byte;
+            children[position] = child;
+            break;
+        }
+        case node48_kind: {
+            auto *wide        = static_cast<node48_t *>(node);
+            std::size_t empty = 0;
+            while (wide->children[empty] != nullptr) {
+                ++empty;
+            }
+            wide->children[empty] = child;
+            wide->index[byte]     = static_cast<std::uint8_t>(empty + 1U);
+            break;
+        }
+        default: static_cast<node256_t *>(node)->children[byte] = child; break;
+        }
+        ++node->count;
+    }
+
+    /// @brief Removes the child with the given byte from a node.
+    /// @param node the node.
+    /// @param byte the byte of the child.
+    static void remove_child(node_t *node, unsigned char byte)
+    {
+        switch (node->kind) {
+        case node4_kind:
+        case node16_kind: {
+            unsigned char *bytes = small_bytes(node);
+            node_t **children    = small_children(node);
+            std::size_t position = 0;
+            while (bytes[position] != byte) {
+                ++position;
+            }
+            for (; position + 1U < node->count; ++position) {
+                bytes[position]    = bytes[position + 1U];
+                children[position] = children[position + 1U];
+            }
+            break;
+        }
+        case node48_kind: {
+            auto *wide                             = static_cast<node48_t *>(node);
+            wide->children[wide->index[byte] - 1U] = nullptr;
+            wide->index[byte]                      = 0;
+            break;
+        }
+        default: static_cast<node256_t *>(node)->children[byte] = nullptr; break;
+        }
+        --node->count;
+    }
+
+    /// @brief Returns the length of the common part of the prefix of a node
+    /// and a key.
+    /// @param node the node.
+    /// @param key the key.
+    /// @param depth the position in the key where the prefix starts.
+    /// @return the number of matching bytes.
+    static auto matching(const node_t *node, const Key &key, std::size_t depth) -> std::size_t
+    {
+        std::size_t length = 0;
+        while (length < node->prefix.size() && depth + length < key.size() &&
+               node->prefix[length] == key[depth + length]) {
+            ++length;
+        }
+        return length;
+    }
+
+    /// @brief Returns the group of the given key.
+    /// @param key the key.
+    /// @return the group, null if not found.
+    auto find_group(const Key &key) const -> group_t *
+    {
+        const node_t *node = root;
+        std::size_t depth  = 0;
+        while (node != nullptr) {
+            if (matching(node, key, depth) != node->prefix.size()) {
+                return nullptr;
+            }
+            depth += node->prefix.size();
+            if (depth == key.size()) {
+                return node->group;
+            }
+            node_t **slot = child_slot(const_cast<node_t *>(node), byte_at(key, depth));
+            node          = slot != nullptr ? *slot : nullptr;
+            ++depth;
+        }
+        return nullptr;
+    }
+
+    /// @brief Returns the group with the smallest key not less than the given one.
+    /// @param key the key.
+    /// @return the group, null if there is none.
+    auto lower_group(const Key &key) const -> group_t *
+    {
+        const node_t *node = root;
+        std::size_t depth  = 0;
+        while (node != nullptr) {
+            std::size_t length = matching(node, key, depth);
+            if (length < node->prefix.size()) {
+                // The key ends, or differs, inside the prefix.
+                bool smaller = depth + length == key.size() ||
+                               byte_at(key, depth + length) < static_cast<unsigned char>(node->prefix[length]);
+                return smaller ? min_group(node) : after(node);
+            }
+            depth += length;
+            if (depth == key.size()) {
+                return min_group(node);
+            }
+            unsigned char byte = byte_at(key, depth);
+            node_t **slot      = child_slot(const_cast<node_t *>(node), byte);
+            if (slot == nullptr) {
+                const node_t *greater = next_child(node, byte + 1U);
+                return greater != nullptr ? min_group(greater) : after(node);
+            }
+            node = *slot;
+            ++depth;
+        }
+        return nullptr;
+    }
+
+    /// @brief Returns the group with the smallest key greater than the given one.
+    /// @param key the key.
+    /// @return the group, null if there is none.
+    auto upper_group(const Key &key) const -> group_t *
+    {
+        group_t *group = this->lower_group(key);
+        return group != nullptr && group->key == key ? group->next : group;
+    }
+
+    /// @brief Returns the groups whose key starts with the given prefix.
+    /// @param prefix the prefix.
+    /// @return the first group, and the one following the last.
+    auto prefix_groups(const Key &prefix) const -> std::pair<group_t *, group_t *>
+    {
+        const node_t *node = root;
+        std::size_t depth  = 0;
+        while (node != nullptr) {
+            std::size_t length = matching(node, prefix, depth);
+            if (depth + length == prefix.size()) {
+                return std::make_pair(min_group(node), after(node));
+            }
+            if (length < node->prefix.size()) {
+                break;
+            }
+            depth += length;
+            node_t **slot = child_slot(const_cast<node_t *>(node), byte_at(prefix, depth));
+            node          = slot != nullptr ? *slot : nullptr;
+            ++depth;
+        }
+        return std::make_pair(nullptr, nullptr);
+    }
+
+    /// @brief Adds the group of a key which is not in the tree.
+    /// @param key the key.
+    /// @return the new group.
+    auto add_group(const Key &key) -> group_t *
+    {
+        // Groups are linked before the first greater key, found beforehand.
+        group_t *next  = this->lower_group(key);
+        group_t *group = new group_t{key, std::vector<Mapped>(), next != nullptr ? next->previous : this->tail(), next};
+        (group->previous != nullptr ? group->previous->next : head) = group;
+        if (next != nullptr) {
+            next->previous = group;
+        }
+        node_t **slot     = &root;
+        std::size_t depth = 0;
+        while (*slot != nullptr) {
+            node_t *node       = *slot;
+            std::size_t length = matching(node, key, depth);
+            if (length < node->prefix.size()) {
+                // Splits the prefix, the node keeps what follows the mismatch.
+                node_t *parent = make_node(node4_kind, node->prefix.substr(0, length));
+                unsigned char byte = static_cast<unsigned char>(node->prefix[length]);
+                node->prefix.erase(0, length + 1U);
+                add_child(&parent, byte, node);
+                *slot = parent;
+                node  = parent;
+            }
+            depth += length;
+            if (depth == key.size()) {
+                node->group = group;
+                return group;
+            }
+            node_t **child = child_slot(node, byte_at(key, depth));
+            if (child == nullptr) {
+                node_t *leaf = make_node(leaf_kind, key.substr(depth + 1U));
+                leaf->group  = group;
+                add_child(slot, byte_at(key, depth), leaf);
+                return group;
+            }
+            slot = child;
+            ++depth;
+        }
+        *slot          = make_node(leaf_kind, key);
+        (*slot)->group = group;
+        return group;
+    }
+
+    /// @brief Removes an empty group, and the nodes left useless.
+    /// @param group the group.
+    void remove_group(group_t *group)
+    {
+        (group->previous != nullptr ? group->previous->next : head) = group->next;
+        if (group->next != nullptr) {
+            group->next->previous = group->previous;
+        }
+        // Finds the node of the group, and the slots leading to it.
+        std::vector<node_t **> path;
+        std::vector<unsigned char> bytes;
+        node_t **slot     = &root;
+        std::size_t depth = 0;
+        while ((*slot)->group != group) {
+            depth += (*slot)->prefix.size();
+            bytes.push_back(byte_at(group->key, depth));
+            path.push_back(slot);
+            slot = child_slot(*slot, bytes.back());
+            ++depth;
+        }
+        node_t *node = *slot;
+        node->group  = nullptr;
+        delete group;
+        // Removes the nodes without group and children, then merges a node
+        // without group and with a single child into the child.
+        while (node->group == nullptr && node->count == 0U) {
+            free_node(node);
+            if (path.empty()) {
+                root = nullptr;
+                return;
+            }
+            slot = path.back();
+            node = *slot;
+            remove_child(node, bytes.back());
+            path.pop_back();
+            bytes.pop_back();
+        }
+        if (node->group == nullptr && node->count == 1U) {
+            unsigned char byte = 0;
+            node_t *child      = next_child(node, 0, &byte);
+            child->prefix      = node->prefix + static_cast<char>(byte) + child->prefix;
+            free_node(node);
+            *slot = child;
+        }
+    }
+
+    /// @brief Returns the group with the greatest key.
+    /// @return the group, null if the map is empty.
+    auto tail() const -> group_t * { return root != nullptr ? max_group(root) : nullptr; }
+
+    /// @brief The root of the tree, null if the map is empty.
+    node_t *root;
+    /// @brief The group with the smallest key.
+    group_t *head;
+    /// @brief The number of entries.
+    std::size_t entries;
+};
+
+/// @brief An index policy for `ordered_multimap_t`, which uses an adaptive
+/// radix tree for `std::string` keys, and a `std::multimap` for the others.
+/// @details For instance:
+/// @code
+/// ordered_multimap_t<std::string, std::string, radix_index_t> config;
+/// for (const auto &entry : config.prefix_range("server.")) { ... }
+/// @endcode
+struct radix_index_t {
+    /// @brief The type of the index.
+    /// @tparam Key the type of the key.
+    /// @tparam Handle the type of the handle to an element.
+    template <typename Key, typename Handle>
+    using type = typename std::
+        conditional<std::is_same<Key, std::string>::value, radix_multimap_t<Key, Handle>, std::multimap<Key, Handle>>::type;
+};
+
+} // namespace ordered_multimap
@@ -0,0 +1,372 @@
+/// @file shared_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map in POSIX shared memory, shared among processes.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/mapped_ordered_multimap.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if ORDERED_MULTIMAP_HAS_MMAP
+#include <pthread.h>
+#endif
+
+namespace ordered_multimap
+{
+
+/// @brief A `mapped_ordered_multimap_t` living in POSIX shared memory, and
+/// protected by a process-shared reader/writer lock.
+/// @details Every process opens the map by name, and accesses it through
+/// `read` and `write`, which take the lock, and map again the memory if
+/// another process made it grow. One process can maintain the map, while many
+/// others query it without copies: all of them map the same pages.
+///
+/// Two shared memory objects are used: `<name>`, holding the map, and
+/// `<name>.lock`, holding the lock. They outlive the processes, until
+/// `remove` is called. Shared memory is only available on POSIX systems,
+/// elsewhere `open` fails. On macOS, the objects are files in the temporary
+/// directory, see `ORDERED_MULTIMAP_SHM_FILES`.
+///
+/// The process-shared lock is not robust: if a process dies while holding
+/// it, or while initializing it, other processes cannot take it anymore.
+/// `open` gives up on a lock left half-initialized, but `read` and `write`
+/// block on a lock left held; in both cases, `remove` the map and open it
+/// again to start afresh.
+/// @tparam Key the type of the key, it must be trivially copyable.
+/// @tparam Value the type of the value, it must be trivially copyable.
+/// @tparam Hash the hash of the keys, it must be stable across runs.
+template <typename Key, typename Value, typename Hash = mapped_hash<Key>> class shared_ordered_multimap_t
+{
+public:
+    /// @brief The type of the shared map.
+    using map_t = mapped_ordered_multimap_t<Key, Value, Hash>;
+
+    /// @brief Construct a closed map.
+    shared_ordered_multimap_t()
+        : map()
+        , control_region()
+    {
+#if ORDERED_MULTIMAP_HAS_MMAP
+        pthread_rwlock_init(&remap_lock, nullptr);
+#endif
+    }
+
+    /// @brief The map owns its mappings, it cannot be copied.
+    shared_ordered_multimap_t(const shared_ordered_multimap_t &) = delete;
+
+    /// @brief The map owns its mappings, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const shared_ordered_multimap_t &) -> shared_ordered_multimap_t & = delete;
+
+    /// @brief Unmaps the shared memory, which is not removed.
+    ~shared_ordered_multimap_t()
+    {
+        this->close();
+#if ORDERED_MULTIMAP_HAS_MMAP
+        pthread_rwlock_destroy(&remap_lock);
+#endif
+    }
+
+    /// @brief Opens the map with the given name, creating it if needed.
+    /// @details If another process is initializing the lock, it waits for it
+    /// up to `initialization_timeout_ms`, and then fails, since that process
+    /// probably died.
+    /// @param name the name of the map, starting with a slash.
+    /// @param chunk_size the shared memory grows by multiples of this number of bytes.
+    /// @return true on success, false otherwise.
+    auto open(const std::string &name, std::size_t chunk_size = 1U << 20U) -> bool
+    {
+        this->close();
+#if ORDERED_MULTIMAP_HAS_MMAP
+        if (!control_region.open_shared(name + ".lock", sizeof(control_t))) {
+            return false;
+        }
+        control_t *c = this->control();
+        // The first process zero-extends the object, and initializes the lock.
+        std::uint32_t expected = state_empty;
+        if (c->state.compare_exchange_strong(expected, state_initializing)) {
+            pthread_rwlockattr_t attributes;
+            bool success = pthread_rwlockattr_init(&attributes) == 0;
+            success      = success && pthread_rwlockattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED) == 0;
+            success      = success && pthread_rwlock_init(&c->lock, &attributes) == 0;
+            pthread_rwlockattr_destroy(&attributes);
+            c->state.store(success ? state_ready : state_failed);
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(initialization_timeout_ms);
+        while (c->state.load() == state_initializing && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        if (c->state.load() != state_ready) {
+            control_region.close();
+            return false;
+        }
+        // Formatting a new map must not race with other processes.
+        pthread_rwlock_wrlock(&c->lock);
+        bool success = map.open_shared(name, chunk_size);
+        pthread_rwlock_unlock(&c->lock);
+        if (!success) {
+            control_region.close();
+        }
+        return success;
+#else
+        (void)name;
+        (void)chunk_size;
+        return false;
+#endif
+    }
+
+    /// @brief Unmaps the shared memory, which is not removed.
+    void close()
+    {
+        map.close();
+        control_region.close();
+    }
+
+    /// @brief Checks if the map is open.
+    /// @return true if the map is open.
+    auto is_open() const -> bool { return map.is_open(); }
+
+    /// @brief Removes the shared memory objects of the map with the given
+    /// name, processes which opened it keep their mappings.
+    /// @param name the name of the map.
+    /// @return true if the map existed.
+    static auto remove(const std::string &name) -> bool
+    {
+        bool removed = mapped_region_t::unlink_shared(name);
+        return mapped_region_t::unlink_shared(name + ".lock") && removed;
+    }
+
+    /// @brief Calls the given function with a read-only view of the map,
+    /// under the shared lock.
+    /// @details Any number of processes and threads can read concurrently.
+    /// If another process made the map grow, the first reading thread maps
+    /// it again, while the other threads of this process wait for it.
+    /// @tparam Function the type of the function.
+    /// @param function a callable accepting a `const map_t &`.
+    /// @return whatever the function returns.
+    /// @throws std::runtime_error if the map is not open, or cannot be mapped
+    /// again; the function is not called.
+    template <typename Function> auto read(Function function) -> decltype(function(std::declval<const map_t &>()))
+    {
+        this->check_open();
+        lock_t guard(this->control(), false);
+        local_lock_t local(this, false);
+        while (map.stale()) {
+            // Readers of this process use the mapping, only one can replace it.
+            local.release();
+            {
+                local_lock_t exclusive(this, true);
+                if (!map.refresh()) {
+                    throw std::runtime_error("shared_ordered_multimap_t: cannot map the grown map");
+                }
+            }
+            local.acquire(false);
+        }
+        return function(static_cast<const map_t &>(map));
+    }
+
+    /// @brief Calls the given function with the map, under the exclusive lock.
+    /// @details The exclusive lock keeps out the readers of every process,
+    /// hence the mapping can be replaced freely.
+    /// @tparam Function the type of the function.
+    /// @param function a callable accepting a `map_t &`.
+    /// @return whatever the function returns.
+    /// @throws std::runtime_error if the map is not open, or cannot be mapped
+    /// again; the function is not called.
+    template <typename Function> auto write(Function function) -> decltype(function(std::declval<map_t &>()))
+    {
+        this->check_open();
+        lock_t guard(this->control(), true);
+        if (!map.refresh()) {
+            throw std::runtime_error("shared_ordered_multimap_t: cannot map the grown map");
+        }
+        return function(map);
+    }
+
+    /// @brief How long `open` waits for another process to initialize the
+    /// lock, in milliseconds.
+    static const int initialization_timeout_ms = 1000;
+
+private:
+    /// @brief The states of the lock.
+    enum state_t : std::uint32_t {
+        state_empty        = 0U, ///< The object was just created.
+        state_initializing = 1U, ///< A process is initializing the lock.
+        state_ready        = 2U, ///< The lock can be used.
+        state_failed       = 3U, ///< The lock could not be initialized.
+    };
+
+#if ORDERED_MULTIMAP_HAS_MMAP
+    /// @brief The content of the control object.
+    struct control_t {
+        /// @brief The state of the lock, see `state_t`.
+        std::atomic<std::uint32_t> state;
+        /// @brief The process-shared lock protecting the map.
+        pthread_rwlock_t lock;
+    };
+
+    /// @brief Holds the lock, for the duration of a scope.
+    class lock_t
+    {
+    public:
+        /// @brief Takes the lock.
+        /// @param _control the control object.
+        /// @param exclusive true to take the lock for writing.
+        lock_t(control_t *_control, bool exclusive)
+            : control(_control)
+        {
+            if (exclusive) {
+                pthread_rwlock_wrlock(&control->lock);
+            } else {
+                pthread_rwlock_rdlock(&control->lock);
+            }
+        }
+
+        /// @brief The lock cannot be copied.
+        lock_t(const lock_t &) = delete;
+
+        /// @brief The lock cannot be copied.
+        /// @return nothing, this function is deleted.
+        auto operator=(const lock_t &) -> lock_t & = delete;
+
+        /// @brief Releases the lock.
+        ~lock_t() { pthread_rwlock_unlock(&control->lock); }
+
+    private:
+        /// @brief The control object.
+        control_t *control;
+    };
+
+    /// @brief Holds the lock of this process on the mapping, for the
+    /// duration of a scope.
+    class local_lock_t
+    {
+    public:
+        /// @brief Takes the lock.
+        /// @param _owner the map.
+        /// @param exclusive true to take the lock for replacing the mapping.
+        local_lock_t(shared_ordered_multimap_t *_owner, bool exclusive)
+            : owner(_owner)
+            , held(false)
+        {
+            this->acquire(exclusive);
+        }
+
+        /// @brief The lock cannot be copied.
+        local_lock_t(const local_lock_t &) = delete;
+
+        /// @brief The lock cannot be copied.
+        /// @return nothing, this function is deleted.
+        auto operator=(const local_lock_t &) -> local_lock_t & = delete;
+
+        /// @brief Releases the lock, if held.
+        ~local_lock_t() { this->release(); }
+
+        /// @brief Takes the lock.
+        /// @param exclusive true to take the lock for replacing the mapping.
+        void acquire(bool exclusive)
+        {
+            if (exclusive) {
+                pthread_rwlock_wrlock(&owner->remap_lock);
+            } else {
+                pthread_rwlock_rdlock(&owner->remap_lock);
+            }
+            held = true;
+        }
+
+        /// @brief Releases the lock, if held.
+        void release()
+        {
+            if (held) {
+                pthread_rwlock_unlock(&owner->remap_lock);
+                held = false;
+            }
+        }
+
+    private:
+        /// @brief The map.
+        shared_ordered_multimap_t *owner;
+        /// @brief True while the lock is held.
+        bool held;
+    };
+#else
+    /// @brief Placeholder for systems without shared memory.
+    struct control_t {
+    };
+
+    /// @brief Placeholder for systems without shared memory.
+    class lock_t
+    {
+    public:
+        /// @brief Does nothing.
+        lock_t(control_t *, bool)
+        {
+            // Nothing to do.
+        }
+    };
+
+    /// @brief Placeholder for systems without shared memory.
+    class local_lock_t
+    {
+    public:
+        /// @brief Does nothing.
+        local_lock_t(shared_ordered_multimap_t *, bool)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Does nothing.
+        void acquire(bool)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Does nothing.
+        void release()
+        {
+            // Nothing to do.
+        }
+    };
+#endif
+
+    /// @brief Fails if the map is not open.
+    /// @details The control object is open exactly when the map is, and it is
+    /// never mapped again, hence it can be checked without the locks.
+    /// @throws std::runtime_error if the map is not open.
+    void check_open() const
+    {
+        if (!control_region.is_open()) {
+            throw std::runtime_error("shared_ordered_multimap_t: the map is not open");
+        }
+    }
+
+    /// @brief Returns the control object.
+    /// @return a pointer to the control object.
+    auto control() -> control_t * { return reinterpret_cast<control_t *>(control_region.data()); }
+
+    /// @brief The shared map.
+    map_t map;
+    /// @brief Maps the control object.
+    mapped_region_t control_region;
+#if ORDERED_MULTIMAP_HAS_MMAP
+    /// @brief Lets one thread of this process replace the mapping, while the
+    /// others, which read through it, wait.
+    pthread_rwlock_t remap_lock;
+#endif
+};
+
+template <typename Key, typename Value, typename Hash>
+const int shared_ordered_multimap_t<Key, Value, Hash>::initialization_timeout_ms;
+
+} // namespace ordered_multimap
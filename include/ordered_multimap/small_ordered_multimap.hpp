@@ -0,0 +1,539 @@
+/// @file small_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map which stores a few entries inline, without index.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+/// @brief An `ordered_multimap_t` optimized for a small number of entries.
+/// @details Up to `N` entries are stored inline, in a plain array inside the
+/// object, in insertion order: no allocation is made for them, and lookups
+/// are linear scans over the entries, which beat an index for a handful of
+/// entries. Keys are stored next to their values, so the scans compare one
+/// key at a time and are not vectorized. When the `N+1`-th entry is
+/// inserted, all the entries are copied, or moved if they cannot be copied,
+/// to a full `ordered_multimap_t`, with its list and index, and stay there
+/// until the map is cleared.
+///
+/// Iterators and references are invalidated by erasures while the entries
+/// are inline, and by the switch to the full representation.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+/// @tparam N the number of entries stored inline.
+template <typename Key, typename Value, std::size_t N = 16U> class small_ordered_multimap_t
+{
+    static_assert(N > 0, "At least one entry must be stored inline.");
+
+public:
+    /// @brief The type of the full representation.
+    using map_t        = ordered_multimap_t<Key, Value>;
+    /// @brief The type of the entries.
+    using list_entry_t = typename map_t::list_entry_t;
+
+    /// @brief Iterator over the entries, in insertion order.
+    /// @tparam Entry the type of the entry, const for constant iterators.
+    /// @tparam ListIterator the iterator of the full representation.
+    template <typename Entry, typename ListIterator> class basic_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::bidirectional_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = list_entry_t;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a pointer to an entry.
+        using pointer           = Entry *;
+        /// @brief The type of a reference to an entry.
+        using reference         = Entry &;
+
+        /// @brief Construct a singular iterator.
+        basic_iterator()
+            : inline_entry(nullptr)
+            , list_it()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Converts a mutable iterator into a constant one.
+        /// @param other the other iterator.
+        template <typename OtherEntry, typename OtherListIterator>
+        basic_iterator(const basic_iterator<OtherEntry, OtherListIterator> &other)
+            : inline_entry(other.inline_entry)
+            , list_it(other.list_it)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        auto operator*() const -> reference { return inline_entry != nullptr ? *inline_entry : *list_it; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        auto operator->() const -> pointer { return &**this; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> basic_iterator &
+        {
+            if (inline_entry != nullptr) {
+                ++inline_entry;
+            } else {
+                ++list_it;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of the iterator before moving.
+        auto operator++(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a reference to this iterator.
+        auto operator--() -> basic_iterator &
+        {
+            if (inline_entry != nullptr) {
+                --inline_entry;
+            } else {
+                --list_it;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a copy of the iterator before moving.
+        auto operator--(int) -> basic_iterator
+        {
+            basic_iterator copy(*this);
+            --(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const basic_iterator &other) const -> bool
+        {
+            return inline_entry == other.inline_entry && (inline_entry != nullptr || list_it == other.list_it);
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const basic_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class small_ordered_multimap_t;
+        template <typename OtherEntry, typename OtherListIterator> friend class basic_iterator;
+
+        /// @brief Construct an iterator to an inline entry.
+        /// @param _inline_entry the entry.
+        explicit basic_iterator(Entry *_inline_entry)
+            : inline_entry(_inline_entry)
+            , list_it()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator to an entry of the full representation.
+        /// @param _list_it the iterator of the entry.
+        explicit basic_iterator(ListIterator _list_it)
+            : inline_entry(nullptr)
+            , list_it(_list_it)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The inline entry, null in the full representation.
+        Entry *inline_entry;
+        /// @brief The entry of the full representation.
+        ListIterator list_it;
+    };
+
+    /// @brief Iterator for the list, for the user.
+    using iterator       = basic_iterator<list_entry_t, typename map_t::iterator>;
+    /// @brief Constant iterator for the list, for the user.
+    using const_iterator = basic_iterator<const list_entry_t, typename map_t::const_iterator>;
+
+    /// @brief Construct a new, empty, map.
+    small_ordered_multimap_t()
+        : length(0)
+        , large()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Copy constructor.
+    /// @param other the map to copy.
+    small_ordered_multimap_t(const small_ordered_multimap_t &other)
+        : length(0)
+        , large()
+    {
+        this->copy_from(other);
+    }
+
+    /// @brief Move constructor, inline entries are moved one by one.
+    /// @param other the map to move from, left empty.
+    small_ordered_multimap_t(small_ordered_multimap_t &&other) noexcept(std::is_nothrow_move_constructible<list_entry_t>::value)
+        : length(0)
+        , large()
+    {
+        this->move_from(std::move(other));
+    }
+
+    /// @brief Destroys the entries.
+    ~small_ordered_multimap_t() { this->clear(); }
+
+    /// @brief Copy assignment.
+    /// @param other the map to copy.
+    /// @return a reference to the current map.
+    auto operator=(const small_ordered_multimap_t &other) -> small_ordered_multimap_t &
+    {
+        if (this != &other) {
+            this->clear();
+            this->copy_from(other);
+        }
+        return *this;
+    }
+
+    /// @brief Move assignment.
+    /// @param other the map to move from, left empty.
+    /// @return a reference to the current map.
+    auto operator=(small_ordered_multimap_t &&other) noexcept(std::is_nothrow_move_constructible<list_entry_t>::value)
+        -> small_ordered_multimap_t &
+    {
+        if (this != &other) {
+            this->clear();
+            this->move_from(std::move(other));
+        }
+        return *this;
+    }
+
+    /// @brief Clears the content of the map, entries are stored inline again.
+    void clear()
+    {
+        for (std::size_t i = 0; i < length; ++i) {
+            this->entry(i).~list_entry_t();
+        }
+        length = 0;
+        large.reset();
+    }
+
+    /// @brief Checks if the entries are stored inline.
+    /// @return true if the entries are stored inline.
+    auto is_small() const -> bool { return !large; }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return large ? large->size() : length; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return this->size() == 0; }
+
+    /// @brief Returns an iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() -> iterator { return large ? iterator(large->begin()) : iterator(this->entries()); }
+
+    /// @brief Returns a const iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() const -> const_iterator
+    {
+        return large ? const_iterator(static_cast<const map_t &>(*large).begin()) : const_iterator(this->entries());
+    }
+
+    /// @brief Returns an iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() -> iterator { return large ? iterator(large->end()) : iterator(this->entries() + length); }
+
+    /// @brief Returns a const iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() const -> const_iterator
+    {
+        return large ? const_iterator(static_cast<const map_t &>(*large).end()) : const_iterator(this->entries() + length);
+    }
+
+    /// @brief Returns a vector containing all key-value pairs in insertion
+    /// order.
+    /// @return A vector of key-value pairs.
+    auto to_vector() const -> std::vector<list_entry_t> { return std::vector<list_entry_t>(this->begin(), this->end()); }
+
+    /// @brief Inserts the `<key,value>` pair at the end of the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return the iterator to the newly inserted element in the map.
+    auto insert(const Key &key, const Value &value) -> iterator { return this->emplace(key, value); }
+
+    /// @brief Constructs a value in-place at the end of the map with the given
+    /// key.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    /// @return An iterator to the newly inserted element.
+    template <typename... Args> auto emplace(const Key &key, Args &&...args) -> iterator
+    {
+        if (!large && length == N) {
+            // The key and the arguments may refer to the inline entries,
+            // build the new entry before they are handed over.
+            list_entry_t added(
+                std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+            this->grow();
+            return iterator(large->emplace(added.first, std::move(added.second)));
+        }
+        if (large) {
+            return iterator(large->emplace(key, std::forward<Args>(args)...));
+        }
+        list_entry_t *slot = this->entries() + length;
+        ::new (static_cast<void *>(slot))
+            list_entry_t(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        ++length;
+        return iterator(slot);
+    }
+
+    /// @brief Updates all values associated with the given key to the new
+    /// value.
+    /// @details If no such entries exist, a new one is appended at the end.
+    /// @param key The key to update.
+    /// @param value The new value to assign.
+    /// @return An iterator to the first updated or newly inserted element.
+    auto update(const Key &key, const Value &value) -> iterator
+    {
+        if (large) {
+            return iterator(large->update(key, value));
+        }
+        list_entry_t *first = nullptr;
+        for (std::size_t i = 0; i < length; ++i) {
+            if (this->entry(i).first == key) {
+                this->entry(i).second = value;
+                first                 = first != nullptr ? first : &this->entry(i);
+            }
+        }
+        return first != nullptr ? iterator(first) : this->insert(key, value);
+    }
+
+    /// @brief Erases all the elements with the given key.
+    /// @param key the key of the elements to remove.
+    /// @return an iterator to the element after the first one removed.
+    auto erase(const Key &key) -> iterator
+    {
+        if (large) {
+            return iterator(large->erase(key));
+        }
+        // The key may belong to one of the entries moved over below.
+        const Key target(key);
+        std::size_t first = length;
+        std::size_t kept  = 0;
+        for (std::size_t i = 0; i < length; ++i) {
+            if (this->entry(i).first == target) {
+                first = first == length ? kept : first;
+            } else if (kept != i) {
+                this->entry(kept++) = std::move(this->entry(i));
+            } else {
+                ++kept;
+            }
+        }
+        this->truncate(kept);
+        return iterator(this->entries() + (first < length ? first : length));
+    }
+
+    /// @brief Erases the elment from the list, and returns an iteator to the
+    /// same position in the list (i.e., the elment after the one removed).
+    /// @param it_list the iterator of the element to remove.
+    /// @return an iterator to the same position in the list.
+    auto erase(iterator it_list) -> iterator
+    {
+        if (large) {
+            return iterator(large->erase(it_list.list_it));
+        }
+        std::size_t position = static_cast<std::size_t>(it_list.inline_entry - this->entries());
+        std::move(this->entries() + position + 1U, this->entries() + length, this->entries() + position);
+        this->truncate(length - 1U);
+        return iterator(this->entries() + position);
+    }
+
+    /// @brief Erases a single element that matches the given key and value.
+    /// @details This function removes only the first occurrence of the
+    /// specified key-value pair.
+    /// @param key The key to search for.
+    /// @param value The value to match against.
+    /// @return The number of elements removed (0 or 1).
+    auto erase(const Key &key, const Value &value) -> std::size_t
+    {
+        if (large) {
+            return large->erase(key, value);
+        }
+        for (std::size_t i = 0; i < length; ++i) {
+            if (this->entry(i).first == key && this->entry(i).second == value) {
+                this->erase(iterator(&this->entry(i)));
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    /// @brief Returns an iterator to the first element, in insertion order,
+    /// associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) -> iterator
+    {
+        if (large) {
+            return iterator(large->find(key));
+        }
+        return iterator(this->entries() + this->scan(key));
+    }
+
+    /// @brief Returns an iterator to the first element, in insertion order,
+    /// associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        if (large) {
+            return const_iterator(static_cast<const map_t &>(*large).find(key));
+        }
+        return const_iterator(this->entries() + this->scan(key));
+    }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return large ? large->has(key) : this->scan(key) < length; }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    auto count(const Key &key) const -> std::size_t
+    {
+        if (large) {
+            return large->count(key);
+        }
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < length; ++i) {
+            result += this->entry(i).first == key ? 1U : 0U;
+        }
+        return result;
+    }
+
+private:
+    /// @brief Uninitialized storage for an inline entry.
+    using slot_t = typename std::aligned_storage<sizeof(list_entry_t), alignof(list_entry_t)>::type;
+
+    /// @brief Returns the inline entries.
+    /// @return a pointer to the first inline entry.
+    auto entries() -> list_entry_t * { return reinterpret_cast<list_entry_t *>(storage); }
+
+    /// @brief Returns the inline entries.
+    /// @return a pointer to the first inline entry.
+    auto entries() const -> const list_entry_t * { return reinterpret_cast<const list_entry_t *>(storage); }
+
+    /// @brief Returns an inline entry.
+    /// @param position the position of the entry.
+    /// @return a reference to the entry.
+    auto entry(std::size_t position) -> list_entry_t & { return this->entries()[position]; }
+
+    /// @brief Returns an inline entry.
+    /// @param position the position of the entry.
+    /// @return a reference to the entry.
+    auto entry(std::size_t position) const -> const list_entry_t & { return this->entries()[position]; }
+
+    /// @brief Searches the inline entries for a key.
+    /// @param key the key.
+    /// @return the position of the first entry with the key, or the number
+    /// of entries if not found.
+    auto scan(const Key &key) const -> std::size_t
+    {
+        std::size_t position = 0;
+        while (position < length && !(this->entry(position).first == key)) {
+            ++position;
+        }
+        return position;
+    }
+
+    /// @brief Destroys the inline entries past the given number.
+    /// @param size the number of entries to keep.
+    void truncate(std::size_t size)
+    {
+        for (std::size_t i = size; i < length; ++i) {
+            this->entry(i).~list_entry_t();
+        }
+        length = size;
+    }
+
+    /// @brief The type through which the inline values are handed over to
+    /// the full representation: a copy when possible, a move otherwise.
+    using transfer_t =
+        typename std::conditional<std::is_copy_constructible<Value>::value, const Value &, Value &&>::type;
+
+    /// @brief Moves the inline entries to the full representation.
+    /// @details The inline entries are destroyed only once the full
+    /// representation is built. Values are copied, when possible, so that
+    /// they are left intact if building it throws.
+    void grow()
+    {
+        std::unique_ptr<map_t> map(new map_t());
+        for (std::size_t i = 0; i < length; ++i) {
+            map->emplace(this->entry(i).first, static_cast<transfer_t>(this->entry(i).second));
+        }
+        this->truncate(0);
+        large = std::move(map);
+    }
+
+    /// @brief Copies the entries of another map, this one must be empty.
+    /// @param other the map to copy.
+    void copy_from(const small_ordered_multimap_t &other)
+    {
+        if (other.large) {
+            large.reset(new map_t(*other.large));
+            return;
+        }
+        for (std::size_t i = 0; i < other.length; ++i) {
+            ::new (static_cast<void *>(this->entries() + i)) list_entry_t(other.entry(i));
+            ++length;
+        }
+    }
+
+    /// @brief Moves the entries of another map, this one must be empty.
+    /// @param other the map to move from, left empty.
+    void move_from(small_ordered_multimap_t &&other)
+    {
+        large = std::move(other.large);
+        for (std::size_t i = 0; i < other.length; ++i) {
+            ::new (static_cast<void *>(this->entries() + i)) list_entry_t(std::move(other.entry(i)));
+            ++length;
+        }
+        other.clear();
+    }
+
+    /// @brief The storage of the inline entries, left uninitialized until
+    /// they are inserted.
+    slot_t storage[N];
+    /// @brief The number of inline entries.
+    std::size_t length;
+    /// @brief The full representation, once the entries do not fit inline.
+    std::unique_ptr<map_t> large;
+};
+
+} // namespace ordered_multimap
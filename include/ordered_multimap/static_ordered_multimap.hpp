@@ -0,0 +1,368 @@
+/// @file static_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An immutable ordered map, built at compile time.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#define ORDERED_MULTIMAP_HAS_STATIC_MAP 1
+#else
+#define ORDERED_MULTIMAP_HAS_STATIC_MAP 0
+#endif
+
+#if ORDERED_MULTIMAP_HAS_STATIC_MAP
+
+#include <string_view>
+
+namespace ordered_multimap
+{
+
+/// @brief An entry of a `static_ordered_multimap_t`.
+/// @details Unlike `std::pair`, it is an aggregate, whose copies are
+/// `constexpr` in C++17.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value> struct static_entry_t {
+    /// @brief The key.
+    Key first;
+    /// @brief The value.
+    Value second;
+};
+
+/// @brief An immutable ordered multimap, which can be built at compile time.
+/// @details The entries are stored in declaration order, in a plain array,
+/// next to an array of their positions sorted by key, computed by the
+/// `constexpr` constructor. Lookups are binary searches over the sorted
+/// positions, hence a map declared `constexpr` costs no construction at
+/// runtime, and no heap, and can be queried inside constant expressions.
+/// Entries sharing a key keep their declaration order. Requires C++17, use
+/// `std::string_view` for string keys.
+/// @tparam Key the type of the key, a literal type.
+/// @tparam Value the type of the value, a literal type.
+/// @tparam N the number of entries.
+/// @tparam Compare the ordering of the keys.
+template <typename Key, typename Value, std::size_t N, typename Compare = std::less<Key>> class static_ordered_multimap_t
+{
+    static_assert(N > 0, "The map needs at least one entry.");
+
+public:
+    /// @brief The type of the entries.
+    using list_entry_t   = static_entry_t<Key, Value>;
+    /// @brief Iterator over the entries, in declaration order.
+    using const_iterator = const list_entry_t *;
+
+    /// @brief Iterator over the entries with the same key, in declaration order.
+    class key_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::random_access_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = list_entry_t;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a pointer to an entry.
+        using pointer           = const list_entry_t *;
+        /// @brief The type of a reference to an entry.
+        using reference         = const list_entry_t &;
+
+        /// @brief Construct a singular iterator.
+        constexpr key_iterator()
+            : owner(nullptr)
+            , rank(0)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Construct an iterator.
+        /// @param _owner the map.
+        /// @param _rank the rank of the entry in key order.
+        constexpr key_iterator(const static_ordered_multimap_t *_owner, std::size_t _rank)
+            : owner(_owner)
+            , rank(_rank)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry.
+        /// @return a reference to the entry.
+        constexpr auto operator*() const -> reference { return owner->entries[owner->order[rank]]; }
+
+        /// @brief Returns the entry.
+        /// @return a pointer to the entry.
+        constexpr auto operator->() const -> pointer { return &owner->entries[owner->order[rank]]; }
+
+        /// @brief Returns the entry at the given distance.
+        /// @param offset the distance from this iterator.
+        /// @return a reference to the entry.
+        constexpr auto operator[](difference_type offset) const -> reference { return *(*this + offset); }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        constexpr auto operator++() -> key_iterator &
+        {
+            ++rank;
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of the iterator before moving.
+        constexpr auto operator++(int) -> key_iterator
+        {
+            key_iterator copy(*this);
+            ++rank;
+            return copy;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a reference to this iterator.
+        constexpr auto operator--() -> key_iterator &
+        {
+            --rank;
+            return *this;
+        }
+
+        /// @brief Moves to the previous entry.
+        /// @return a copy of the iterator before moving.
+        constexpr auto operator--(int) -> key_iterator
+        {
+            key_iterator copy(*this);
+            --rank;
+            return copy;
+        }
+
+        /// @brief Moves by the given distance.
+        /// @param offset the distance, negative to move backwards.
+        /// @return a reference to this iterator.
+        constexpr auto operator+=(difference_type offset) -> key_iterator &
+        {
+            rank = static_cast<std::size_t>(static_cast<difference_type>(rank) + offset);
+            return *this;
+        }
+
+        /// @brief Moves back by the given distance.
+        /// @param offset the distance, negative to move forwards.
+        /// @return a reference to this iterator.
+        constexpr auto operator-=(difference_type offset) -> key_iterator & { return *this += -offset; }
+
+        /// @brief Returns an iterator at the given distance.
+        /// @param offset the distance, negative to move backwards.
+        /// @return the new iterator.
+        constexpr auto operator+(difference_type offset) const -> key_iterator
+        {
+            key_iterator copy(*this);
+            return copy += offset;
+        }
+
+        /// @brief Returns an iterator at the given distance.
+        /// @param offset the distance.
+        /// @param it the iterator.
+        /// @return the new iterator.
+        friend constexpr auto operator+(difference_type offset, const key_iterator &it) -> key_iterator
+        {
+            return it + offset;
+        }
+
+        /// @brief Returns an iterator at the given distance backwards.
+        /// @param offset the distance, negative to move forwards.
+        /// @return the new iterator.
+        constexpr auto operator-(difference_type offset) const -> key_iterator
+        {
+            key_iterator copy(*this);
+            return copy -= offset;
+        }
+
+        /// @brief Returns the distance between two iterators.
+        /// @param other the other iterator.
+        /// @return the number of entries between them.
+        constexpr auto operator-(const key_iterator &other) const -> difference_type
+        {
+            return static_cast<difference_type>(rank) - static_cast<difference_type>(other.rank);
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        constexpr auto operator==(const key_iterator &other) const -> bool { return rank == other.rank; }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        constexpr auto operator!=(const key_iterator &other) const -> bool { return rank != other.rank; }
+
+        /// @brief Orders two iterators.
+        /// @param other the other iterator.
+        /// @return true if this iterator comes first.
+        constexpr auto operator<(const key_iterator &other) const -> bool { return rank < other.rank; }
+
+        /// @brief Orders two iterators.
+        /// @param other the other iterator.
+        /// @return true if this iterator comes last.
+        constexpr auto operator>(const key_iterator &other) const -> bool { return rank > other.rank; }
+
+        /// @brief Orders two iterators.
+        /// @param other the other iterator.
+        /// @return true if this iterator does not come last.
+        constexpr auto operator<=(const key_iterator &other) const -> bool { return rank <= other.rank; }
+
+        /// @brief Orders two iterators.
+        /// @param other the other iterator.
+        /// @return true if this iterator does not come first.
+        constexpr auto operator>=(const key_iterator &other) const -> bool { return rank >= other.rank; }
+
+    private:
+        /// @brief The map.
+        const static_ordered_multimap_t *owner;
+        /// @brief The rank of the entry in key order.
+        std::size_t rank;
+    };
+
+    /// @brief Builds the map from the given entries.
+    /// @param source the entries, in declaration order.
+    constexpr explicit static_ordered_multimap_t(const list_entry_t (&source)[N])
+        : entries{}
+        , order{}
+    {
+        for (std::size_t i = 0; i < N; ++i) {
+            entries[i] = source[i];
+        }
+        // A stable insertion sort, entries sharing a key keep their order.
+        for (std::size_t i = 0; i < N; ++i) {
+            std::size_t j = i;
+            while (j > 0 && Compare()(entries[i].first, entries[order[j - 1U]].first)) {
+                order[j] = order[j - 1U];
+                --j;
+            }
+            order[j] = i;
+        }
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    constexpr auto size() const -> std::size_t { return N; }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    constexpr auto empty() const -> bool { return N == 0; }
+
+    /// @brief Returns an iterator the beginning of the entries.
+    /// @return an iterator to the beginning of the entries.
+    constexpr auto begin() const -> const_iterator { return entries; }
+
+    /// @brief Returns an iterator the end of the entries.
+    /// @return an iterator to the end of the entries.
+    constexpr auto end() const -> const_iterator { return entries + N; }
+
+    /// @brief Returns an iterator to the element in the given position.
+    /// @param position the position of the element to retrieve.
+    /// @return an iterator to the element, or the end if not found.
+    constexpr auto at(std::size_t position) const -> const_iterator { return entries + (position < N ? position : N); }
+
+    /// @brief Returns an iterator to the first element, in declaration order,
+    /// associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end if not found.
+    constexpr auto find(const Key &key) const -> const_iterator
+    {
+        std::size_t rank = this->lower_rank(key);
+        if (rank == N || Compare()(key, entries[order[rank]].first)) {
+            return this->end();
+        }
+        return entries + order[rank];
+    }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    constexpr auto has(const Key &key) const -> bool { return this->find(key) != this->end(); }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    constexpr auto count(const Key &key) const -> std::size_t { return this->upper_rank(key) - this->lower_rank(key); }
+
+    /// @brief Returns the range of elements with the given key.
+    /// @param key The key to search for.
+    /// @return A pair of iterators [begin, end) over the elements matching the
+    /// key, in declaration order.
+    constexpr auto equal_range(const Key &key) const -> std::pair<key_iterator, key_iterator>
+    {
+        return {key_iterator(this, this->lower_rank(key)), key_iterator(this, this->upper_rank(key))};
+    }
+
+private:
+    /// @brief Returns the rank of the first entry whose key is not less than
+    /// the given one.
+    /// @param key the key.
+    /// @return the rank, N if there is no such entry.
+    constexpr auto lower_rank(const Key &key) const -> std::size_t
+    {
+        std::size_t first = 0;
+        std::size_t last  = N;
+        while (first < last) {
+            std::size_t middle = first + (last - first) / 2U;
+            if (Compare()(entries[order[middle]].first, key)) {
+                first = middle + 1U;
+            } else {
+                last = middle;
+            }
+        }
+        return first;
+    }
+
+    /// @brief Returns the rank of the first entry whose key is greater than
+    /// the given one.
+    /// @param key the key.
+    /// @return the rank, N if there is no such entry.
+    constexpr auto upper_rank(const Key &key) const -> std::size_t
+    {
+        std::size_t first = 0;
+        std::size_t last  = N;
+        while (first < last) {
+            std::size_t middle = first + (last - first) / 2U;
+            if (!Compare()(key, entries[order[middle]].first)) {
+                first = middle + 1U;
+            } else {
+                last = middle;
+            }
+        }
+        return first;
+    }
+
+    /// @brief The entries, in declaration order.
+    list_entry_t entries[N];
+    /// @brief The positions of the entries, sorted by key.
+    std::size_t order[N];
+};
+
+/// @brief Builds a `static_ordered_multimap_t`, deducing its size.
+/// @details For instance:
+/// @code
+/// constexpr auto commands = make_static_ordered_multimap<std::string_view, int>({
+///     {"get", 1}, {"set", 2}, {"get", 3},
+/// });
+/// static_assert(commands.count("get") == 2);
+/// @endcode
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+/// @tparam N the number of entries.
+/// @param source the entries, in declaration order.
+/// @return the map.
+template <typename Key, typename Value, std::size_t N>
+constexpr auto make_static_ordered_multimap(const static_entry_t<Key, Value> (&source)[N]) -> static_ordered_multimap_t<Key, Value, N>
+{
+    return static_ordered_multimap_t<Key, Value, N>(source);
+}
+
+} // namespace ordered_multimap
+
+#endif
@@ -0,0 +1,531 @@
+/// @file tiered_ordered_multimap.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map which keeps its newest entries in memory, and spills
+/// the oldest ones to disk.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_multimap/durable_file.hpp"
+#include "ordered_multimap/ordered_multimap.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ordered_multimap
+{
+
+namespace detail
+{
+
+/// @brief Estimates the heap memory owned by a value.
+/// @return zero, for values that own no memory.
+template <typename T> inline auto heap_size(const T &) -> std::size_t { return 0; }
+
+/// @brief Estimates the heap memory owned by a string.
+/// @param value the string.
+/// @return its capacity, unless it fits the small-string buffer.
+inline auto heap_size(const std::string &value) -> std::size_t
+{
+    return value.capacity() < sizeof(std::string) ? 0U : value.capacity() + 1U;
+}
+
+/// @brief Estimates the heap memory owned by a vector.
+/// @param value the vector.
+/// @return the memory of its elements.
+template <typename T> inline auto heap_size(const std::vector<T> &value) -> std::size_t
+{
+    std::size_t size = value.capacity() * sizeof(T);
+    for (const T &element : value) {
+        size += heap_size(element);
+    }
+    return size;
+}
+
+} // namespace detail
+
+/// @brief An `ordered_multimap_t` whose memory is capped by a budget.
+/// @details When the memory used by the entries exceeds the budget, the
+/// oldest ones, at the front of the insertion order, are spilled to an
+/// append-only segment file. Their keys stay indexed in memory, hence
+/// `find`, `count`, and `has` never scan the file, and iteration walks the
+/// spilled entries first, in order, followed by the ones in memory. Spilled
+/// entries are read back, and cached, when they are accessed; the cache is
+/// dropped whenever the budget is exceeded.
+///
+/// The memory used by an entry is estimated from the size of its nodes, and
+/// the heap memory of strings and vectors; overload `detail::heap_size` for
+/// other types owning memory. Spilled entries keep, in memory, their key and
+/// their position in the segment, which count towards the budget; those of
+/// erased entries are dropped once they outnumber the ones alive.
+/// @tparam Key the type of the key, it needs a `codec<Key>`.
+/// @tparam Value the type of the value, it needs a `codec<Value>`.
+template <typename Key, typename Value> class tiered_ordered_multimap_t
+{
+public:
+    /// @brief The type of the map holding the entries in memory.
+    using map_t        = ordered_multimap_t<Key, Value>;
+    /// @brief The type of the entries.
+    using list_entry_t = typename map_t::list_entry_t;
+
+    /// @brief Iterator over all the entries, in insertion order.
+    /// @details References to spilled entries stay valid until the budget is
+    /// next enforced, by an insertion or by accessing other spilled entries.
+    /// Iterators to spilled entries are invalidated by `erase`.
+    class const_iterator
+    {
+    public:
+        /// @brief The category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+        /// @brief The type of the entries.
+        using value_type        = list_entry_t;
+        /// @brief The type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief The type of a pointer to an entry.
+        using pointer           = const list_entry_t *;
+        /// @brief The type of a reference to an entry.
+        using reference         = const list_entry_t &;
+
+        /// @brief Returns the entry, reading it from disk if it was spilled.
+        /// @return a reference to the entry.
+        /// @throws std::runtime_error if the entry cannot be read back.
+        auto operator*() const -> reference { return position < owner->cold.size() ? owner->fault(position) : *hot; }
+
+        /// @brief Returns the entry, reading it from disk if it was spilled.
+        /// @return a pointer to the entry.
+        /// @throws std::runtime_error if the entry cannot be read back.
+        auto operator->() const -> pointer { return &**this; }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to this iterator.
+        auto operator++() -> const_iterator &
+        {
+            if (position < owner->cold.size()) {
+                position = owner->next_alive(position + 1U);
+            } else {
+                ++hot;
+            }
+            return *this;
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a copy of the iterator before moving.
+        auto operator++(int) -> const_iterator
+        {
+            const_iterator copy(*this);
+            ++(*this);
+            return copy;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to the same entry.
+        auto operator==(const const_iterator &other) const -> bool
+        {
+            return position == other.position && hot == other.hot;
+        }
+
+        /// @brief Compares two iterators.
+        /// @param other the other iterator.
+        /// @return true if they refer to different entries.
+        auto operator!=(const const_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class tiered_ordered_multimap_t;
+
+        /// @brief Construct an iterator.
+        /// @param _owner the map.
+        /// @param _position the position among the spilled entries, or their
+        /// number if the entry is in memory.
+        /// @param _hot the entry in memory, or the beginning of the memory.
+        const_iterator(const tiered_ordered_multimap_t *_owner, std::size_t _position, typename map_t::const_iterator _hot)
+            : owner(_owner)
+            , position(_position)
+            , hot(_hot)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The map.
+        const tiered_ordered_multimap_t *owner;
+        /// @brief The position among the spilled entries.
+        std::size_t position;
+        /// @brief The entry in memory.
+        typename map_t::const_iterator hot;
+    };
+
+    /// @brief Construct a map without a segment file, nor a budget.
+    tiered_ordered_multimap_t()
+        : hot()
+        , cold()
+        , cached_positions()
+        , cold_index()
+        , cold_alive(0)
+        , segment(nullptr)
+        , segment_path()
+        , segment_size(0)
+        , budget(std::numeric_limits<std::size_t>::max())
+        , hot_bytes(0)
+        , index_bytes(0)
+        , cached_bytes(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The map owns its segment file, it cannot be copied.
+    tiered_ordered_multimap_t(const tiered_ordered_multimap_t &) = delete;
+
+    /// @brief The map owns its segment file, it cannot be copied.
+    /// @return nothing, this function is deleted.
+    auto operator=(const tiered_ordered_multimap_t &) -> tiered_ordered_multimap_t & = delete;
+
+    /// @brief Closes, and removes, the segment file.
+    ~tiered_ordered_multimap_t() { this->close(); }
+
+    /// @brief Creates the segment file, where entries are spilled.
+    /// @details The map is cleared, the file only lives as long as the map.
+    /// @param path the path of the segment file, replaced if it exists.
+    /// @return true on success.
+    auto open(const std::string &path) -> bool
+    {
+        this->close();
+        segment = std::fopen(path.c_str(), "w+b");
+        if (segment == nullptr) {
+            return false;
+        }
+        segment_path = path;
+        return true;
+    }
+
+    /// @brief Clears the map, and removes the segment file.
+    void close()
+    {
+        this->clear();
+        if (segment != nullptr) {
+            std::fclose(segment);
+            std::remove(segment_path.c_str());
+            segment = nullptr;
+            segment_path.clear();
+        }
+    }
+
+    /// @brief Sets the maximum memory used by the entries.
+    /// @details Entries are spilled only while the segment file is open.
+    /// @param bytes the budget, in bytes.
+    /// @return false if the entries could not be spilled.
+    auto set_memory_budget(std::size_t bytes) -> bool
+    {
+        budget = bytes;
+        return this->enforce_budget();
+    }
+
+    /// @brief Returns the estimated memory used by the entries, including
+    /// the keys and positions of the spilled ones, and the cached spilled
+    /// entries.
+    /// @return the number of bytes.
+    auto memory_usage() const -> std::size_t
+    {
+        return hot_bytes + index_bytes + cached_bytes + cold.size() * sizeof(cold_entry_t);
+    }
+
+    /// @brief Clears the content of the map, and truncates the segment file.
+    void clear()
+    {
+        hot.clear();
+        cold.clear();
+        cached_positions.clear();
+        cold_index.clear();
+        cold_alive   = 0;
+        hot_bytes    = 0;
+        index_bytes  = 0;
+        cached_bytes = 0;
+        if (segment != nullptr) {
+            segment = std::freopen(segment_path.c_str(), "w+b", segment);
+        }
+        segment_size = 0;
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return hot.size() + cold_alive; }
+
+    /// @brief Returns the number of elements spilled to disk.
+    /// @return the number of spilled elements.
+    auto spilled() const -> std::size_t { return cold_alive; }
+
+    /// @brief Returns a const iterator the beginning of the list.
+    /// @return an iterator to the beginning of the list.
+    auto begin() const -> const_iterator { return const_iterator(this, this->next_alive(0), hot.begin()); }
+
+    /// @brief Returns a const iterator the end of the list.
+    /// @return an iterator to the end of the list.
+    auto end() const -> const_iterator { return const_iterator(this, cold.size(), hot.end()); }
+
+    /// @brief Returns a vector containing all key-value pairs in insertion
+    /// order.
+    /// @return A vector of key-value pairs.
+    auto to_vector() const -> std::vector<list_entry_t>
+    {
+        std::vector<list_entry_t> result;
+        result.reserve(this->size());
+        for (const_iterator it = this->begin(); it != this->end(); ++it) {
+            result.push_back(*it);
+        }
+        return result;
+    }
+
+    /// @brief Inserts the `<key,value>` pair, and spills the oldest entries
+    /// if the budget is exceeded.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return false if the entries could not be spilled, they are then kept
+    /// in memory, over budget.
+    auto insert(const Key &key, const Value &value) -> bool
+    {
+        auto it = hot.insert(key, value);
+        hot_bytes += this->footprint(*it);
+        return this->enforce_budget();
+    }
+
+    /// @brief Constructs a value in-place at the end of the map, and spills
+    /// the oldest entries if the budget is exceeded.
+    /// @tparam Args Types of arguments to construct a `Value`.
+    /// @param key The key associated with the new value.
+    /// @param args Arguments forwarded to construct the `Value`.
+    /// @return false if the entries could not be spilled, they are then kept
+    /// in memory, over budget.
+    template <typename... Args> auto emplace(const Key &key, Args &&...args) -> bool
+    {
+        auto it = hot.emplace(key, std::forward<Args>(args)...);
+        hot_bytes += this->footprint(*it);
+        return this->enforce_budget();
+    }
+
+    /// @brief Erases all the elements with the given key.
+    /// @param key the key of the elements to remove.
+    /// @return the number of removed elements.
+    auto erase(const Key &key) -> std::size_t
+    {
+        std::size_t removed = 0;
+        for (auto it = hot.find(key); it != hot.end(); it = hot.find(key)) {
+            hot_bytes -= this->footprint(*it);
+            hot.erase(it);
+            ++removed;
+        }
+        auto cold_range = cold_index.equal_range(key);
+        for (auto it = cold_range.first; it != cold_range.second; ++it) {
+            cold_entry_t &entry = cold[it->second];
+            if (entry.cached) {
+                cached_bytes -= this->footprint(*entry.cached);
+                entry.cached.reset();
+            }
+            entry.alive = false;
+            index_bytes -= this->key_footprint(it->first);
+            --cold_alive;
+            ++removed;
+        }
+        cold_index.erase(cold_range.first, cold_range.second);
+        if (cold.size() - cold_alive > cold_alive) {
+            this->compact_cold();
+        }
+        return removed;
+    }
+
+    /// @brief Returns an iterator to the first element, in insertion order,
+    /// associated with the given key, reading it from disk if it was spilled.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the list if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        auto cold_it = cold_index.find(key);
+        if (cold_it != cold_index.end()) {
+            // Spilled entries are older than the ones in memory.
+            return const_iterator(this, cold_it->second, hot.begin());
+        }
+        return const_iterator(this, cold.size(), hot.find(key));
+    }
+
+    /// @brief Checks whether at least one element with the given key exists.
+    /// @param key The key to check.
+    /// @return True if the key exists, false otherwise.
+    auto has(const Key &key) const -> bool { return cold_index.find(key) != cold_index.end() || hot.has(key); }
+
+    /// @brief Counts the number of elements associated with the given key.
+    /// @param key The key to count occurrences for.
+    /// @return The number of elements associated with the key.
+    auto count(const Key &key) const -> std::size_t { return cold_index.count(key) + hot.count(key); }
+
+private:
+    /// @brief An entry spilled to the segment file.
+    struct cold_entry_t {
+        /// @brief The offset of the entry in the segment file.
+        std::uint64_t offset;
+        /// @brief The number of bytes of the entry.
+        std::uint64_t length;
+        /// @brief The entry read back from the segment, if any.
+        std::unique_ptr<list_entry_t> cached;
+        /// @brief If the entry was not erased.
+        bool alive;
+    };
+
+    /// @brief Estimates the memory used by an entry in memory.
+    /// @param entry the entry.
+    /// @return the number of bytes.
+    static auto footprint(const list_entry_t &entry) -> std::size_t
+    {
+        // A list node, and an index node holding a copy of the key.
+        return sizeof(list_entry_t) + 2U * sizeof(void *) + key_footprint(entry.first) + detail::heap_size(entry.second);
+    }
+
+    /// @brief Estimates the memory used by the index entry of a key.
+    /// @param key the key.
+    /// @return the number of bytes.
+    static auto key_footprint(const Key &key) -> std::size_t
+    {
+        return sizeof(Key) + 2U * detail::heap_size(key) + 5U * sizeof(void *);
+    }
+
+    /// @brief Returns the first spilled entry not erased, starting from the
+    /// given position.
+    /// @param position the position.
+    /// @return the position of the entry, or the number of spilled entries.
+    auto next_alive(std::size_t position) const -> std::size_t
+    {
+        while (position < cold.size() && !cold[position].alive) {
+            ++position;
+        }
+        return position;
+    }
+
+    /// @brief Returns a spilled entry, reading it from the segment if needed.
+    /// @param position the position of the entry.
+    /// @return a reference to the entry.
+    /// @throws std::runtime_error if the entry cannot be read, or decoded.
+    auto fault(std::size_t position) const -> const list_entry_t &
+    {
+        cold_entry_t &entry = cold[position];
+        if (!entry.cached) {
+            std::string bytes(static_cast<std::size_t>(entry.length), '\0');
+            if (segment == nullptr || !detail::seek_file(segment, entry.offset) ||
+                std::fread(&bytes[0], 1U, bytes.size(), segment) != bytes.size()) {
+                throw std::runtime_error("tiered_ordered_multimap_t: cannot read a spilled entry");
+            }
+            std::istringstream is(bytes);
+            Key key     = codec<Key>::read(is);
+            Value value = codec<Value>::read(is);
+            if (!is) {
+                throw std::runtime_error("tiered_ordered_multimap_t: cannot decode a spilled entry");
+            }
+            if (this->memory_usage() > budget) {
+                this->drop_cache();
+            }
+            entry.cached.reset(new list_entry_t(std::move(key), std::move(value)));
+            cached_bytes += footprint(*entry.cached);
+            cached_positions.push_back(position);
+        }
+        return *entry.cached;
+    }
+
+    /// @brief Drops the positions of the erased spilled entries.
+    /// @details Their bytes stay in the segment file, until it is cleared.
+    void compact_cold()
+    {
+        this->drop_cache();
+        std::vector<std::size_t> moved(cold.size(), 0U);
+        std::deque<cold_entry_t> alive;
+        for (std::size_t position = 0; position < cold.size(); ++position) {
+            if (cold[position].alive) {
+                moved[position] = alive.size();
+                alive.push_back(std::move(cold[position]));
+            }
+        }
+        for (auto &indexed : cold_index) {
+            indexed.second = moved[indexed.second];
+        }
+        cold.swap(alive);
+    }
+
+    /// @brief Drops the cached spilled entries.
+    void drop_cache() const
+    {
+        for (std::size_t position : cached_positions) {
+            if (cold[position].cached) {
+                cached_bytes -= footprint(*cold[position].cached);
+                cold[position].cached.reset();
+            }
+        }
+        cached_positions.clear();
+    }
+
+    /// @brief Spills the oldest entries in memory, while over budget.
+    /// @details The newest entry always stays in memory.
+    /// @return false if an entry could not be written to the segment, it is
+    /// then kept in memory.
+    auto enforce_budget() -> bool
+    {
+        if (segment == nullptr || this->memory_usage() <= budget) {
+            return true;
+        }
+        this->drop_cache();
+        std::ostringstream os;
+        while (this->memory_usage() > budget && hot.size() > 1U) {
+            auto oldest = hot.begin();
+            os.str(std::string());
+            codec<Key>::write(os, oldest->first);
+            codec<Value>::write(os, oldest->second);
+            const std::string bytes = os.str();
+            if (!os || !detail::seek_file(segment, segment_size) ||
+                std::fwrite(bytes.data(), 1U, bytes.size(), segment) != bytes.size()) {
+                return false;
+            }
+            cold.push_back(cold_entry_t{segment_size, bytes.size(), nullptr, true});
+            segment_size += bytes.size();
+            cold_index.insert(std::make_pair(oldest->first, cold.size() - 1U));
+            index_bytes += key_footprint(oldest->first);
+            hot_bytes -= footprint(*oldest);
+            ++cold_alive;
+            hot.erase(oldest);
+        }
+        return std::fflush(segment) == 0;
+    }
+
+    /// @brief The newest entries, in memory.
+    map_t hot;
+    /// @brief The entries spilled to the segment, in insertion order.
+    mutable std::deque<cold_entry_t> cold;
+    /// @brief The positions of the cached spilled entries.
+    mutable std::vector<std::size_t> cached_positions;
+    /// @brief The keys of the spilled entries, and their positions.
+    std::multimap<Key, std::size_t> cold_index;
+    /// @brief The number of spilled entries not erased.
+    std::size_t cold_alive;
+    /// @brief The segment file.
+    std::FILE *segment;
+    /// @brief The path of the segment file.
+    std::string segment_path;
+    /// @brief The number of bytes written to the segment file.
+    std::uint64_t segment_size;
+    /// @brief The maximum memory used by the entries.
+    std::size_t budget;
+    /// @brief The memory used by the entries in memory.
+    std::size_t hot_bytes;
+    /// @brief The memory used by the keys of the spilled entries.
+    std::size_t index_bytes;
+    /// @brief The memory used by the cached spilled entries.
+    mutable std::size_t cached_bytes;
+};
+
+} // namespace ordered_multimap
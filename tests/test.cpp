@@ -7,12 +7,50 @@
 /// run with `ctest` using plain assertions (no external framework).
 ///
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ordered_multimap/bloom_index.hpp"
+#include "ordered_multimap/btree_index.hpp"
+#include "ordered_multimap/buffered_ordered_multimap.hpp"
+#include "ordered_multimap/checkpointed_ordered_multimap.hpp"
+#include "ordered_multimap/compact_ordered_multimap.hpp"
+#include "ordered_multimap/concurrent_append_buffer.hpp"
+#include "ordered_multimap/direct_index.hpp"
+#include "ordered_multimap/eytzinger_index.hpp"
+#include "ordered_multimap/flat_index.hpp"
+#include "ordered_multimap/frozen_ordered_multimap.hpp"
+#include "ordered_multimap/interned_ordered_multimap.hpp"
+#include "ordered_multimap/journaled_ordered_multimap.hpp"
+#include "ordered_multimap/mapped_file.hpp"
+#include "ordered_multimap/mapped_ordered_multimap.hpp"
 #include "ordered_multimap/ordered_multimap.hpp"
+#include "ordered_multimap/parallel.hpp"
+#include "ordered_multimap/radix_index.hpp"
+#include "ordered_multimap/shared_ordered_multimap.hpp"
+#include "ordered_multimap/small_ordered_multimap.hpp"
+#include "ordered_multimap/static_ordered_multimap.hpp"
+#include "ordered_multimap/tiered_ordered_multimap.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 using Table = ordered_multimap::ordered_multimap_t<std::string, int>;
 
@@ -532,6 +570,2104 @@ void test_to_vector()
     assert(vec[2] == std::make_pair(std::string("a"), 3));
 }
 
+void test_concurrent_append_buffer()
+{
+    std::cout << ">>> test_concurrent_append_buffer\n";
+
+    const int producers = 4;
+    const int per_thread = 5000;
+
+    // Use tiny segments, so that producers race on segment allocation, and
+    // fill the ring faster than it is drained.
+    ordered_multimap::concurrent_append_buffer_t<std::string, int> buffer(4);
+    const std::size_t total = static_cast<std::size_t>(producers * per_thread);
+    assert(buffer.capacity() < total);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&buffer, p, per_thread]() {
+            for (int i = 0; i < per_thread; ++i) {
+                while (!buffer.insert("p" + std::to_string(p), i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Drain while producers append, segments are reused by later entries.
+    Table table;
+    table.insert("head", -1);
+    std::size_t received = 0;
+    while (received < total) {
+        received += buffer.drain_into(table);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    assert(buffer.size() == 0);
+    assert(table.size() == total + 1);
+    assert(table.front()->first == "head");
+
+    // Entries of each producer keep the order in which they were appended.
+    std::vector<int> last(producers, -1);
+    for (auto it = std::next(table.begin()); it != table.end(); ++it) {
+        int p = it->first[1] - '0';
+        assert(it->second == last[static_cast<std::size_t>(p)] + 1);
+        last[static_cast<std::size_t>(p)] = it->second;
+    }
+    for (int p = 0; p < producers; ++p) {
+        assert(table.count("p" + std::to_string(p)) == static_cast<std::size_t>(per_thread));
+    }
+
+    // A full buffer refuses entries, until it is drained.
+    table.clear();
+    std::size_t accepted = 0;
+    while (buffer.insert("full", static_cast<int>(accepted))) {
+        ++accepted;
+    }
+    assert(accepted > 0 && accepted <= buffer.capacity());
+    std::size_t drained = buffer.drain_into(table);
+    assert(drained == accepted);
+    bool inserted = buffer.insert("tail", 7);
+    assert(inserted);
+    drained = buffer.drain_into(table);
+    assert(drained == 1);
+    assert(table.back()->first == "tail");
+
+    // A segment which cannot be allocated reserves no slot, hence later
+    // drains do not wait for it.
+    ordered_multimap::concurrent_append_buffer_t<std::string, int> huge((std::numeric_limits<std::size_t>::max() >> 2U) + 1U);
+    bool thrown = false;
+    try {
+        huge.insert("a", 1);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(huge.size() == 0);
+    drained = huge.drain_into(table);
+    assert(drained == 0);
+}
+
+void test_buffered_ordered_multimap()
+{
+    std::cout << ">>> test_buffered_ordered_multimap\n";
+
+    using Shared = ordered_multimap::buffered_ordered_multimap_t<std::string, int>;
+
+    Shared shared;
+    {
+        Shared::writer_t writer(shared);
+        writer.insert("a", 1);
+        writer.emplace("b", 2);
+        assert(writer.pending() == 2);
+        // Nothing is visible before the flush.
+        assert(shared.size() == 0);
+        writer.flush();
+        assert(writer.pending() == 0);
+        assert(shared.read([](const Table &map) { return map.count("a") + map.count("b"); }) == 2);
+    }
+
+    const int writers    = 4;
+    const int per_thread = 1000;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&shared, w, per_thread]() {
+            Shared::writer_t writer(shared);
+            for (int i = 0; i < per_thread; ++i) {
+                writer.insert("w" + std::to_string(w), i);
+                if (i % 100 == 99) {
+                    writer.flush();
+                }
+            }
+        });
+    }
+    for (int round = 0; round < 10; ++round) {
+        shared.flush();
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    Table snapshot = shared.snapshot();
+    assert(snapshot.size() == static_cast<std::size_t>(writers * per_thread) + 2);
+    std::vector<int> last(writers, -1);
+    for (const auto &entry : snapshot) {
+        if (entry.first[0] == 'w') {
+            int w = entry.first[1] - '0';
+            assert(entry.second == last[static_cast<std::size_t>(w)] + 1);
+            last[static_cast<std::size_t>(w)] = entry.second;
+        }
+    }
+
+    // Merging splices the nodes, iterators follow them into the new map.
+    Table table1;
+    Table table2;
+    table1.insert("x", 1);
+    auto it = table2.insert("y", 2);
+    table2.insert("x", 3);
+    table1.merge(std::move(table2));
+    assert(it->first == "y");
+    assert(table1.find("y") == it);
+    assert(table1.count("x") == 2);
+    assert(table1.find("x")->second == 1);
+}
+
+void test_erase_iterator_with_duplicates()
+{
+    std::cout << ">>> test_erase_iterator_with_duplicates\n";
+
+    Table table;
+    table.insert("a", 1);
+    auto second = table.insert("a", 2);
+    table.insert("a", 3);
+
+    auto next = table.erase(second);
+    assert(next->second == 3);
+    assert(table.count("a") == 2);
+
+    // The index must still reach the remaining elements.
+    auto values = table.extract("a");
+    assert((values == std::vector<int>{1, 3}));
+    assert(table.size() == 0);
+}
+
+void test_parallel_algorithms()
+{
+    std::cout << ">>> test_parallel_algorithms\n";
+
+    ordered_multimap::thread_pool_t pool(3);
+
+    Table table;
+    for (int i = 0; i < 1000; ++i) {
+        table.insert("k" + std::to_string(i % 10), i);
+    }
+
+    ordered_multimap::parallel_for_each(pool, table, [](Table::list_entry_t &entry) { entry.second *= 2; });
+    assert(table.front()->second == 0);
+    assert(table.back()->second == 1998);
+
+    ordered_multimap::parallel_transform_values(pool, table, [](const int &value) { return value / 2; });
+    assert(table.at(500)->second == 500);
+
+    auto is_odd = [](const Table::list_entry_t &entry) { return entry.second % 2 != 0; };
+    assert(ordered_multimap::parallel_count_if(pool, table, is_odd) == 500);
+    assert(ordered_multimap::parallel_count_if(table, is_odd) == 500);
+
+    std::size_t erased = ordered_multimap::parallel_erase_if(pool, table, is_odd);
+    assert(erased == 500);
+    assert(table.size() == 500);
+    assert(table.count("k1") == 0);
+    assert(table.count("k2") == 100);
+    int expected = 0;
+    for (const auto &entry : table) {
+        assert(entry.second == expected);
+        expected += 2;
+    }
+
+    // Exceptions thrown by the tasks reach the caller.
+    bool thrown = false;
+    try {
+        pool.parallel_for(8, [](std::size_t index) {
+            if (index == 5) {
+                throw std::runtime_error("task");
+            }
+        });
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // Empty maps are fine too.
+    Table empty;
+    erased = ordered_multimap::parallel_erase_if(pool, empty, is_odd);
+    assert(erased == 0);
+}
+
+void test_build_parallel()
+{
+    std::cout << ">>> test_build_parallel\n";
+
+    std::vector<std::pair<std::string, int>> input;
+    for (int i = 0; i < 10007; ++i) {
+        input.emplace_back("k" + std::to_string((i * 7919) % 101), i);
+    }
+
+    Table sequential(input.begin(), input.end());
+    assert(sequential.size() == input.size());
+
+    ordered_multimap::thread_pool_t pool(3);
+    Table parallel = ordered_multimap::build_parallel(pool, input.begin(), input.end());
+    Table with_threads = ordered_multimap::build_parallel(input.begin(), input.end(), 2);
+
+    assert(parallel.to_vector() == input);
+    assert(with_threads.to_vector() == input);
+    for (int k = 0; k < 101; ++k) {
+        std::string key = "k" + std::to_string(k);
+        assert(parallel.count(key) == sequential.count(key));
+        // Duplicates are indexed in insertion order.
+        auto values = parallel.extract(key);
+        assert(std::is_sorted(values.begin(), values.end()));
+    }
+    assert(parallel.size() == 0);
+
+    // Merging two maps of similar size rebuilds the index in one pass.
+    Table left(input.begin(), input.begin() + 100);
+    Table right(input.begin() + 100, input.begin() + 200);
+    left.merge(std::move(right));
+    assert(left.size() == 200);
+    assert(left.find("k0")->second == 0);
+    auto values = left.extract("k0");
+    assert(std::is_sorted(values.begin(), values.end()));
+}
+
+enum class Color : unsigned char { red, green, blue };
+
+void test_save_and_load()
+{
+    std::cout << ">>> test_save_and_load\n";
+
+    Table table;
+    table.insert("b", -2);
+    table.insert("a", 1);
+    table.insert("b", 300000);
+    table.insert("", 0);
+
+    std::stringstream stream;
+    bool saved = table.save(stream);
+    assert(saved);
+
+    Table loaded;
+    loaded.insert("stale", 1);
+    bool restored = loaded.load(stream);
+    assert(restored);
+    assert(loaded.to_vector() == table.to_vector());
+    assert(!loaded.has("stale"));
+    auto values = loaded.extract("b");
+    assert((values == std::vector<int>{-2, 300000}));
+
+    // Composite and user-defined types go through their codecs.
+    ordered_multimap::ordered_multimap_t<Color, std::pair<double, std::vector<std::string>>> colors;
+    colors.insert(Color::blue, std::make_pair(0.5, std::vector<std::string>{"x", "y"}));
+    colors.insert(Color::red, std::make_pair(-1.25, std::vector<std::string>{}));
+    std::stringstream color_stream;
+    saved = colors.save(color_stream);
+    assert(saved);
+    decltype(colors) colors_loaded;
+    restored = colors_loaded.load(color_stream);
+    assert(restored);
+    assert(colors_loaded.to_vector() == colors.to_vector());
+    assert(colors_loaded.find(Color::blue)->second.second.size() == 2);
+
+    // Truncated or foreign streams are rejected, and leave the map empty.
+    std::string bytes = stream.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 3));
+    restored = loaded.load(truncated);
+    assert(!restored);
+    assert(loaded.size() == 0);
+    std::stringstream garbage("not a map");
+    restored = loaded.load(garbage);
+    assert(!restored);
+
+    // Small sizes and values take a single byte.
+    std::stringstream small;
+    ordered_multimap::ordered_multimap_t<unsigned, int> numbers;
+    numbers.insert(1U, -1);
+    numbers.save(small);
+    assert(small.str().size() == 4 + 1 + 1 + 1);
+
+    // Characters take the same bytes whether char is signed or not.
+    std::stringstream characters;
+    ordered_multimap::codec<char>::write(characters, static_cast<char>(0xE9));
+    ordered_multimap::codec<char>::write(characters, 'a');
+    assert(characters.str() == std::string("\xE9\x01" "a"));
+    char first  = ordered_multimap::codec<char>::read(characters);
+    char second = ordered_multimap::codec<char>::read(characters);
+    assert(first == static_cast<char>(0xE9) && second == 'a');
+
+    // Values which do not fit the type fail, instead of being truncated.
+    std::stringstream wide;
+    ordered_multimap::codec<std::uint32_t>::write(wide, 300U);
+    ordered_multimap::codec<std::int32_t>::write(wide, -129);
+    ordered_multimap::codec<std::uint8_t>::read(wide);
+    assert(!wide);
+    wide.clear();
+    ordered_multimap::codec<std::int8_t>::read(wide);
+    assert(!wide);
+}
+
+void test_frozen_ordered_multimap()
+{
+    std::cout << ">>> test_frozen_ordered_multimap\n";
+
+    Table table;
+    table.insert("b", 1);
+    table.insert("a", 2);
+    table.insert("b", 3);
+    table.insert("ccc", 4);
+
+    std::vector<char> block = ordered_multimap::freeze(table);
+    ordered_multimap::frozen_ordered_multimap_t<std::string, int> frozen(block.data(), block.size());
+    assert(frozen.size() == 4);
+
+    // Iteration follows insertion order.
+    std::ostringstream oss;
+    for (auto it = frozen.begin(); it != frozen.end(); ++it) {
+        oss << it->first.str() << ":" << it->second << " ";
+    }
+    assert(oss.str() == "b:1 a:2 b:3 ccc:4 ");
+    assert(frozen.at(2).value() == 3);
+    assert(frozen.at(9) == frozen.end());
+
+    // Lookups query the block directly.
+    assert(frozen.find("b").value() == 1);
+    assert(frozen.find("b").index() == 0);
+    assert(frozen.find("ccc").key() == std::string("ccc"));
+    assert(frozen.find("zz") == frozen.end());
+    assert(frozen.has("a"));
+    assert(!frozen.has("aa"));
+    assert(frozen.count("b") == 2);
+    assert(frozen.count("x") == 0);
+    auto range = frozen.equal_range("b");
+    std::vector<int> values;
+    for (auto it = range.first; it != range.second; ++it) {
+        values.push_back(it.value());
+    }
+    assert((values == std::vector<int>{1, 3}));
+    assert(frozen.thaw().to_vector() == table.to_vector());
+
+    // The block is position independent, it can go through a file.
+    const std::string path = "ordered_multimap_frozen_test.bin";
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        bool written = ordered_multimap::freeze(table, file);
+        assert(written);
+    }
+    {
+        ordered_multimap::mapped_file_t file;
+        bool opened = file.open(path);
+        assert(opened);
+        ordered_multimap::frozen_ordered_multimap_t<std::string, int> mapped;
+        bool attached = mapped.attach(file.data(), file.size());
+        assert(attached);
+        assert(mapped.count("b") == 2);
+        assert(mapped.find("ccc").value() == 4);
+    }
+    std::remove(path.c_str());
+
+    // Invalid blocks are rejected.
+    ordered_multimap::frozen_ordered_multimap_t<std::string, int> invalid;
+    bool attached = invalid.attach(block.data(), block.size() / 2);
+    assert(!attached);
+    assert(invalid.empty());
+    assert(invalid.begin() == invalid.end());
+
+    // Trivially copyable keys and values are stored as their bytes.
+    ordered_multimap::ordered_multimap_t<int, double> numbers;
+    numbers.insert(3, 0.5);
+    numbers.insert(-1, 1.5);
+    std::vector<char> numbers_block = ordered_multimap::freeze(numbers);
+    ordered_multimap::frozen_ordered_multimap_t<int, double> frozen_numbers(numbers_block.data(), numbers_block.size());
+    assert(frozen_numbers.find(-1).value() > 1.0);
+    assert(frozen_numbers.begin()->first == 3);
+
+    // Maps with any index freeze to the same block.
+    ordered_multimap::ordered_multimap_t<int, double, ordered_multimap::flat_index_t> flat;
+    ordered_multimap::ordered_multimap_t<int, double, ordered_multimap::btree_index_t> btree;
+    for (const auto &entry : numbers) {
+        flat.insert(entry.first, entry.second);
+        btree.insert(entry.first, entry.second);
+    }
+    assert(ordered_multimap::freeze(flat) == numbers_block);
+    assert(ordered_multimap::freeze(btree) == numbers_block);
+}
+
+using Journaled = ordered_multimap::journaled_ordered_multimap_t<std::string, int>;
+
+/// @brief Removes the files of a journaled map.
+void remove_journal(const std::string &prefix)
+{
+    std::remove((prefix + ".snapshot").c_str());
+    std::remove((prefix + ".snapshot.tmp").c_str());
+    std::remove((prefix + ".journal").c_str());
+}
+
+/// @brief Applies the i-th operation of the crash test workload.
+template <typename Map> void journal_workload_step(Map &map, int i)
+{
+    if (i % 7 == 6) {
+        map.erase("k" + std::to_string(i % 3));
+    } else if (i % 11 == 10) {
+        map.update("k1", i);
+    } else if (i % 5 == 4 && map.size() > 0) {
+        map.erase(map.find("k" + std::to_string(i % 4)) == map.end() ? map.find("k0") : map.find("k" + std::to_string(i % 4)));
+    } else {
+        map.insert("k" + std::to_string(i % 4), i);
+    }
+}
+
+void test_journaled_ordered_multimap()
+{
+    std::cout << ">>> test_journaled_ordered_multimap\n";
+
+    const std::string prefix = "ordered_multimap_journal_test";
+    remove_journal(prefix);
+
+    auto descending = [](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) {
+        return lhs.second > rhs.second;
+    };
+
+    Table expected;
+    {
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(opened);
+        journaled.set_group_size(3);
+        journaled.insert("a", 1);
+        journaled.emplace("b", 2);
+        journaled.insert("a", 3);
+        journaled.insert("c", 4);
+        journaled.update("c", 5);
+        journaled.erase("a", 3);
+        journaled.erase(journaled.find("b"));
+        journaled.insert("d", 6);
+        journaled.sort(descending);
+        journaled.insert("a", 7);
+        journaled.erase("z");
+        expected = journaled.map();
+        // Closing commits the last, incomplete, group.
+    }
+    {
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(opened);
+        assert(journaled.map().to_vector() == expected.to_vector());
+        assert(journaled.count("a") == 2);
+
+        // Compaction folds the journal into the snapshot.
+        bool compacted = journaled.compact();
+        assert(compacted);
+        journaled.insert("e", 8);
+        journaled.clear();
+        journaled.insert("f", 9);
+        journaled.commit();
+    }
+    {
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(opened);
+        assert(journaled.size() == 1);
+        assert(journaled.find("f")->second == 9);
+    }
+
+    // A torn record at the end of the journal is discarded.
+    {
+        std::FILE *file = std::fopen((prefix + ".journal").c_str(), "ab");
+        assert(file != nullptr);
+        const char torn[] = {1, 20, 'x'};
+        std::fwrite(torn, 1, sizeof(torn), file);
+        std::fclose(file);
+
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(opened);
+        assert(journaled.size() == 1);
+        journaled.insert("g", 10);
+    }
+    {
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(opened);
+        assert(journaled.size() == 2);
+        assert(journaled.has("g"));
+    }
+    remove_journal(prefix);
+
+    // A journal newer than the snapshot, as left by a rename undone by a
+    // power loss, makes open fail, instead of being compacted away.
+    {
+        std::string old_snapshot;
+        {
+            Journaled journaled;
+            bool opened = journaled.open(prefix);
+            assert(opened);
+            journaled.insert("a", 1);
+            bool compacted = journaled.compact();
+            assert(compacted);
+            ordered_multimap::detail::read_file(prefix + ".snapshot", old_snapshot);
+            journaled.insert("b", 2);
+            compacted = journaled.compact();
+            assert(compacted);
+            journaled.insert("c", 3);
+        }
+        bool reverted = ordered_multimap::detail::replace_file(prefix + ".snapshot", old_snapshot);
+        assert(reverted);
+        std::string before;
+        std::string after;
+        ordered_multimap::detail::read_file(prefix + ".journal", before);
+
+        Journaled journaled;
+        bool opened = journaled.open(prefix);
+        assert(!opened);
+        assert(!journaled.good());
+        ordered_multimap::detail::read_file(prefix + ".journal", after);
+        assert(!before.empty() && before == after);
+    }
+    remove_journal(prefix);
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Kill a writer at a random point, every change it committed must survive.
+    for (int round = 0; round < 3; ++round) {
+        pid_t child = fork();
+        assert(child >= 0);
+        if (child == 0) {
+            Journaled journaled;
+            if (!journaled.open(prefix)) {
+                _exit(1);
+            }
+            journaled.set_group_size(1);
+            for (int i = 0; i < 100000; ++i) {
+                journal_workload_step(journaled, i);
+            }
+            _exit(0);
+        }
+        usleep(static_cast<useconds_t>(20000 + round * 15000));
+        kill(child, SIGKILL);
+        int status = 0;
+        waitpid(child, &status, 0);
+
+        Journaled recovered;
+        bool opened = recovered.open(prefix);
+        assert(opened);
+        auto actual = recovered.map().to_vector();
+        recovered.close();
+
+        // The recovered map matches a prefix of the workload.
+        Table replica;
+        bool found = replica.to_vector() == actual;
+        for (int i = 0; !found && i < 100000; ++i) {
+            journal_workload_step(replica, i);
+            found = replica.to_vector() == actual;
+        }
+        assert(found);
+        remove_journal(prefix);
+    }
+
+    // A writer whose journal cannot grow keeps every committed change, and
+    // refuses changes after the first failed commit.
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        std::signal(SIGXFSZ, SIG_IGN);
+        struct rlimit limit = {4096, 4096};
+        Journaled journaled;
+        if (setrlimit(RLIMIT_FSIZE, &limit) != 0 || !journaled.open(prefix)) {
+            _exit(255);
+        }
+        journaled.set_group_size(1);
+        const std::string key(100, 'k');
+        int committed = 0;
+        while (journaled.good() && committed < 200) {
+            journaled.insert(key, committed);
+            committed += journaled.good() ? 1 : 0;
+        }
+        if (journaled.good() || journaled.insert(key, -1) != journaled.end() || journaled.clear()) {
+            _exit(254);
+        }
+        _exit(committed);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) > 0 && WEXITSTATUS(status) < 200);
+    {
+        Journaled recovered;
+        bool opened = recovered.open(prefix);
+        assert(opened);
+        assert(recovered.size() == static_cast<std::size_t>(WEXITSTATUS(status)));
+        assert(std::prev(recovered.end())->second == WEXITSTATUS(status) - 1);
+        // The failed group was cut off, hence no torn tail forced a compaction.
+        std::ifstream snapshot((prefix + ".snapshot").c_str());
+        assert(!snapshot);
+    }
+    remove_journal(prefix);
+#endif
+
+    // A closed map refuses changes, instead of dropping them from the journal.
+    Journaled closed;
+    assert(!closed.good());
+    auto refused = closed.insert("a", 1);
+    assert(refused == closed.end());
+    assert(closed.size() == 0);
+}
+
+void test_checkpointed_ordered_multimap()
+{
+    std::cout << ">>> test_checkpointed_ordered_multimap\n";
+
+    const std::string path = "ordered_multimap_checkpoint_test.bin";
+    ordered_multimap::checkpointed_ordered_multimap_t<std::string, int> table;
+    for (int i = 0; i < 1000; ++i) {
+        table.insert("k" + std::to_string(i % 10), i);
+    }
+    auto expected = table.read([](const Table &map) { return map.to_vector(); });
+
+    bool started = table.checkpoint(path);
+    assert(started);
+    // Writers keep going while the checkpoint is written.
+    for (int i = 0; i < 1000; ++i) {
+        table.insert("n" + std::to_string(i), i);
+    }
+    std::size_t erased = table.erase("k0");
+    assert(erased == 100);
+    bool finished = table.wait();
+    assert(finished);
+    assert(!table.checkpointing());
+
+    auto stats = table.last_checkpoint();
+    assert(stats.success);
+    assert(stats.entries == 1000);
+    assert(stats.bytes > 0);
+    assert(table.size() == 1900);
+
+    // The file holds the state as of the start of the checkpoint.
+    ordered_multimap::checkpointed_ordered_multimap_t<std::string, int> restored;
+    bool recovered = restored.restore(path);
+    assert(recovered);
+    assert(restored.read([](const Table &map) { return map.to_vector(); }) == expected);
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+    Table loaded;
+    bool read = loaded.load(file);
+    assert(read);
+    assert(loaded.size() == 1000);
+    file.close();
+
+    // The next checkpoint replays the changes logged since, erasures included.
+    expected = table.read([](const Table &map) { return map.to_vector(); });
+    started  = table.checkpoint(path);
+    assert(started);
+    table.insert("k1", -1);
+    finished = table.wait();
+    assert(finished);
+    recovered = restored.restore(path);
+    assert(recovered);
+    assert(restored.read([](const Table &map) { return map.to_vector(); }) == expected);
+
+    // Changes made through write are not logged, the map is copied instead.
+    table.write([](Table &map) { map.erase(map.begin()); });
+    table.erase("n5");
+    expected = table.read([](const Table &map) { return map.to_vector(); });
+    started  = table.checkpoint(path);
+    assert(started);
+    finished = table.wait();
+    assert(finished);
+    recovered = restored.restore(path);
+    assert(recovered);
+    assert(restored.read([](const Table &map) { return map.to_vector(); }) == expected);
+    assert(table.last_checkpoint().entries == expected.size());
+
+    recovered = restored.restore(path + ".missing");
+    assert(!recovered);
+    std::remove(path.c_str());
+}
+
+void test_mapped_ordered_multimap()
+{
+    std::cout << ">>> test_mapped_ordered_multimap\n";
+
+    using Mapped = ordered_multimap::mapped_ordered_multimap_t<int, long>;
+
+    const std::string path = "ordered_multimap_mapped_test.bin";
+    std::remove(path.c_str());
+    {
+        Mapped table;
+        // Small chunks, to exercise the growth of the file.
+        bool opened = table.open(path, 4096U);
+        assert(opened);
+        assert(table.empty());
+        table.insert(1, 15);
+        table.insert(2, 25);
+        table.emplace(1, 35);
+        table.insert(3, 45);
+        assert(table.size() == 4);
+        assert(table.count(1) == 2);
+        assert(table.find(1)->second == 15);
+        assert(table.has(3));
+        assert(!table.has(4));
+        assert(table.find(4) == table.end());
+        auto updated = table.update(2, 55);
+        assert(updated->second == 55);
+        std::size_t erased = table.erase(1, 35);
+        assert(erased == 1);
+        erased = table.erase(1, 35);
+        assert(erased == 0);
+        auto next = table.erase(3);
+        assert(next == table.end());
+        next = table.erase(table.begin());
+        assert(next->first == 2);
+
+        // Enough entries to grow the file and the index several times.
+        for (int i = 0; i < 10000; ++i) {
+            table.insert(i % 1000, i);
+        }
+        assert(table.file_size() > 4096U);
+        assert(table.size() == 10001);
+        assert(table.count(7) == 10);
+        assert(table.find(7)->second == 7);
+        assert(table.index_of(table.find(7)) == 8);
+        assert(table.at(1)->first == 0);
+        assert(table.back()->first == 999);
+        assert((--table.end())->first == 999);
+
+        // Erasing every key twice frees nodes, which are reused.
+        for (int i = 0; i < 1000; i += 2) {
+            table.erase(i);
+        }
+        std::size_t size = table.file_size();
+        for (int i = 0; i < 1000; ++i) {
+            table.insert(-1, i);
+        }
+        assert(table.file_size() == size);
+        bool synced = table.sync();
+        assert(synced);
+    }
+    {
+        // The content survives reopening.
+        Mapped table;
+        bool opened = table.open(path);
+        assert(opened);
+        assert(table.size() == 6000);
+        assert(table.front()->first == 1);
+        assert(table.front()->second == 1);
+        assert(table.count(7) == 10);
+        assert(table.count(8) == 0);
+        assert(table.count(-1) == 1000);
+        std::size_t count = 0;
+        for (const auto &entry : table) {
+            count += entry.first == 7 ? 1U : 0U;
+        }
+        assert(count == 10);
+
+        // Groups stay consistent when their first, middle and last entries go.
+        auto range = table.equal_range(7);
+        assert(range.first == table.find(7));
+        assert(std::prev(range.second)->first == 7);
+        std::size_t erased = table.erase(7, 7);
+        erased += table.erase(7, 5007);
+        erased += table.erase(7, 9007);
+        assert(erased == 3);
+        assert(table.find(7)->second == 1007);
+        assert(table.count(7) == 7);
+        std::vector<long> values = table.extract(7);
+        assert(values.size() == 7 && values.front() == 1007 && values.back() == 8007);
+        assert(!table.has(7));
+        assert(table.rbegin()->first == -1 && table.rbegin()->second == 999);
+        table.clear();
+        assert(table.empty());
+        assert(table.begin() == table.end());
+    }
+    {
+        // A closed map behaves as an empty one.
+        Mapped table;
+        assert(table.size() == 0 && table.empty());
+        assert(table.begin() == table.end());
+        assert(table.find(1) == table.end() && !table.has(1) && table.count(1) == 0);
+        auto inserted = table.insert(1, 1);
+        assert(inserted == table.end());
+        auto next = table.erase(1);
+        assert(next == table.end());
+        table.clear();
+    }
+    {
+        // Files written for other types are rejected.
+        ordered_multimap::mapped_ordered_multimap_t<int, char> other;
+        bool opened = other.open(path);
+        assert(!opened);
+    }
+    std::remove(path.c_str());
+}
+
+void test_shared_ordered_multimap()
+{
+    std::cout << ">>> test_shared_ordered_multimap\n";
+
+#if defined(__unix__) || defined(__APPLE__)
+    using Shared = ordered_multimap::shared_ordered_multimap_t<int, int>;
+    using Map    = Shared::map_t;
+
+    const std::string name = "/ordered_multimap_shared_test";
+    Shared::remove(name);
+
+    Shared table;
+    bool opened = table.open(name, 4096U);
+    assert(opened);
+    table.write([](Map &map) {
+        for (int i = 0; i < 100; ++i) {
+            map.insert(i, i);
+        }
+    });
+
+    // A writer process grows the map, while this process reads it.
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        Shared writer;
+        if (!writer.open(name, 4096U)) {
+            _exit(1);
+        }
+        for (int i = 0; i < 200; ++i) {
+            writer.write([i](Map &map) {
+                for (int j = 0; j < 100; ++j) {
+                    map.insert(1000 + i, j);
+                }
+            });
+        }
+        _exit(0);
+    }
+    // Threads of this process read concurrently, and remap the grown map.
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&table]() {
+            std::size_t last = 0;
+            for (int i = 0; i < 200; ++i) {
+                std::size_t size = table.read([](const Map &map) {
+                    // Writes are atomic: either all the values of a key, or none.
+                    std::size_t count = map.count(1000 + static_cast<int>(map.size() / 100U) - 2);
+                    assert(count == 100 || map.size() == 100);
+                    return map.size();
+                });
+                assert(size >= last && size % 100U == 0);
+                last = size;
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    table.read([](const Map &map) {
+        assert(map.size() == 20100);
+        assert(map.count(1199) == 100);
+        assert(map.find(50)->second == 50);
+        return 0;
+    });
+
+    // Another process sees the same content.
+    Shared reader;
+    opened = reader.open(name);
+    assert(opened);
+    assert(reader.read([](const Map &map) { return map.size(); }) == 20100);
+    reader.close();
+    table.close();
+    bool removed = Shared::remove(name);
+    assert(removed);
+    removed = Shared::remove(name);
+    assert(!removed);
+
+    // A lock left half-initialized by a dead process makes open give up,
+    // until the map is removed.
+    {
+        ordered_multimap::mapped_region_t control;
+        opened = control.open_shared(name + ".lock", 4096U);
+        assert(opened);
+        const std::uint32_t initializing = 1U;
+        std::memcpy(control.data(), &initializing, sizeof(initializing));
+        control.close();
+        Shared stuck;
+        opened = stuck.open(name);
+        assert(!opened);
+        Shared::remove(name);
+        opened = stuck.open(name);
+        assert(opened);
+        stuck.close();
+        Shared::remove(name);
+    }
+
+    // A closed map fails instead of calling the function.
+    bool failed = false;
+    try {
+        table.read([](const Map &) { return 0; });
+    } catch (const std::runtime_error &) {
+        failed = true;
+    }
+    assert(failed);
+#endif
+}
+
+void test_tiered_ordered_multimap()
+{
+    std::cout << ">>> test_tiered_ordered_multimap\n";
+
+    const std::string path = "ordered_multimap_tiered_test.bin";
+    ordered_multimap::tiered_ordered_multimap_t<std::string, std::string> table;
+    bool opened = table.open(path);
+    assert(opened);
+    // The keys and positions of the spilled entries stay in memory, and take
+    // most of it.
+    const std::size_t budget = 256U * 1024U;
+    table.set_memory_budget(budget);
+
+    for (int i = 0; i < 2000; ++i) {
+        std::string key   = "event." + std::to_string(i % 50);
+        std::string value = "payload number " + std::to_string(i) + " of the event history";
+        table.insert(key, value);
+    }
+    table.emplace("last", 10U, 'x');
+    assert(table.size() == 2001);
+    assert(table.spilled() > 1000);
+    assert(table.memory_usage() <= budget);
+
+    // Spilled entries keep their keys indexed, and are read back on access.
+    assert(table.count("event.7") == 40);
+    assert(table.has("event.49"));
+    assert(!table.has("event.50"));
+    assert(table.find("event.7")->second == "payload number 7 of the event history");
+    assert(table.find("last")->second == "xxxxxxxxxx");
+    assert(table.find("missing") == table.end());
+
+    // Iteration walks the spilled entries first, in insertion order.
+    std::size_t position = 0;
+    for (const auto &entry : table) {
+        if (position < 2000) {
+            assert(entry.second == "payload number " + std::to_string(position) + " of the event history");
+        }
+        ++position;
+    }
+    assert(position == 2001);
+    // At most one entry read back exceeds the budget.
+    assert(table.memory_usage() <= budget + 256U);
+
+    // Erasing works across both tiers.
+    std::size_t erased = table.erase("event.0");
+    assert(erased == 40);
+    assert(table.size() == 1961);
+    assert(table.find("event.0") == table.end());
+    assert(table.begin()->first == "event.1");
+    assert(table.to_vector().size() == 1961);
+
+    // Erasing most spilled entries drops their positions from memory.
+    std::size_t before = table.memory_usage();
+    for (int i = 1; i < 40; ++i) {
+        table.erase("event." + std::to_string(i));
+    }
+    assert(table.memory_usage() < before / 2U);
+    assert(table.count("event.45") == 40);
+    assert(table.find("event.45")->second == "payload number 45 of the event history");
+    std::size_t alive = 0;
+    for (const auto &entry : table) {
+        (void)entry;
+        ++alive;
+    }
+    assert(alive == table.size());
+
+    table.clear();
+    assert(table.size() == 0);
+    assert(table.begin() == table.end());
+
+#if defined(__unix__) || defined(__APPLE__)
+    // A damaged segment fails to read back, instead of yielding empty entries.
+    bool inserted = true;
+    for (int i = 0; i < 2000; ++i) {
+        inserted = table.insert("key", "payload number " + std::to_string(i) + " of the event history") && inserted;
+    }
+    assert(inserted);
+    assert(table.spilled() > 0);
+    bool truncated = ordered_multimap::detail::truncate_file(path, 0);
+    assert(truncated);
+    bool failed = false;
+    try {
+        (void)table.begin()->second;
+    } catch (const std::runtime_error &) {
+        failed = true;
+    }
+    assert(failed);
+#endif
+    table.close();
+    std::ifstream removed(path.c_str());
+    assert(!removed);
+}
+
+void test_static_ordered_multimap()
+{
+    std::cout << ">>> test_static_ordered_multimap\n";
+
+#if ORDERED_MULTIMAP_HAS_STATIC_MAP
+    static constexpr auto commands = ordered_multimap::make_static_ordered_multimap<std::string_view, int>({
+        {"set", 1},
+        {"get", 2},
+        {"del", 3},
+        {"get", 4},
+        {"ping", 5},
+    });
+
+    // Everything is available at compile time.
+    static_assert(commands.size() == 5);
+    static_assert(commands.count("get") == 2);
+    static_assert(commands.count("quit") == 0);
+    static_assert(commands.find("del")->second == 3);
+    static_assert(commands.find("get")->second == 2);
+    static_assert(!commands.has("quit"));
+    static_assert(commands.begin()->first == "set");
+    static_assert(commands.at(4)->first == "ping");
+
+    // Iteration follows the declaration order.
+    std::vector<int> values;
+    for (const auto &entry : commands) {
+        values.push_back(entry.second);
+    }
+    assert((values == std::vector<int>{1, 2, 3, 4, 5}));
+
+    // Entries sharing a key keep their declaration order.
+    auto range = commands.equal_range("get");
+    assert(range.second - range.first == 2);
+    assert(range.first->second == 2);
+    assert(std::next(range.first)->second == 4);
+    assert(commands.equal_range("quit").first == commands.equal_range("quit").second);
+
+    // The key iterators support the random-access operations their category advertises.
+    static_assert(std::is_same<std::iterator_traits<decltype(range.first)>::iterator_category,
+                               std::random_access_iterator_tag>::value);
+    assert(std::distance(range.first, range.second) == 2);
+    assert(range.first[1].second == 4);
+    assert((range.first + 1)->second == 4);
+    assert((1 + range.first)->second == 4);
+    assert(std::prev(range.second)->second == 4);
+    assert((range.second - 2) == range.first);
+    assert(range.first < range.second && range.second > range.first);
+    assert(range.first <= range.first && range.second >= range.first);
+    auto cursor = range.first;
+    auto previous = cursor++;
+    assert(previous->second == 2 && cursor->second == 4);
+    previous = cursor--;
+    assert(previous->second == 4 && cursor == range.first);
+    cursor += 2;
+    assert(cursor == range.second);
+    cursor -= 1;
+    --cursor;
+    assert(cursor == range.first);
+    std::vector<int> reversed;
+    for (auto it = std::make_reverse_iterator(range.second); it != std::make_reverse_iterator(range.first); ++it) {
+        reversed.push_back(it->second);
+    }
+    assert((reversed == std::vector<int>{4, 2}));
+    assert(commands.find(std::string("quit")) == commands.end());
+#endif
+}
+
+struct Fragile {
+    // The copies allowed before one throws, negative for no limit.
+    static int copies_left;
+
+    Fragile(int _value)
+        : value(_value)
+    {
+    }
+
+    Fragile(const Fragile &other)
+        : value(other.value)
+    {
+        if (copies_left == 0) {
+            throw std::runtime_error("Fragile: copy failed");
+        }
+        --copies_left;
+    }
+
+    int value;
+};
+
+int Fragile::copies_left = -1;
+
+void test_small_ordered_multimap()
+{
+    std::cout << ">>> test_small_ordered_multimap\n";
+
+    using Small = ordered_multimap::small_ordered_multimap_t<std::string, int, 4>;
+
+    Small table;
+    assert(table.empty());
+    table.insert("a", 1);
+    table.emplace("b", 2);
+    table.insert("a", 3);
+    table.insert("c", 4);
+    assert(table.is_small());
+    assert(table.size() == 4);
+    assert(table.count("a") == 2);
+    assert(table.find("a")->second == 1);
+    assert(table.has("c"));
+    assert(table.find("z") == table.end());
+    auto updated = table.update("a", 5);
+    assert(updated->second == 5);
+    assert(table.count("a") == 2);
+
+    // Erasing keeps the insertion order.
+    auto next = table.erase("a");
+    assert(next->first == "b");
+    assert(table.size() == 2);
+    next = table.erase("z");
+    assert(next == table.end());
+    table.insert("d", 6);
+    std::size_t erased = table.erase("c", 4);
+    assert(erased == 1);
+    next = table.erase(table.begin());
+    assert(next->first == "d");
+    assert((table.to_vector() == std::vector<Table::list_entry_t>{{"d", 6}}));
+
+    // The fifth entry switches to the full representation.
+    for (int i = 0; i < 4; ++i) {
+        table.insert("k" + std::to_string(i), i);
+    }
+    assert(!table.is_small());
+    assert(table.size() == 5);
+    assert(table.begin()->first == "d");
+    assert((--table.end())->first == "k3");
+    assert(table.find("k2")->second == 2);
+    next = table.erase(table.find("k0"));
+    assert(next->first == "k1");
+    assert(table.count("k1") == 1);
+
+    // Copies and moves keep the representation.
+    Small copy(table);
+    assert(copy.to_vector() == table.to_vector());
+    Small moved(std::move(copy));
+    assert(moved.size() == 4);
+    assert(copy.empty());
+
+    Small small;
+    small.insert("x", 1);
+    small.insert("y", 2);
+    Small other;
+    other = small;
+    assert(other.is_small());
+    assert(other.to_vector() == small.to_vector());
+    other = std::move(table);
+    assert(!other.is_small());
+    assert(other.size() == 4);
+
+    other.clear();
+    assert(other.is_small());
+    assert(other.begin() == other.end());
+    const Small &view = small;
+    std::size_t count = 0;
+    for (const auto &entry : view) {
+        count += static_cast<std::size_t>(entry.second);
+    }
+    assert(count == 3);
+
+    // Keys and values taken from the map itself stay valid while it changes.
+    Small full;
+    for (int i = 0; i < 4; ++i) {
+        full.insert("k" + std::to_string(i), i);
+    }
+    full.insert(full.begin()->first, full.begin()->second);
+    assert(!full.is_small());
+    assert((--full.end())->first == "k0" && (--full.end())->second == 0);
+    Small repeated;
+    repeated.insert("x", 1);
+    repeated.insert("y", 2);
+    repeated.insert("x", 3);
+    repeated.erase(repeated.begin()->first);
+    assert((repeated.to_vector() == std::vector<Table::list_entry_t>{{"y", 2}}));
+
+    // A switch to the full representation that throws leaves the entries inline.
+    ordered_multimap::small_ordered_multimap_t<int, Fragile, 2> fragile;
+    fragile.emplace(1, 10);
+    fragile.emplace(2, 20);
+    Fragile::copies_left = 1;
+    bool thrown            = false;
+    try {
+        fragile.emplace(3, 30);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    Fragile::copies_left = -1;
+    assert(thrown);
+    assert(fragile.is_small() && fragile.size() == 2);
+    assert(fragile.find(1)->second.value == 10 && fragile.find(2)->second.value == 20);
+}
+
+void test_compact_ordered_multimap()
+{
+    std::cout << ">>> test_compact_ordered_multimap\n";
+
+    using Compact = ordered_multimap::compact_ordered_multimap_t<std::string, int>;
+
+    std::cout << "    sizeof(ordered_multimap_t)         : " << sizeof(Table) << "\n";
+    std::cout << "    sizeof(compact_ordered_multimap_t) : " << sizeof(Compact) << "\n";
+    assert(sizeof(Compact) == sizeof(void *));
+
+    Compact table;
+    assert(!table.is_allocated());
+    assert(table.empty());
+    assert(table.begin() == table.end());
+    assert(table.find("a") == table.end());
+    assert(table.count("a") == 0);
+    assert(!table.has("a"));
+    auto next = table.erase("a");
+    assert(next == table.end());
+    std::size_t erased = table.erase("a", 1);
+    assert(erased == 0);
+
+    // Copying an empty map does not allocate either.
+    Compact empty_copy(table);
+    assert(!empty_copy.is_allocated());
+
+    table.insert("a", 1);
+    table.emplace("b", 2);
+    table.update("a", 3);
+    assert(table.is_allocated());
+    assert(table.size() == 2);
+    assert(table.find("a")->second == 3);
+    assert((table.keys() == std::vector<std::string>{"a", "b"}));
+
+    Compact copy(table);
+    assert(copy.to_vector() == table.to_vector());
+    Compact moved(std::move(copy));
+    assert(!copy.is_allocated());
+    assert(moved.size() == 2);
+
+    // Emptied maps give back their storage on request.
+    table.erase("a");
+    table.erase(table.begin());
+    assert(table.empty());
+    assert(table.is_allocated());
+    table.shrink_to_fit();
+    assert(!table.is_allocated());
+
+    moved.clear();
+    assert(!moved.is_allocated());
+    const Compact &view = moved;
+    assert(view.begin() == view.end());
+}
+
+void test_flat_index()
+{
+    std::cout << ">>> test_flat_index\n";
+
+    using ordered_multimap::detail::simd_level_t;
+
+    // Every instruction set the processor supports agrees with std::lower_bound
+    // and std::upper_bound, on signed, unsigned, 32-bit and 64-bit keys, around
+    // the bias and the window boundaries.
+    std::vector<simd_level_t> levels = {simd_level_t::scalar};
+    if (ordered_multimap::detail::simd_level() != simd_level_t::scalar) {
+        levels.push_back(simd_level_t::sse2);
+    }
+    if (ordered_multimap::detail::simd_level() == simd_level_t::avx2) {
+        levels.push_back(simd_level_t::avx2);
+    }
+    std::vector<int> ints;
+    std::vector<unsigned> unsigneds;
+    std::vector<long long> longs;
+    std::vector<unsigned long long> unsigned_longs;
+    for (int i = -150; i < 150; i += 1 + (i & 1)) {
+        ints.push_back(i * 3);
+        ints.push_back(i * 3);
+        unsigneds.push_back(static_cast<unsigned>(i) * 3U);
+        longs.push_back(static_cast<long long>(i) << 40);
+        unsigned_longs.push_back(static_cast<unsigned long long>(i) << 40);
+    }
+    std::sort(unsigneds.begin(), unsigneds.end());
+    std::sort(unsigned_longs.begin(), unsigned_longs.end());
+    for (simd_level_t level : levels) {
+        for (std::size_t count = 0; count <= ints.size(); count += 13) {
+            for (int key = -460; key < 460; ++key) {
+                const int *i = ints.data();
+                assert(
+                    ordered_multimap::detail::search<false>(i, count, key, level) ==
+                    static_cast<std::size_t>(std::lower_bound(i, i + count, key) - i));
+                assert(
+                    ordered_multimap::detail::search<true>(i, count, key, level) ==
+                    static_cast<std::size_t>(std::upper_bound(i, i + count, key) - i));
+                const unsigned *u = unsigneds.data();
+                unsigned ukey     = static_cast<unsigned>(key) * 3U;
+                assert(
+                    ordered_multimap::detail::search<false>(u, count / 2, ukey, level) ==
+                    static_cast<std::size_t>(std::lower_bound(u, u + count / 2, ukey) - u));
+                const long long *l = longs.data();
+                long long lkey     = static_cast<long long>(key / 3) << 40;
+                assert(
+                    ordered_multimap::detail::search<true>(l, count / 2, lkey, level) ==
+                    static_cast<std::size_t>(std::upper_bound(l, l + count / 2, lkey) - l));
+                const unsigned long long *ul = unsigned_longs.data();
+                unsigned long long ulkey     = static_cast<unsigned long long>(key / 3) << 40;
+                assert(
+                    ordered_multimap::detail::search<false>(ul, count / 2, ulkey, level) ==
+                    static_cast<std::size_t>(std::lower_bound(ul, ul + count / 2, ulkey) - ul));
+            }
+        }
+    }
+
+    // An ordered_multimap_t using the flat index behaves like the default one.
+    using Flat = ordered_multimap::ordered_multimap_t<int, int, ordered_multimap::flat_index_t>;
+    Flat flat;
+    ordered_multimap::ordered_multimap_t<int, int> reference;
+    for (int i = 0; i < 2000; ++i) {
+        int key = (i * 7919) % 503;
+        flat.insert(key, i);
+        reference.insert(key, i);
+    }
+    assert(flat.to_vector() == reference.to_vector());
+    for (int key = -1; key < 505; ++key) {
+        assert(flat.count(key) == reference.count(key));
+        assert(flat.has(key) == reference.has(key));
+        assert((flat.find(key) == flat.end()) == (reference.find(key) == reference.end()));
+        assert(flat.find(key) == flat.end() || *flat.find(key) == *reference.find(key));
+    }
+    for (int key = 0; key < 503; key += 3) {
+        flat.erase(key);
+        reference.erase(key);
+    }
+    flat.erase(flat.begin());
+    reference.erase(reference.begin());
+    std::size_t erased = flat.erase(7, 7 * 72);
+    assert(erased == reference.erase(7, 7 * 72));
+    flat.update(8, -1);
+    reference.update(8, -1);
+    assert(flat.to_vector() == reference.to_vector());
+
+    // Copies, loading and merging rebuild the index.
+    Flat copy(flat);
+    assert(copy.to_vector() == flat.to_vector());
+    assert(copy.count(10) == flat.count(10));
+    Flat other;
+    for (int i = 0; i < 100; ++i) {
+        other.insert(i % 11, -i);
+        reference.insert(i % 11, -i);
+    }
+    flat.merge(std::move(other));
+    assert(flat.to_vector() == reference.to_vector());
+    assert(flat.count(4) == reference.count(4));
+    auto extracted = flat.extract(4);
+    assert(extracted == reference.extract(4));
+    assert(!flat.has(4));
+}
+
+void test_direct_index()
+{
+    std::cout << ">>> test_direct_index\n";
+
+    // Keys of one or two bytes are addressed directly, the others fall back.
+    static_assert(
+        std::is_same<ordered_multimap::direct_index_t::type<std::int8_t, int>, ordered_multimap::direct_multimap_t<std::int8_t, int>>::value,
+        "small keys are addressed directly");
+    static_assert(
+        std::is_same<ordered_multimap::direct_index_t::type<std::string, int>, std::multimap<std::string, int>>::value,
+        "other keys use a std::multimap");
+
+    // The index iterates in key order, signed keys included, and erases
+    // ranges spanning several groups.
+    ordered_multimap::direct_multimap_t<std::int8_t, int> index;
+    for (int i = 0; i < 40; ++i) {
+        index.insert(std::make_pair(static_cast<std::int8_t>((i * 37) % 21 - 10), i));
+    }
+    assert(index.size() == 40);
+    std::vector<std::pair<std::int8_t, int>> entries(index.begin(), index.end());
+    assert(std::is_sorted(entries.begin(), entries.end(), [](const std::pair<std::int8_t, int> &lhs, const std::pair<std::int8_t, int> &rhs) {
+        return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    }));
+    assert(index.count(-10) == 2);
+    assert(index.find(11) == index.end());
+    assert(index.lower_bound(11) == index.end());
+    assert(index.lower_bound(-100)->first == -10);
+    auto next = index.erase(std::next(index.find(-3)), index.find(4));
+    assert(next->first == 4);
+    assert(index.count(-3) == 1);
+    assert(index.count(0) == 0);
+    // Keys 0 and -5 had a single entry, the others between -3 and 3 had two.
+    assert(index.size() == 28);
+
+    // An ordered_multimap_t using the direct index behaves like the default one.
+    enum class opcode_t : std::uint8_t { load, store, add, jump = 200 };
+    using Program = ordered_multimap::ordered_multimap_t<opcode_t, int, ordered_multimap::direct_index_t>;
+    Program program;
+    program.insert(opcode_t::jump, 0);
+    program.insert(opcode_t::load, 1);
+    program.insert(opcode_t::add, 2);
+    program.insert(opcode_t::load, 3);
+    assert(program.count(opcode_t::load) == 2);
+    assert(program.find(opcode_t::load)->second == 1);
+    assert(!program.has(opcode_t::store));
+    auto loads = program.extract(opcode_t::load);
+    assert(loads == std::vector<int>({1, 3}));
+    assert(program.keys() == std::vector<opcode_t>({opcode_t::jump, opcode_t::add}));
+
+    using Ports = ordered_multimap::ordered_multimap_t<std::uint16_t, int, ordered_multimap::direct_index_t>;
+    Ports ports;
+    ordered_multimap::ordered_multimap_t<std::uint16_t, int> reference;
+    for (int i = 0; i < 3000; ++i) {
+        auto port = static_cast<std::uint16_t>((i * 7919) % 65521 % 1200 * 53);
+        ports.insert(port, i);
+        reference.insert(port, i);
+    }
+    for (int port = 0; port < 65536; port += 53) {
+        auto key = static_cast<std::uint16_t>(port);
+        assert(ports.count(key) == reference.count(key));
+        assert((ports.find(key) == ports.end()) == (reference.find(key) == reference.end()));
+    }
+    for (int port = 0; port < 65536; port += 3 * 53) {
+        ports.erase(static_cast<std::uint16_t>(port));
+        reference.erase(static_cast<std::uint16_t>(port));
+    }
+    ports.erase(std::next(ports.begin(), 5));
+    reference.erase(std::next(reference.begin(), 5));
+    std::size_t erased = ports.erase(53, 1);
+    assert(erased == reference.erase(53, 1));
+    assert(ports.to_vector() == reference.to_vector());
+
+    Ports copy(ports);
+    Ports other;
+    for (int i = 0; i < 100; ++i) {
+        other.insert(static_cast<std::uint16_t>(i % 7 * 53), -i);
+        reference.insert(static_cast<std::uint16_t>(i % 7 * 53), -i);
+    }
+    copy.merge(std::move(other));
+    assert(copy.to_vector() == reference.to_vector());
+    assert(copy.count(106) == reference.count(106));
+    auto extracted = copy.extract(106);
+    assert(extracted == reference.extract(106));
+}
+
+void test_interned_ordered_multimap()
+{
+    std::cout << ">>> test_interned_ordered_multimap\n";
+
+    using ordered_multimap::symbol_t;
+    using Config = ordered_multimap::interned_ordered_multimap_t<int>;
+
+    assert(sizeof(symbol_t) == 4);
+    assert(!symbol_t().valid());
+    assert(!symbol_t::find("test.interned.never").valid());
+    symbol_t a("test.interned.a");
+    symbol_t b("test.interned.b");
+    assert(a == symbol_t(std::string("test.interned.a")));
+    assert(a != b);
+    assert(b.str() == "test.interned.b");
+    assert(symbol_t().str().empty());
+
+    // Threads interning the same vocabulary agree on the identifiers.
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::uint32_t>> ids(4);
+    for (std::size_t t = 0; t < ids.size(); ++t) {
+        threads.emplace_back([t, &ids]() {
+            for (int i = 0; i < 500; ++i) {
+                int word = (t % 2 == 0) ? i : 499 - i;
+                ids[t].push_back(symbol_t("test.interned.word." + std::to_string(word)).get_id());
+            }
+            if (t % 2 != 0) {
+                std::reverse(ids[t].begin(), ids[t].end());
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (std::size_t t = 1; t < ids.size(); ++t) {
+        assert(ids[t] == ids[0]);
+    }
+
+    // Maps share the pool, keys are stored once.
+    std::size_t before = ordered_multimap::intern_pool_t::global().size();
+    Config first;
+    Config second;
+    first.insert(symbol_t("test.interned.host"), 1);
+    first.insert(symbol_t("test.interned.port"), 2);
+    first.insert(symbol_t("test.interned.host"), 3);
+    second.insert(symbol_t("test.interned.port"), 4);
+    assert(ordered_multimap::intern_pool_t::global().size() == before + 2);
+    assert(first.count(symbol_t::find("test.interned.host")) == 2);
+    assert(second.find(symbol_t::find("test.interned.port"))->second == 4);
+    assert(second.find(symbol_t::find("test.interned.missing")) == second.end());
+    assert(first.begin()->first.str() == "test.interned.host");
+
+    // Lookups of unknown keys do not grow the pool.
+    std::size_t interned = ordered_multimap::intern_pool_t::global().size();
+    assert(!first.has(symbol_t::find("test.interned.probe")));
+    assert(first.count(symbol_t::find("test.interned.probe")) == 0);
+    assert(ordered_multimap::intern_pool_t::global().size() == interned);
+    static_assert(!std::is_convertible<const char *, symbol_t>::value, "Strings must not convert to symbols.");
+    static_assert(!std::is_convertible<std::string, symbol_t>::value, "Strings must not convert to symbols.");
+
+    // Serialized maps hold the strings, interned again when loaded.
+    std::stringstream stream;
+    bool saved = first.save(stream);
+    assert(saved);
+    Config loaded;
+    bool restored = loaded.load(stream);
+    assert(restored);
+    assert(loaded.to_vector() == first.to_vector());
+}
+
+void test_btree_index()
+{
+    std::cout << ">>> test_btree_index\n";
+
+    static_assert(
+        std::is_same<ordered_multimap::btree_index_t::type<int, int>, ordered_multimap::btree_multimap_t<int, int>>::value,
+        "default constructible keys use the B+tree");
+
+    // Random insertions split the nodes, duplicates spanning several leaves
+    // keep their insertion order.
+    using Tree = ordered_multimap::btree_multimap_t<int, int>;
+    Tree tree;
+    std::multimap<int, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        int key = (i * 7919) % 1009;
+        tree.insert(std::make_pair(key, i));
+        expected.insert(std::make_pair(key, i));
+    }
+    for (int i = 0; i < 500; ++i) {
+        tree.insert(std::make_pair(42, -i));
+        expected.insert(std::make_pair(42, -i));
+    }
+    auto check = [&tree, &expected]() {
+        assert(tree.size() == expected.size());
+        assert(std::equal(tree.begin(), tree.end(), expected.begin(), [](const std::pair<int, int> &lhs, const std::pair<int, int> &rhs) {
+            return lhs == rhs;
+        }));
+        for (int key = -1; key <= 1010; key += 7) {
+            assert(tree.count(key) == expected.count(key));
+            assert(std::distance(tree.lower_bound(key), tree.end()) == std::distance(expected.lower_bound(key), expected.end()));
+            assert(std::distance(tree.upper_bound(key), tree.end()) == std::distance(expected.upper_bound(key), expected.end()));
+        }
+    };
+    check();
+    assert(tree.count(42) == expected.count(42));
+    assert(tree.find(1009) == tree.end());
+
+    // Erasing empties leaves, which are released, down to an empty tree.
+    for (int key = 0; key < 1009; key += 3) {
+        auto range = tree.equal_range(key);
+        tree.erase(range.first, range.second);
+        expected.erase(key);
+    }
+    check();
+    tree.erase(std::next(tree.begin(), 100), std::next(tree.begin(), 5000));
+    expected.erase(std::next(expected.begin(), 100), std::next(expected.begin(), 5000));
+    check();
+    while (!tree.empty()) {
+        tree.erase(tree.begin());
+    }
+    assert(tree.begin() == tree.end());
+
+    // Sorted entries appended at the end fill the nodes.
+    for (int i = 0; i < 5000; ++i) {
+        tree.insert(tree.end(), std::make_pair(i / 3, i));
+    }
+    tree.insert(tree.end(), std::make_pair(-1, -1));
+    assert(tree.size() == 5001);
+    assert(tree.begin()->first == -1);
+    assert(tree.count(100) == 3);
+    assert(tree.find(100)->second == 300);
+
+    // An ordered_multimap_t using the B+tree behaves like the default one.
+    using Orders = ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::btree_index_t>;
+    Orders orders;
+    ordered_multimap::ordered_multimap_t<std::uint64_t, int> reference;
+    for (int i = 0; i < 10000; ++i) {
+        auto id = static_cast<std::uint64_t>((i * 104729) % 3001);
+        orders.insert(id, i);
+        reference.insert(id, i);
+    }
+    for (std::uint64_t id = 0; id < 3100; id += 11) {
+        assert(orders.count(id) == reference.count(id));
+        orders.erase(id);
+        reference.erase(id);
+    }
+    assert(orders.to_vector() == reference.to_vector());
+    Orders copy(orders);
+    assert(copy.to_vector() == reference.to_vector());
+    assert(copy.find(5)->second == reference.find(5)->second);
+    std::vector<int> values;
+    for (const auto &entry : copy.key_range(10, 12)) {
+        values.push_back(entry.second);
+    }
+    std::vector<int> expected_values;
+    for (const auto &entry : reference.key_range(10, 12)) {
+        expected_values.push_back(entry.second);
+    }
+    assert(values == expected_values);
+}
+
+void test_eytzinger_index()
+{
+    std::cout << ">>> test_eytzinger_index\n";
+
+    // The layout answers like the tree, for every size of the last level.
+    for (int size = 0; size < 70; ++size) {
+        ordered_multimap::eytzinger_multimap_t<int, int> index;
+        std::multimap<int, int> expected;
+        for (int i = 0; i < size; ++i) {
+            index.insert(std::make_pair((i * 37) % 23 * 2, i));
+            expected.insert(std::make_pair((i * 37) % 23 * 2, i));
+        }
+        index.optimize_for_reads();
+        assert(index.is_optimized());
+        assert(index.size() == expected.size());
+        assert(std::equal(index.begin(), index.end(), expected.begin(), [](const std::pair<int, int> &lhs, const std::pair<int, int> &rhs) {
+            return lhs == rhs;
+        }));
+        for (int key = -1; key < 48; ++key) {
+            assert(index.count(key) == expected.count(key));
+            assert((index.find(key) == index.end()) == (expected.find(key) == expected.end()));
+            assert(std::distance(index.lower_bound(key), index.end()) == std::distance(expected.lower_bound(key), expected.end()));
+            assert(std::distance(index.upper_bound(key), index.end()) == std::distance(expected.upper_bound(key), expected.end()));
+        }
+    }
+
+    // Writes move the entries back into the tree, until optimized again.
+    using Routes = ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::eytzinger_index_t>;
+    Routes routes;
+    ordered_multimap::ordered_multimap_t<std::uint64_t, int> reference;
+    for (int i = 0; i < 5000; ++i) {
+        auto prefix = static_cast<std::uint64_t>((i * 7919) % 1201);
+        routes.insert(prefix, i);
+        reference.insert(prefix, i);
+    }
+    routes.optimize_for_reads();
+    for (std::uint64_t prefix = 0; prefix < 1300; prefix += 7) {
+        assert(routes.count(prefix) == reference.count(prefix));
+        assert(routes.has(prefix) == reference.has(prefix));
+    }
+    assert(routes.find(11)->second == reference.find(11)->second);
+    routes.erase(11);
+    reference.erase(11);
+    routes.optimize_for_reads();
+    routes.erase(std::next(routes.begin(), 10));
+    reference.erase(std::next(reference.begin(), 10));
+    routes.optimize_for_reads();
+    routes.insert(5000, -1);
+    reference.insert(5000, -1);
+    assert(routes.to_vector() == reference.to_vector());
+    routes.optimize_for_reads();
+    auto extracted = routes.extract(12);
+    assert(extracted == reference.extract(12));
+    assert(routes.to_vector() == reference.to_vector());
+
+    // Maps built in one go, or copied, can be optimized right away.
+    Routes copy(routes);
+    copy.optimize_for_reads();
+    std::vector<int> values;
+    for (const auto &entry : copy.key_range(100, 103)) {
+        values.push_back(entry.second);
+    }
+    std::vector<int> expected_values;
+    for (const auto &entry : reference.key_range(100, 103)) {
+        expected_values.push_back(entry.second);
+    }
+    assert(values == expected_values);
+
+    // Other indices ignore the request.
+    reference.optimize_for_reads();
+    assert(reference.count(100) == copy.count(100));
+}
+
+void test_bloom_index()
+{
+    std::cout << ">>> test_bloom_index\n";
+
+    // The filter never forgets a key which is in the index.
+    ordered_multimap::bloom_multimap_t<int, std::multimap<int, int>> index;
+    assert(!index.may_contain(0));
+    for (int i = 0; i < 10000; ++i) {
+        index.insert(std::make_pair(i * 2, i));
+    }
+    std::size_t false_positives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        assert(index.may_contain(i * 2));
+        assert(index.count(i * 2) == 1);
+        false_positives += index.may_contain(i * 2 + 1) ? 1U : 0U;
+        assert(index.find(i * 2 + 1) == index.end());
+    }
+    assert(false_positives < 100);
+
+    // Removed keys are forgotten once the filter is rebuilt.
+    index.erase(index.lower_bound(0), index.lower_bound(19000));
+    assert(index.size() == 500);
+    assert(!index.may_contain(0) || !index.may_contain(2) || !index.may_contain(4));
+    assert(index.count(19000) == 1);
+    index.rebuild_filter();
+    assert(index.may_contain(19998));
+
+    // An ordered_multimap_t behind a filter behaves like the default one.
+    using Sessions = ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::bloom_index_t>;
+    using BtreeSessions =
+        ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::basic_bloom_index_t<ordered_multimap::btree_index_t>>;
+    Sessions sessions;
+    BtreeSessions btree_sessions;
+    ordered_multimap::ordered_multimap_t<std::uint64_t, int> reference;
+    for (int i = 0; i < 5000; ++i) {
+        auto id = static_cast<std::uint64_t>((i * 7919) % 2003) * 3U;
+        sessions.insert(id, i);
+        btree_sessions.insert(id, i);
+        reference.insert(id, i);
+    }
+    for (std::uint64_t id = 0; id < 6100; id += 2) {
+        assert(sessions.has(id) == reference.has(id));
+        assert(btree_sessions.count(id) == reference.count(id));
+        auto extracted = sessions.extract(id);
+        assert(extracted == reference.extract(id));
+        btree_sessions.erase(id);
+    }
+    assert(sessions.to_vector() == reference.to_vector());
+    assert(btree_sessions.to_vector() == reference.to_vector());
+    Sessions copy(sessions);
+    assert(copy.find(3)->second == reference.find(3)->second);
+    std::size_t erased = copy.erase(3, reference.find(3)->second);
+    assert(erased == 1);
+    sessions.clear();
+    assert(!sessions.has(3));
+    sessions.insert(3, 1);
+    assert(sessions.has(3));
+}
+
+template <typename Map> void check_find_many(Map &map)
+{
+    std::vector<std::uint64_t> keys;
+    for (std::uint64_t key = 0; key < 500; ++key) {
+        keys.push_back((key * 7919U) % 613U);
+    }
+    std::vector<typename Map::iterator> results;
+    map.find_many(keys.begin(), keys.end(), std::back_inserter(results));
+    assert(results.size() == keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        assert(results[i] == map.find(keys[i]));
+    }
+    const Map &constant = map;
+    std::vector<typename Map::const_iterator> constant_results(3);
+    auto end = constant.find_many(keys.begin(), keys.begin() + 3, constant_results.begin());
+    assert(end == constant_results.end());
+    assert(constant_results[1] == constant.find(keys[1]));
+}
+
+void test_find_many()
+{
+    std::cout << ">>> test_find_many\n";
+
+    using Plain     = ordered_multimap::ordered_multimap_t<std::uint64_t, int>;
+    using Btree     = ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::btree_index_t>;
+    using Eytzinger = ordered_multimap::ordered_multimap_t<std::uint64_t, int, ordered_multimap::eytzinger_index_t>;
+    Plain plain;
+    Btree btree;
+    Eytzinger eytzinger;
+    check_find_many(btree);
+    for (int i = 0; i < 3000; ++i) {
+        auto key = static_cast<std::uint64_t>((i * 104729) % 1201) / 2U;
+        plain.insert(key, i);
+        btree.insert(key, i);
+        eytzinger.insert(key, i);
+    }
+    check_find_many(plain);
+    check_find_many(btree);
+    check_find_many(eytzinger);
+    eytzinger.optimize_for_reads();
+    check_find_many(eytzinger);
+
+    // Results come in the order of the keys, duplicates and misses included.
+    std::vector<std::uint64_t> keys = {600, 7, 1000, 7, 0};
+    std::vector<Btree::iterator> results;
+    btree.find_many(keys.begin(), keys.end(), std::back_inserter(results));
+    assert(results[0]->first == 600);
+    assert(results[1] == results[3]);
+    assert(results[1]->second == btree.find(7)->second);
+    assert(results[2] == btree.end());
+    assert(results[4]->first == 0);
+}
+
+template <typename Map> void check_erase_many(std::size_t count)
+{
+    Map map;
+    Map reference;
+    for (int i = 0; i < 2000; ++i) {
+        auto key = static_cast<std::uint64_t>((i * 7919) % 997);
+        map.insert(key, i);
+        reference.insert(key, i);
+    }
+    // Unsorted, repeated, and missing keys.
+    std::vector<std::uint64_t> keys;
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back((i * 331U) % 1200U);
+    }
+    std::size_t expected = 0;
+    for (std::uint64_t key : keys) {
+        expected += reference.count(key);
+        reference.erase(key);
+    }
+    std::size_t erased = map.erase_many(keys.begin(), keys.end());
+    assert(erased == expected);
+    assert(map.size() == reference.size());
+    assert(map.to_vector() == reference.to_vector());
+    for (std::uint64_t key = 0; key < 1200; ++key) {
+        assert(map.count(key) == reference.count(key));
+    }
+    auto entry = map.by_key().begin();
+    for (const auto &expected_entry : reference.by_key()) {
+        assert(entry->second == expected_entry.second);
+        ++entry;
+    }
+    map.insert(5000, -1);
+    assert(map.find(5000)->second == -1);
+}
+
+void test_erase_many()
+{
+    std::cout << ">>> test_erase_many\n";
+
+    using ordered_multimap::ordered_multimap_t;
+    // Few keys are looked up one by one, many are merged with the index.
+    for (std::size_t count : {0U, 10U, 500U, 3000U}) {
+        check_erase_many<ordered_multimap_t<std::uint64_t, int>>(count);
+        check_erase_many<ordered_multimap_t<std::uint64_t, int, ordered_multimap::flat_index_t>>(count);
+        check_erase_many<ordered_multimap_t<std::uint64_t, int, ordered_multimap::btree_index_t>>(count);
+        check_erase_many<ordered_multimap_t<std::uint64_t, int, ordered_multimap::eytzinger_index_t>>(count);
+        check_erase_many<ordered_multimap_t<std::uint64_t, int, ordered_multimap::bloom_index_t>>(count);
+        check_erase_many<
+            ordered_multimap_t<std::uint64_t, int, ordered_multimap::basic_bloom_index_t<ordered_multimap::flat_index_t>>>(
+            count);
+    }
+    ordered_multimap_t<std::string, int> map;
+    map.insert("a", 1);
+    map.insert("b", 2);
+    map.insert("a", 3);
+    std::vector<std::string> keys = {"a", "c"};
+    std::size_t erased = map.erase_many(keys.begin(), keys.end());
+    assert(erased == 2);
+    assert(map.size() == 1 && map.begin()->second == 2);
+}
+
+template <typename Map> void check_erase_if(int modulo)
+{
+    Map map;
+    Map reference;
+    for (int i = 0; i < 2000; ++i) {
+        auto key = static_cast<std::uint64_t>((i * 7919) % 331);
+        map.insert(key, i);
+        reference.insert(key, i);
+    }
+    // The predicate sees the elements once each, in insertion order.
+    int expected_value = 0;
+    auto matches       = [modulo, &expected_value](const typename Map::list_entry_t &entry) {
+        assert(entry.second == expected_value);
+        ++expected_value;
+        return (entry.second * 37) % 100 < modulo;
+    };
+    std::size_t expected = 0;
+    for (auto it = reference.begin(); it != reference.end();) {
+        if ((it->second * 37) % 100 < modulo) {
+            it = reference.erase(it);
+            ++expected;
+        } else {
+            ++it;
+        }
+    }
+    std::size_t erased = map.erase_if(matches);
+    assert(erased == expected);
+    assert(expected_value == 2000);
+    assert(map.to_vector() == reference.to_vector());
+    // Each index entry still refers to an element with its key, duplicates
+    // included.
+    std::size_t indexed = 0;
+    for (auto it = map.by_key().begin(); it != map.by_key().end(); ++it) {
+        assert(it.element()->first == it->first);
+        ++indexed;
+    }
+    assert(indexed == map.size());
+    for (std::uint64_t key = 0; key < 331; ++key) {
+        assert(map.count(key) == reference.count(key));
+    }
+
+    // Ranges of the list are removed the same way.
+    if (map.size() > 100) {
+        auto first = std::next(map.begin(), 10);
+        auto last  = std::next(first, 80);
+        int after  = last->second;
+        auto next = map.erase(first, last);
+        assert(next->second == after);
+        reference.erase(std::next(reference.begin(), 10), std::next(reference.begin(), 90));
+        assert(map.to_vector() == reference.to_vector());
+        for (std::uint64_t key = 0; key < 331; ++key) {
+            assert(map.count(key) == reference.count(key));
+        }
+    }
+    auto next = map.erase(map.begin(), map.begin());
+    assert(next == map.begin());
+    map.erase(map.begin(), map.end());
+    assert(map.size() == 0 && map.by_key().begin() == map.by_key().end());
+}
+
+void test_erase_if()
+{
+    std::cout << ">>> test_erase_if\n";
+
+    using ordered_multimap::ordered_multimap_t;
+    for (int modulo : {0, 10, 50, 90, 100}) {
+        check_erase_if<ordered_multimap_t<std::uint64_t, int>>(modulo);
+        check_erase_if<ordered_multimap_t<std::uint64_t, int, ordered_multimap::flat_index_t>>(modulo);
+        check_erase_if<ordered_multimap_t<std::uint64_t, int, ordered_multimap::btree_index_t>>(modulo);
+        check_erase_if<ordered_multimap_t<std::uint64_t, int, ordered_multimap::bloom_index_t>>(modulo);
+    }
+    ordered_multimap_t<std::string, int, ordered_multimap::radix_index_t> config;
+    config.insert("a", 1);
+    config.insert("b", 2);
+    config.insert("a", 3);
+    std::size_t erased = config.erase_if([](const std::pair<std::string, int> &entry) { return entry.second == 3; });
+    assert(erased == 1);
+    assert(config.count("a") == 1 && config.find("a")->second == 1);
+}
+
+void test_key_order()
+{
+    std::cout << ">>> test_key_order\n";
+
+    using Map = ordered_multimap::ordered_multimap_t<int, std::string>;
+    Map map;
+    map.insert(5, "e");
+    map.insert(1, "a");
+    map.insert(3, "c1");
+    map.insert(9, "i");
+    map.insert(3, "c2");
+    map.insert(7, "g");
+
+    // Key order, entries with the same key in insertion order.
+    std::vector<std::string> values;
+    for (const auto &entry : map.by_key()) {
+        values.push_back(entry.second);
+    }
+    assert(values == std::vector<std::string>({"a", "c1", "c2", "e", "g", "i"}));
+    assert(map.keys() == std::vector<int>({5, 1, 3, 9, 3, 7}));
+
+    assert(map.lower_bound(3)->second == "c1");
+    assert(map.upper_bound(3)->second == "e");
+    assert(map.lower_bound(4)->first == 5);
+    assert(map.lower_bound(10) == map.by_key().end());
+    assert(map.upper_bound(9) == map.by_key().end());
+
+    // Key iterators are forward iterators, default constructible too.
+    static_assert(std::is_default_constructible<Map::key_iterator>::value, "key_iterator is a forward iterator");
+    Map::key_iterator cursor;
+    cursor = map.lower_bound(9);
+    assert(cursor->second == "i");
+
+    values.clear();
+    for (const auto &entry : map.key_range(3, 7)) {
+        values.push_back(entry.second);
+    }
+    assert(values == std::vector<std::string>({"c1", "c2", "e"}));
+    assert(map.key_range(4, 5).empty());
+    assert(map.key_range(7, 3).empty());
+    assert(std::distance(map.key_range(0, 100).begin(), map.key_range(0, 100).end()) == 6);
+
+    // Values are modified in place, through the references into the list.
+    for (auto &entry : map.key_range(3, 4)) {
+        entry.second += "!";
+    }
+    assert(map.find(3)->second == "c1!");
+    assert(std::next(map.begin(), 4)->second == "c2!");
+
+    // The list iterator allows erasing, or walking in insertion order.
+    auto it = map.lower_bound(9).element();
+    assert(std::next(it)->first == 3);
+    map.erase(it);
+    assert(map.upper_bound(7) == map.by_key().end());
+
+    const Map &constant = map;
+    assert(constant.lower_bound(2)->second == "c1!");
+    assert(constant.upper_bound(5)->first == 7);
+    assert(std::distance(constant.by_key().begin(), constant.by_key().end()) == 5);
+    assert(!constant.key_range(1, 2).empty());
+}
+
+void test_radix_index()
+{
+    std::cout << ">>> test_radix_index\n";
+
+    static_assert(
+        std::is_same<ordered_multimap::radix_index_t::type<int, int>, std::multimap<int, int>>::value,
+        "non-string keys use a std::multimap");
+
+    // The tree iterates in key order, also when nodes grow to 256 children,
+    // and when prefixes are split and merged again.
+    using Radix = ordered_multimap::radix_multimap_t<std::string, int>;
+    Radix radix;
+    std::multimap<std::string, int> expected;
+    std::vector<std::string> words;
+    for (int i = 0; i < 256; ++i) {
+        words.push_back("node.256." + std::string(1, static_cast<char>(i)));
+    }
+    for (int i = 0; i < 400; ++i) {
+        words.push_back("key." + std::to_string((i * 7919) % 397));
+    }
+    words.push_back("");
+    words.push_back("key");
+    words.push_back("key.");
+    words.push_back("node");
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        radix.insert(std::make_pair(words[i], static_cast<int>(i)));
+        expected.insert(std::make_pair(words[i], static_cast<int>(i)));
+    }
+    auto check = [&radix, &expected]() {
+        assert(radix.size() == expected.size());
+        assert(std::equal(radix.begin(), radix.end(), expected.begin(), [](const std::pair<std::string, int> &lhs, const std::pair<std::string, int> &rhs) {
+            return lhs == rhs;
+        }));
+    };
+    check();
+    for (const char *key : {"", "k", "key.1", "key.10", "key.9999", "node.256.\xff", "node.3", "z"}) {
+        assert(radix.count(key) == expected.count(key));
+        assert(std::distance(radix.lower_bound(key), radix.end()) == std::distance(expected.lower_bound(key), expected.end()));
+        assert(std::distance(radix.upper_bound(key), radix.end()) == std::distance(expected.upper_bound(key), expected.end()));
+    }
+    assert(std::distance(radix.prefix_range("key.1").first, radix.prefix_range("key.1").second) == 111);
+    assert(radix.prefix_range("node.256.\xff").first->second == 255);
+    assert(radix.prefix_range("nodes").first == radix.prefix_range("nodes").second);
+    for (std::size_t i = 0; i < words.size(); i += 2) {
+        radix.erase(radix.find(words[i]));
+        expected.erase(expected.find(words[i]));
+    }
+    check();
+    radix.erase(radix.lower_bound("key.2"), radix.upper_bound("node.256.a"));
+    expected.erase(expected.lower_bound("key.2"), expected.upper_bound("node.256.a"));
+    check();
+
+    // The prefix query answers the same on both indices.
+    using Config      = ordered_multimap::ordered_multimap_t<std::string, int>;
+    using RadixConfig = ordered_multimap::ordered_multimap_t<std::string, int, ordered_multimap::radix_index_t>;
+    Config config;
+    RadixConfig radix_config;
+    const char *keys[] = {"server.port", "client.timeout", "server.host", "server", "server.port", "serverless", "\xff\xff"};
+    for (int i = 0; i < 7; ++i) {
+        config.insert(keys[i], i);
+        radix_config.insert(keys[i], i);
+    }
+    std::vector<int> values;
+    for (const auto &entry : config.prefix_range("server.")) {
+        values.push_back(entry.second);
+    }
+    assert(values == std::vector<int>({2, 0, 4}));
+    values.clear();
+    for (const auto &entry : radix_config.prefix_range("server.")) {
+        values.push_back(entry.second);
+    }
+    assert(values == std::vector<int>({2, 0, 4}));
+    assert(radix_config.prefix_range("\xff").begin()->second == 6);
+    assert(config.prefix_range("\xff").begin()->second == 6);
+    assert(radix_config.prefix_range("x").empty());
+    const RadixConfig &constant = radix_config;
+    assert(std::distance(constant.prefix_range("").begin(), constant.prefix_range("").end()) == 7);
+
+    // Erasing through the key order leaves the insertion order intact.
+    radix_config.erase(radix_config.prefix_range("server.").begin().element());
+    config.erase(config.prefix_range("server.").begin().element());
+    assert(radix_config.to_vector() == config.to_vector());
+    assert(radix_config.count("server.port") == 2);
+    RadixConfig copy(radix_config);
+    assert(copy.to_vector() == config.to_vector());
+    assert(copy.find("serverless")->second == 5);
+}
+
 int main()
 {
     std::cout << "Running ordered_multimap_t tests...\n";
@@ -560,6 +2696,32 @@ int main()
     test_front_and_back();
     test_keys_and_values();
     test_to_vector();
+    test_concurrent_append_buffer();
+    test_buffered_ordered_multimap();
+    test_erase_iterator_with_duplicates();
+    test_parallel_algorithms();
+    test_build_parallel();
+    test_save_and_load();
+    test_frozen_ordered_multimap();
+    test_journaled_ordered_multimap();
+    test_checkpointed_ordered_multimap();
+    test_mapped_ordered_multimap();
+    test_shared_ordered_multimap();
+    test_tiered_ordered_multimap();
+    test_static_ordered_multimap();
+    test_small_ordered_multimap();
+    test_compact_ordered_multimap();
+    test_flat_index();
+    test_direct_index();
+    test_interned_ordered_multimap();
+    test_radix_index();
+    test_key_order();
+    test_btree_index();
+    test_eytzinger_index();
+    test_bloom_index();
+    test_find_many();
+    test_erase_many();
+    test_erase_if();
 
     std::cout << "All tests passed!\n";
     return 0;